@@ -0,0 +1,91 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D u_source;
+// Only on the first downsample, straight from the scene color: keeps the
+// colors brighter than u_threshold and weights the samples by 1 / (1 + luma)
+// so single very bright pixels don't flicker (Karis average)
+uniform bool u_prefilter;
+uniform float u_threshold;
+// part of u_source holding the scene (dynamic resolution), 1 for the mips
+uniform vec2 u_uv_scale;
+
+float Luma(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+float KarisWeight(vec3 color) {
+    return 1.0 / (1.0 + Luma(color));
+}
+
+// keeps the outer taps off the stale texels past the rendered part, same as
+// the edge clamp of the mips with u_uv_scale at 1
+vec2 ClampToScene(vec2 uv) {
+    vec2 texel = 1.0 / textureSize(u_source, 0);
+    return clamp(uv, vec2(0.0), u_uv_scale - 0.5 * texel);
+}
+
+vec3 Sample(vec2 uv) {
+    vec3 color = texture(u_source, ClampToScene(uv)).rgb;
+    if (u_prefilter && Luma(color) <= u_threshold) {
+        return vec3(0.0);
+    }
+    return color;
+}
+
+// 13-tap downsample from "Next Generation Post Processing in Call of Duty:
+// Advanced Warfare" (Jimenez 2014)
+void main()
+{
+    vec2 texel = 1.0 / textureSize(u_source, 0);
+    vec2 uv = TexCoords * u_uv_scale;
+    float x = texel.x;
+    float y = texel.y;
+
+    vec3 a = Sample(uv + vec2(-2.0 * x,  2.0 * y));
+    vec3 b = Sample(uv + vec2( 0.0,      2.0 * y));
+    vec3 c = Sample(uv + vec2( 2.0 * x,  2.0 * y));
+
+    vec3 d = Sample(uv + vec2(-2.0 * x,  0.0));
+    vec3 e = Sample(uv);
+    vec3 f = Sample(uv + vec2( 2.0 * x,  0.0));
+
+    vec3 g = Sample(uv + vec2(-2.0 * x, -2.0 * y));
+    vec3 h = Sample(uv + vec2( 0.0,     -2.0 * y));
+    vec3 i = Sample(uv + vec2( 2.0 * x, -2.0 * y));
+
+    vec3 j = Sample(uv + vec2(-x,  y));
+    vec3 k = Sample(uv + vec2( x,  y));
+    vec3 l = Sample(uv + vec2(-x, -y));
+    vec3 m = Sample(uv + vec2( x, -y));
+
+    vec3 result;
+    if (u_prefilter) {
+        // the 5 overlapping 2x2 boxes, each one weighted on its own
+        vec3 groups[5];
+        groups[0] = (a + b + d + e) * 0.25;
+        groups[1] = (b + c + e + f) * 0.25;
+        groups[2] = (d + e + g + h) * 0.25;
+        groups[3] = (e + f + h + i) * 0.25;
+        groups[4] = (j + k + l + m) * 0.25;
+        float box_weights[5] = float[](0.125, 0.125, 0.125, 0.125, 0.5);
+
+        result = vec3(0.0);
+        float weight_sum = 0.0;
+        for (int n = 0; n < 5; n++) {
+            float weight = KarisWeight(groups[n]) * box_weights[n];
+            result += groups[n] * weight;
+            weight_sum += weight;
+        }
+        result /= weight_sum;
+    } else {
+        result = e * 0.125;
+        result += (a + c + g + i) * 0.03125;
+        result += (b + d + f + h) * 0.0625;
+        result += (j + k + l + m) * 0.125;
+    }
+
+    FragColor = vec4(max(result, vec3(0.0001)), 1.0);
+}
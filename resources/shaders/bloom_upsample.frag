@@ -0,0 +1,35 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D u_source;
+// in texture coordinates, the same for every mip so the blur widens as the
+// mips get smaller
+uniform float u_filter_radius;
+
+// 3x3 tent filter, additively blended into the next bigger mip
+void main()
+{
+    float x = u_filter_radius;
+    float y = u_filter_radius;
+
+    vec3 a = texture(u_source, TexCoords + vec2(-x,  y)).rgb;
+    vec3 b = texture(u_source, TexCoords + vec2( 0.0, y)).rgb;
+    vec3 c = texture(u_source, TexCoords + vec2( x,  y)).rgb;
+
+    vec3 d = texture(u_source, TexCoords + vec2(-x, 0.0)).rgb;
+    vec3 e = texture(u_source, TexCoords).rgb;
+    vec3 f = texture(u_source, TexCoords + vec2( x, 0.0)).rgb;
+
+    vec3 g = texture(u_source, TexCoords + vec2(-x, -y)).rgb;
+    vec3 h = texture(u_source, TexCoords + vec2( 0.0, -y)).rgb;
+    vec3 i = texture(u_source, TexCoords + vec2( x, -y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    result *= 1.0 / 16.0;
+
+    FragColor = vec4(result, 1.0);
+}
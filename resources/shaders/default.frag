@@ -1,6 +1,10 @@
 #version 330 core
+// Permutations: LIT, SHADOWS, NORMAL_MAP and SPECULAR_MAP compile their
+// feature in, see shader_feature. Without LIT nothing is lit, like a scene
+// with every light disabled.
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
+// only bound while accumulating weighted blended OIT
+layout (location = 1) out vec4 OITWeight;
 
 in vec3 Normal;
 in vec3 FragPos;
@@ -42,6 +46,7 @@ struct PointLight {
     bool blinn;
     bool enabled;
     bool casts_shadow;
+    bool paraboloid_shadow;
 };
 #define NR_POINT_LIGHTS 4
 
@@ -71,8 +76,13 @@ uniform Material u_material;
 uniform DirLight u_dir_light;
 uniform PointLight u_point_lights[NR_POINT_LIGHTS];
 uniform SpotLight u_spot_light;
+// 0: opaque, 1: alpha blended (sorted), 2: weighted blended OIT
+uniform int u_transparency;
+
+#ifdef SHADOWS
 uniform sampler2D u_shadow_map;
 uniform samplerCube u_shadow_cubemap;
+uniform sampler2DArray u_shadow_paraboloid;
 uniform float u_far_plane;
 
 vec3 sample_offset_directions[20] = vec3[]
@@ -175,6 +185,49 @@ float CalcPointShadow(vec3 frag_pos, vec3 light_pos) {
     return shadow;
 }
 
+float CalcParaboloidShadow(vec3 frag_pos, vec3 light_pos) {
+    vec3 light_to_frag = frag_pos - light_pos;
+    float current_depth = length(light_to_frag);
+
+    // Hemisphere 0 looks down -Z, hemisphere 1 is rotated 180 degrees around Y
+    // (must match paraboloid_depth.gs)
+    float layer = 0.0;
+    if (light_to_frag.z > 0.0) {
+        layer = 1.0;
+        light_to_frag = vec3(-light_to_frag.x, light_to_frag.y, -light_to_frag.z);
+    }
+    vec3 dir = light_to_frag / current_depth;
+    vec2 uv = (dir.xy / (1.0 - dir.z)) * 0.5 + 0.5;
+
+    // PCF
+    float shadow = 0.0;
+    float bias   = 0.15;
+    vec2 texel_size = 1.0 / textureSize(u_shadow_paraboloid, 0).xy;
+    for(int x = -1; x <= 1; ++x) {
+        for(int y = -1; y <= 1; ++y) {
+            float closest_depth = texture(u_shadow_paraboloid, vec3(uv + vec2(x, y) * texel_size, layer)).r;
+            closest_depth *= u_far_plane;   // undo mapping [0;1]
+            if(current_depth - bias > closest_depth) {
+                shadow += 1.0;
+            }
+        }
+    }
+    shadow /= 9.0;
+
+    return shadow;
+}
+#endif
+
+// vec3(1.0) without a specular map
+vec3 SpecularMask() {
+#ifdef SPECULAR_MAP
+    if (u_material.has_specular) {
+        return vec3(texture(u_material.specular, TexCoords));
+    }
+#endif
+    return vec3(1.0);
+}
+
 float CalcSpec(vec3 normal, vec3 light_dir, vec3 view_dir, bool use_blinn) {
     float spec = 0.0;
     if (use_blinn) {
@@ -209,14 +262,15 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 frag_pos, vec3 view_dir)
     vec3 color = vec3(texture(u_material.diffuse, TexCoords));
     vec3 ambient  = light.ambient * color;
     vec3 diffuse  = light.diffuse  * diff * color;
-    vec3 specular = vec3(0.0);
-    if (u_material.has_specular) {
-        specular = light.specular * spec * vec3(texture(u_material.specular, TexCoords));
-    } else {
-        specular = light.specular * spec;
-    }
+    vec3 specular = light.specular * spec * SpecularMask();
 
-    float shadow = light.casts_shadow ? CalcPointShadow(FragPos, light.position) : 0.0;
+    float shadow = 0.0;
+#ifdef SHADOWS
+    if (light.casts_shadow) {
+        shadow = light.paraboloid_shadow ? CalcParaboloidShadow(FragPos, light.position)
+                                         : CalcPointShadow(FragPos, light.position);
+    }
+#endif
 
     ambient  *= attenuation;
     diffuse  *= attenuation;
@@ -244,16 +298,14 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 view_dir) {
     vec3 color = vec3(texture(u_material.diffuse, TexCoords));
     vec3 ambient  = light.ambient  * color;
     vec3 diffuse  = light.diffuse  * diff * color;
-    vec3 specular = vec3(0.0);
-    if (u_material.has_specular) {
-        specular = light.specular * spec * vec3(texture(u_material.specular, TexCoords));
-    } else {
-        specular = light.specular * spec;
-    }
+    vec3 specular = light.specular * spec * SpecularMask();
 
     // calculate shadow
+    float shadow = 0.0;
+#ifdef SHADOWS
     float shadow_bias = max(0.005 * (1.0 - dot(normal, light_dir)), 0.0005);
-    float shadow = light.casts_shadow ? CalcShadow(FragPosLightSpace, shadow_bias) : 0.0;
+    shadow = light.casts_shadow ? CalcShadow(FragPosLightSpace, shadow_bias) : 0.0;
+#endif
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular));
 
     // return (ambient + diffuse + specular);
@@ -286,12 +338,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 frag_pos, vec3 view_dir) {
     vec3 ambient = light.ambient * vec3(texture(u_material.diffuse, TexCoords));
     vec3 diffuse = light.diffuse * diff * vec3(texture(u_material.diffuse, TexCoords));
 
-    vec3 specular = vec3(0.0);
-    if (u_material.has_specular) {
-        specular = light.specular * spec * vec3(texture(u_material.specular, TexCoords));
-    } else {
-        specular = light.specular * spec;
-    }
+    vec3 specular = light.specular * spec * SpecularMask();
 
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -310,16 +357,21 @@ void main() {
     // properties
     vec3 norm = normalize(Normal);
 
+#ifdef NORMAL_MAP
     if (u_material.has_normal) {
-        norm = texture(u_material.normal, TexCoords).rgb;
-        // remap from [0,1] to [-1,1]
-        norm = normalize(norm * 2.0 - 1.0);
+        // remap from [0,1] to [-1,1], BC5 normal maps only store x and y so
+        // z is always rebuilt from them
+        vec2 norm_xy = texture(u_material.normal, TexCoords).rg * 2.0 - 1.0;
+        norm = vec3(norm_xy, sqrt(max(1.0 - dot(norm_xy, norm_xy), 0.0)));
     }
+#endif
 
+    vec3 result = vec3(0.0);
+#ifdef LIT
     vec3 view_dir = normalize(u_view_pos - FragPos);
 
     // phase 1: Directional lighting
-    vec3 result = CalcDirLight(u_dir_light, norm, view_dir);
+    result += CalcDirLight(u_dir_light, norm, view_dir);
 
     // phase 2: Point lights
     for(int i = 0; i < NR_POINT_LIGHTS; i++) {
@@ -328,18 +380,23 @@ void main() {
 
     // phase 3: Spot light
     result += CalcSpotLight(u_spot_light, norm, FragPos, view_dir);
+#endif
 
     // Debug: Shadows
     // float shadow = CalcShadow(FragPosLightSpace);
     // FragColor = vec4(vec3(1.0 - shadow), 1.0);
 
-    FragColor = vec4(result, 1.0);
-
-    // check whether result is higher than some threshold, if so, output as bloom threshold color
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0) {
-        BrightColor = vec4(result, 1.0);
-    } else {
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
+    if (u_transparency == 2) {
+        // Weighted blended OIT (McGuire & Bavoil 2013). The accumulation
+        // target adds the weighted premultiplied color in rgb and multiplies
+        // the revealage in alpha, the second target adds the weights.
+        float alpha = tex_color.a;
+        float weight = clamp(pow(min(1.0, alpha * 10.0) + 0.01, 3.0) * 1e8 *
+                             pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+        FragColor = vec4(result * alpha * weight, alpha);
+        OITWeight = vec4(alpha * weight);
+        return;
     }
+
+    FragColor = vec4(result, u_transparency == 1 ? tex_color.a : 1.0);
 }
@@ -16,6 +16,9 @@ uniform mat4 u_light_space_matrix;
 uniform bool u_reverse_normal;
 uniform vec4 u_clip_plane;
 
+// Must match depth_prepass.vert so the pre-pass depth compares equal
+invariant gl_Position;
+
 void main()
 {
     FragPos = vec3(u_model * vec4(a_pos, 1.0));
@@ -27,12 +30,17 @@ void main()
         Normal = normalize(normal_matrix * a_normal);
     }
 
+#ifdef SHADOWS
     FragPosLightSpace = u_light_space_matrix * vec4(FragPos, 1.0);
+#endif
 
     TexCoords = vec2(a_tex_coords.x * u_tex_repeat.x,
                      a_tex_coords.y * u_tex_repeat.y);
 
+#ifdef CLIP_PLANE
+    // only the planar water passes enable GL_CLIP_DISTANCE0
     gl_ClipDistance[0] = dot(vec4(FragPos, 1.0), u_clip_plane);
+#endif
 
     gl_Position = u_projection * u_view * u_model * vec4(a_pos, 1.0);
 }
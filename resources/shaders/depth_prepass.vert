@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 a_pos;
+
+uniform mat4 u_model;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+// Must match default.vert exactly so the lit pass can depth test with
+// GL_LEQUAL against the depth laid down here.
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = u_projection * u_view * u_model * vec4(a_pos, 1.0);
+}
@@ -1,4 +1,6 @@
 #version 330 core
+// Post-processing uber shader. Every stage is compiled in or out with the
+// EFFECT_* defines from postprocess.cpp, one program per combination.
 out vec4 FragColor;
 
 in vec2 TexCoords;
@@ -6,13 +8,18 @@ in vec2 TexCoords;
 // Use HDR buffer
 uniform sampler2D u_screen_texture;
 uniform sampler2D u_bloom_texture;
-uniform int u_effect;
-uniform bool u_hdr_enabled;
-uniform bool u_bloom_enabled;
 uniform float u_exposure;
+uniform float u_contrast;
+uniform float u_saturation;
+// part of u_screen_texture the scene was rendered into
+uniform vec2 u_uv_scale;
+uniform float u_sharpness;
+
+#if defined(EFFECT_SHARPEN) || defined(EFFECT_BLUR) || defined(EFFECT_EDGES)
+#define EFFECT_KERNEL
 
 const float offset = 1.0 / 300.0;
-vec2 offsets[9] = vec2[](
+const vec2 offsets[9] = vec2[](
     vec2(-offset,  offset), // top-left
     vec2( 0.0f,    offset), // top-center
     vec2( offset,  offset), // top-right
@@ -24,88 +31,106 @@ vec2 offsets[9] = vec2[](
     vec2( offset, -offset)  // bottom-right
 );
 
-float sharpen_kernel[9] = float[](
+#if defined(EFFECT_SHARPEN)
+const float kernel[9] = float[](
     -1, -1, -1,
     -1,  9, -1,
     -1, -1, -1
 );
-
-float edge_kernel[9] = float[](
+#elif defined(EFFECT_EDGES)
+const float kernel[9] = float[](
     1, 1, 1,
     1, -8, 1,
     1, 1, 1
 );
-
-float blur_kernel[9] = float[](
+#else
+const float kernel[9] = float[](
     1.0 / 16, 2.0 / 16, 1.0 / 16,
     2.0 / 16, 4.0 / 16, 2.0 / 16,
     1.0 / 16, 2.0 / 16, 1.0 / 16
 );
+#endif
+#endif
+
+#ifdef EFFECT_UPSCALE
+// Never filter in texels outside the rendered part
+vec2 ClampToScene(vec2 uv) {
+    vec2 texel = 1.0 / textureSize(u_screen_texture, 0);
+    return clamp(uv, vec2(0.0), u_uv_scale - 0.5 * texel);
+}
+
+// Bilinear upscale followed by contrast adaptive sharpening (after AMD
+// FidelityFX CAS): sharpens less where the local contrast is already high.
+vec3 UpscaleSharpen(vec2 uv) {
+    vec2 texel = 1.0 / textureSize(u_screen_texture, 0);
+
+    vec3 e = texture(u_screen_texture, ClampToScene(uv)).rgb;
+    vec3 b = texture(u_screen_texture, ClampToScene(uv + vec2(0.0, texel.y))).rgb;
+    vec3 d = texture(u_screen_texture, ClampToScene(uv - vec2(texel.x, 0.0))).rgb;
+    vec3 f = texture(u_screen_texture, ClampToScene(uv + vec2(texel.x, 0.0))).rgb;
+    vec3 h = texture(u_screen_texture, ClampToScene(uv - vec2(0.0, texel.y))).rgb;
+
+    vec3 min_color = min(e, min(min(b, d), min(f, h)));
+    vec3 max_color = max(e, max(max(b, d), max(f, h)));
+    vec3 amount = sqrt(clamp(min(min_color, 1.0 - max_color) /
+                             max(max_color, vec3(1e-4)), 0.0, 1.0));
+    vec3 weight = amount * (-1.0 / mix(8.0, 5.0, u_sharpness));
+
+    return max((e + (b + d + f + h) * weight) / (1.0 + 4.0 * weight),
+               vec3(0.0));
+}
+#endif
 
 void main()
 {
     const float gamma = 2.2;
-    vec4 color = texture(u_screen_texture, TexCoords);
-    vec3 bloom_color = texture(u_bloom_texture, TexCoords).rgb;
 
-    if(u_bloom_enabled) {
-        color += vec4(bloom_color, 0.0); // additive blending
-    }
+#ifdef EFFECT_UPSCALE
+    vec2 uv = TexCoords * u_uv_scale;
+#else
+    vec2 uv = TexCoords;
+#endif
 
-    vec3 sample_tex[9];
-    for(int i = 0; i < 9; i++)
-    {
-        sample_tex[i] = vec3(texture(u_screen_texture, TexCoords.st + offsets[i]));
+#if defined(EFFECT_KERNEL)
+    vec3 color = vec3(0.0);
+    for(int i = 0; i < 9; i++) {
+#ifdef EFFECT_UPSCALE
+        vec2 tap = ClampToScene(uv + offsets[i]);
+#else
+        vec2 tap = uv + offsets[i];
+#endif
+        color += texture(u_screen_texture, tap).rgb * kernel[i];
     }
+#elif defined(EFFECT_UPSCALE)
+    vec3 color = UpscaleSharpen(uv);
+#else
+    vec3 color = texture(u_screen_texture, uv).rgb;
+#endif
 
-    switch (u_effect) {
-    case 0:
-        break;
-    case 1:
-        // Inversion
-        color = vec4(vec3(1.0 - texture(u_screen_texture, TexCoords)), 1.0);
-        break;
-    case 2:
-        // Grayscale
-        color = texture(u_screen_texture, TexCoords);
-        float average = 0.2126 * color.r + 0.7152 * color.g + 0.0722 * color.b;
-        color = vec4(average, average, average, 1.0);
-        break;
-    case 3:
-        // Kernel Effects
-        // Sharpen
-        vec3 col3 = vec3(0.0);
-        for(int i = 0; i < 9; i++) {
-            col3 += sample_tex[i] * sharpen_kernel[i];
-        }
-        color = vec4(col3, 1.0);
-        break;
-    case 4:
-        // Blur
-        vec3 col4 = vec3(0.0);
-        for(int i = 0; i < 9; i++) {
-            col4 += sample_tex[i] * blur_kernel[i];
-        }
-        color = vec4(col4, 1.0);
-        break;
-    case 5:
-        // Edges
-        vec3 col5 = vec3(0.0);
-        for(int i = 0; i < 9; i++) {
-            col5 += sample_tex[i] * edge_kernel[i];
-        }
-        color = vec4(col5, 1.0);
-        break;
-    }
+#ifdef EFFECT_BLOOM
+    color += texture(u_bloom_texture, TexCoords).rgb; // additive blending
+#endif
 
-    vec3 mapped = color.rgb;
-    if(u_hdr_enabled) {
-        // exposure tone mapping in linear HDR space
-        mapped = vec3(1.0) - exp(-mapped * u_exposure);
-    }
+#ifdef EFFECT_TONEMAP
+    // exposure tone mapping in linear HDR space
+    color = vec3(1.0) - exp(-color * u_exposure);
+#endif
+
+#if defined(EFFECT_INVERSION)
+    color = vec3(1.0) - color;
+#elif defined(EFFECT_GRAYSCALE)
+    float average = 0.2126 * color.r + 0.7152 * color.g + 0.0722 * color.b;
+    color = vec3(average);
+#endif
+
+#ifdef EFFECT_GRADING
+    float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+    color = mix(vec3(luma), color, u_saturation);
+    color = (color - 0.5) * u_contrast + 0.5;
+#endif
 
     // Gamma correction is the final linear -> sRGB conversion.
-    mapped = pow(max(mapped, vec3(0.0)), vec3(1.0 / gamma));
+    color = pow(max(color, vec3(0.0)), vec3(1.0 / gamma));
 
-    FragColor = vec4(mapped, 1.0);
+    FragColor = vec4(color, 1.0);
 }
@@ -21,11 +21,15 @@ void main()
     mat3 normal_matrix = mat3(transpose(inverse(a_instance_matrix)));
     Normal = normalize(normal_matrix * a_normal);
 
+#ifdef SHADOWS
     FragPosLightSpace = u_light_space_matrix * vec4(FragPos, 1.0);
+#endif
 
     TexCoords = a_tex_coords;
 
+#ifdef CLIP_PLANE
     gl_ClipDistance[0] = dot(vec4(FragPos, 1.0), u_clip_plane);
+#endif
 
     gl_Position = u_projection * u_view * a_instance_matrix * vec4(a_pos, 1.0);
 }
@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D u_accumulation;
+uniform sampler2D u_weights;
+// part of the targets the scene is rendered into (dynamic resolution)
+uniform vec2 u_uv_scale;
+
+void main()
+{
+    vec2 uv = TexCoords * u_uv_scale;
+    vec4 accumulation = texture(u_accumulation, uv);
+    float revealage = accumulation.a;
+
+    // nothing transparent was drawn here
+    if (revealage >= 0.9999) {
+        discard;
+    }
+
+    float weights = max(texture(u_weights, uv).r, 1e-5);
+    vec3 color = accumulation.rgb / weights;
+
+    // blended over the opaque scene with SRC_ALPHA, ONE_MINUS_SRC_ALPHA
+    FragColor = vec4(color, 1.0 - revealage);
+}
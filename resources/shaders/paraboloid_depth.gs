@@ -0,0 +1,42 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices=6) out;
+
+uniform vec3 u_light_pos;
+uniform float u_far_plane;
+
+out vec4 FragPos; // FragPos from GS (output per emitvertex)
+
+// Hemisphere 0 looks down -Z from the light, hemisphere 1 is the same view
+// rotated 180 degrees around Y (a rotation keeps the triangle winding intact).
+vec3 ToHemisphere(vec3 light_to_frag, int hemisphere) {
+    if (hemisphere == 1) {
+        return vec3(-light_to_frag.x, light_to_frag.y, -light_to_frag.z);
+    }
+    return light_to_frag;
+}
+
+void main()
+{
+    for (int hemisphere = 0; hemisphere < 2; ++hemisphere) {
+        gl_Layer = hemisphere;
+        for (int i = 0; i < 3; ++i) {
+            FragPos = gl_in[i].gl_Position;
+
+            vec3 local = ToHemisphere(FragPos.xyz - u_light_pos, hemisphere);
+            float distance = length(local);
+            vec3 dir = local / max(distance, 1e-4);
+
+            // clip everything that belongs to the other hemisphere
+            gl_ClipDistance[0] = -dir.z;
+
+            // paraboloid projection: the hemisphere maps onto the unit disk.
+            // A vertex right behind the light still goes through here before
+            // the clip distance drops it, keep the divide finite
+            gl_Position = vec4(dir.xy / max(1.0 - dir.z, 1e-4),
+                               (distance / u_far_plane) * 2.0 - 1.0, 1.0);
+            EmitVertex();
+        }
+        EndPrimitive();
+    }
+}
@@ -0,0 +1,74 @@
+#version 330 core
+// Heightmap terrain drawn through a lod_grid: every instance is one
+// quadtree node, see lod_grid.h. Lit by default.frag.
+layout (location = 0) in vec2 a_grid_pos;
+layout (location = 1) in vec4 a_node;
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec4 FragPosLightSpace;
+
+uniform mat4 u_model;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+uniform mat4 u_light_space_matrix;
+uniform vec4 u_clip_plane;
+
+uniform float u_lod_patch_resolution;
+uniform float u_lod_size;
+uniform vec3 u_lod_view;
+uniform vec2 u_lod_morph[8];
+uniform sampler2D u_heightmap;
+
+// the material textures repeat every 4 units
+const float tex_tile_size = 4.0;
+
+// Odd vertices slide onto their even neighbours as k goes to 1, which turns
+// the patch into the grid of the next level
+vec2 MorphVertex(vec2 grid_pos, float k) {
+    return grid_pos - fract(grid_pos * 0.5) * 2.0 * k;
+}
+
+vec2 LodGridPosition() {
+    float cell = a_node.z / u_lod_patch_resolution;
+    vec2 pos = a_node.xy + a_grid_pos * cell;
+    float dist = length(vec3(pos.x - u_lod_view.x, u_lod_view.y, pos.y - u_lod_view.z));
+    vec2 morph = u_lod_morph[int(a_node.w)];
+    float k = clamp((dist - morph.x) / (morph.y - morph.x), 0.0, 1.0);
+    return a_node.xy + MorphVertex(a_grid_pos, k) * cell;
+}
+
+float SampleHeight(vec2 pos) {
+    return textureLod(u_heightmap, pos / u_lod_size + 0.5, 0.0).r;
+}
+
+void main() {
+    vec2 pos = LodGridPosition();
+    vec3 local_pos = vec3(pos.x, SampleHeight(pos), pos.y);
+
+    // central differences over one heightmap texel
+    float texel = u_lod_size / float(textureSize(u_heightmap, 0).x);
+    float left = SampleHeight(pos - vec2(texel, 0.0));
+    float right = SampleHeight(pos + vec2(texel, 0.0));
+    float back = SampleHeight(pos - vec2(0.0, texel));
+    float front = SampleHeight(pos + vec2(0.0, texel));
+    vec3 local_normal = vec3(left - right, 2.0 * texel, back - front);
+
+    FragPos = vec3(u_model * vec4(local_pos, 1.0));
+
+    mat3 normal_matrix = mat3(transpose(inverse(u_model)));
+    Normal = normalize(normal_matrix * local_normal);
+
+#ifdef SHADOWS
+    FragPosLightSpace = u_light_space_matrix * vec4(FragPos, 1.0);
+#endif
+
+    TexCoords = pos / tex_tile_size;
+
+#ifdef CLIP_PLANE
+    gl_ClipDistance[0] = dot(vec4(FragPos, 1.0), u_clip_plane);
+#endif
+
+    gl_Position = u_projection * u_view * vec4(FragPos, 1.0);
+}
@@ -1,17 +1,8 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 uniform vec3 u_entity_color;
 
 void main() {
     FragColor = vec4(u_entity_color, 1.0); // set all 4 vector values to 1.0
-
-    float brightness = dot(FragColor.rgb, vec3(0.2126, 0.7152, 0.0722));
-    if(brightness > 1.0) {
-        BrightColor = vec4(FragColor.rgb, 1.0);
-    }
-	else {
-        BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-    }
 }
@@ -32,14 +32,27 @@ uniform sampler2D u_reflection_texture;
 uniform sampler2D u_depth_map;
 uniform Material u_material;
 uniform DirLight u_dir_light;
-uniform float u_near_plane;
-uniform float u_far_plane;
+// Screen space mode: u_refraction_texture and u_depth_map are copies of the
+// opaque scene, which only fills u_uv_scale of them
+uniform bool u_screen_space;
+uniform vec2 u_uv_scale;
+uniform samplerCube u_skybox;
+uniform mat4 u_view;
+uniform mat4 u_projection;
+// Planar mode: cameras of the last refraction and reflection update
+uniform mat4 u_refraction_view_projection;
+uniform mat4 u_reflection_view_projection;
 
 const float wave_strength = 0.02;
 const float move_speed = 0.03;
 const float shine_damper = 20.0;
 const float reflectivity = 0.6;
 
+const int ssr_steps = 48;
+const float ssr_step = 0.25;
+const float ssr_step_growth = 1.08;
+const float ssr_thickness = 0.5;
+
 float CalcSpec(vec3 normal, vec3 light_dir, vec3 view_dir, bool use_blinn) {
     float spec = 0.0;
     if (use_blinn) {
@@ -64,21 +77,67 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 view_dir, float water_depth)
     return specular;
 }
 
+vec2 ProjectToUV(mat4 view_projection, vec3 pos) {
+    vec4 clip = view_projection * vec4(pos, 1.0);
+    return (clip.xy / clip.w) * 0.5 + 0.5;
+}
+
+// View distance of a depth buffer value, straight from the camera projection
+float LinearizeProjectedDepth(float depth) {
+    float ndc = depth * 2.0 - 1.0;
+    return u_projection[3][2] / (ndc + u_projection[2][2]);
+}
+
+// March the reflected ray in world space and test it against the opaque
+// depth. Rays leaving the screen or hitting nothing return the skybox.
+vec3 ScreenSpaceReflection(vec3 origin, vec3 dir) {
+    vec3 sky = texture(u_skybox, dir).rgb;
+    vec3 pos = origin;
+    float step_size = ssr_step;
+    for (int i = 0; i < ssr_steps; i++) {
+        pos += dir * step_size;
+        step_size *= ssr_step_growth;
+
+        vec4 clip = u_projection * u_view * vec4(pos, 1.0);
+        if (clip.w <= 0.0) {
+            break;
+        }
+        vec2 uv = (clip.xy / clip.w) * 0.5 + 0.5;
+        if (uv.x < 0.0 || uv.x > 1.0 || uv.y < 0.0 || uv.y > 1.0) {
+            break;
+        }
+
+        float scene_depth = LinearizeProjectedDepth(texture(u_depth_map, uv * u_uv_scale).r);
+        float delta = clip.w - scene_depth;
+        if (delta > 0.0 && delta < max(ssr_thickness, step_size)) {
+            // fade to the sky near the edges, where the screen runs out of data
+            vec2 edge = smoothstep(0.0, 0.1, uv) * smoothstep(0.0, 0.1, 1.0 - uv);
+            vec3 hit = texture(u_refraction_texture, uv * u_uv_scale).rgb;
+            return mix(sky, hit, edge.x * edge.y);
+        }
+    }
+    return sky;
+}
+
 void main() {
-    // INFO: not used for now because we have the normal map
+    // normal of the displaced surface, flat without the ocean
     vec3 normal = normalize(Normal);
 
     vec2 ndc = (ClipSpace.xy / ClipSpace.w) / 2.0 + 0.5;
     vec2 refraction_tex_coords = vec2(ndc.x, ndc.y);
-    // Reflection framebuffer was rendered from a mirrored camera, so sample it
-    // with the projected Y coordinate flipped inside the [0, 1] texture range.
-    vec2 reflection_tex_coords = vec2(ndc.x, 1.0 - ndc.y);
-
-    float depth = texture(u_depth_map, refraction_tex_coords).r;
-    float floor_distance = 2.0 * u_near_plane * u_far_plane / (u_far_plane + u_near_plane - (2.0 * depth - 1.0) * (u_far_plane - u_near_plane));
+    vec2 reflection_tex_coords = vec2(0.0);
+    if (!u_screen_space) {
+        // The planar targets may be a few frames old: find this point where
+        // it was when they were rendered. Projecting with the mirrored camera
+        // also takes care of flipping the reflection.
+        refraction_tex_coords = ProjectToUV(u_refraction_view_projection, WorldPos);
+        reflection_tex_coords = ProjectToUV(u_reflection_view_projection, WorldPos);
+    }
 
-    depth = gl_FragCoord.z;
-    float water_distance = 2.0 * u_near_plane * u_far_plane / (u_far_plane + u_near_plane - (2.0 * depth - 1.0) * (u_far_plane - u_near_plane));
+    float depth = texture(u_depth_map, clamp(refraction_tex_coords, 0.001, 0.999) * u_uv_scale).r;
+    // both depths come from the camera projection, planar targets included
+    float floor_distance = LinearizeProjectedDepth(depth);
+    float water_distance = LinearizeProjectedDepth(gl_FragCoord.z);
     float water_depth = floor_distance - water_distance;
 
     float move_factor = u_time * move_speed;
@@ -89,14 +148,24 @@ void main() {
     refraction_tex_coords += total_distortion;
     reflection_tex_coords += total_distortion;
 
-    vec4 reflect_color = texture(u_reflection_texture, reflection_tex_coords);
-    vec4 refract_color = texture(u_refraction_texture, refraction_tex_coords);
+    refraction_tex_coords = clamp(refraction_tex_coords, 0.001, 0.999);
+    vec4 refract_color = texture(u_refraction_texture, refraction_tex_coords * u_uv_scale);
 
-    vec4 normal_map = texture(u_material.normal, distorted_tex_coords);
-    normal = vec3(normal_map.r * 2.0 - 1.0, normal_map.b * 3.0, normal_map.g * 2.0 - 1.0);
-    normal = normalize(normal);
+    // x and y only, the map may be BC5: z is rebuilt
+    vec2 normal_xy = texture(u_material.normal, distorted_tex_coords).rg * 2.0 - 1.0;
+    float normal_z = sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0));
+    vec3 detail = vec3(normal_xy.x, (normal_z * 0.5 + 0.5) * 3.0, normal_xy.y);
+    // the ripples ride on the waves: add up the slopes of both
+    normal = normalize(vec3(detail.x / detail.y + normal.x / normal.y, 1.0, detail.z / detail.y + normal.z / normal.y));
 
     vec3 view_vector = normalize(ToCameraVector);
+    vec4 reflect_color;
+    if (u_screen_space) {
+        reflect_color = vec4(ScreenSpaceReflection(WorldPos, reflect(-view_vector, normal)), 1.0);
+    } else {
+        reflection_tex_coords = clamp(reflection_tex_coords, 0.001, 0.999);
+        reflect_color = texture(u_reflection_texture, reflection_tex_coords * u_uv_scale);
+    }
     float refraction_factor = dot(view_vector, normal);
     refraction_factor = pow(refraction_factor, 0.5);
 
@@ -1,7 +1,8 @@
 #version 330 core
-layout (location = 0) in vec3 a_pos;
-layout (location = 1) in vec3 a_normal;
-layout (location = 2) in vec2 a_tex_coords;
+// Water surfaces are lod_grids: every instance is one quadtree node, see
+// lod_grid.h
+layout (location = 0) in vec2 a_grid_pos;
+layout (location = 1) in vec4 a_node;
 
 out vec3 WorldPos;
 out vec3 Normal;
@@ -16,15 +17,63 @@ uniform vec3 u_view_pos;
 uniform float u_time;
 uniform vec4 u_clip_plane;
 
+uniform float u_lod_patch_resolution;
+uniform vec3 u_lod_view;
+uniform vec2 u_lod_morph[8];
+
+// FFT ocean displacement of one patch, tiled over the surface, see ocean.h
+uniform bool u_ocean;
+uniform sampler2D u_ocean_displacement;
+uniform float u_ocean_patch_length;
+
+// the dudv and normal maps repeat every 10 units
+const float tex_tile_size = 10.0;
+// Far away the grid is too coarse for the waves, they fade out to flat
+const float ocean_fade_start = 40.0;
+const float ocean_fade_end = 70.0;
+
+// Odd vertices slide onto their even neighbours as k goes to 1, which turns
+// the patch into the grid of the next level
+vec2 MorphVertex(vec2 grid_pos, float k) {
+    return grid_pos - fract(grid_pos * 0.5) * 2.0 * k;
+}
+
+vec2 LodGridPosition() {
+    float cell = a_node.z / u_lod_patch_resolution;
+    vec2 pos = a_node.xy + a_grid_pos * cell;
+    float dist = length(vec3(pos.x - u_lod_view.x, u_lod_view.y, pos.y - u_lod_view.z));
+    vec2 morph = u_lod_morph[int(a_node.w)];
+    float k = clamp((dist - morph.x) / (morph.y - morph.x), 0.0, 1.0);
+    return a_node.xy + MorphVertex(a_grid_pos, k) * cell;
+}
+
+vec3 OceanDisplacement(vec2 pos) {
+    return textureLod(u_ocean_displacement, pos / u_ocean_patch_length, 0.0).xyz;
+}
+
 void main() {
-    vec3 pos = a_pos;
+    vec2 pos = LodGridPosition();
+
+    // Only depends on the morphed position, so neighbouring nodes still meet
+    vec3 displacement = vec3(0.0);
+    vec3 normal = vec3(0.0, 1.0, 0.0);
+    if (u_ocean) {
+        float fade = 1.0 - smoothstep(ocean_fade_start, ocean_fade_end, length(pos - u_lod_view.xz));
+        float texel = u_ocean_patch_length / float(textureSize(u_ocean_displacement, 0).x);
+        vec2 dx = vec2(texel, 0.0);
+        vec2 dz = vec2(0.0, texel);
+        displacement = OceanDisplacement(pos) * fade;
+        vec3 tangent = vec3(2.0 * texel, 0.0, 0.0) + (OceanDisplacement(pos + dx) - OceanDisplacement(pos - dx)) * fade;
+        vec3 bitangent = vec3(0.0, 0.0, 2.0 * texel) + (OceanDisplacement(pos + dz) - OceanDisplacement(pos - dz)) * fade;
+        normal = normalize(cross(bitangent, tangent));
+    }
 
-    vec4 world_pos = u_model * vec4(pos, 1.0);
+    vec4 world_pos = u_model * vec4(vec3(pos.x, 0.0, pos.y) + displacement, 1.0);
     WorldPos = world_pos.xyz;
     ClipSpace = u_projection * u_view * world_pos;
-    TexCoords = vec2(a_tex_coords);
+    TexCoords = pos / tex_tile_size;
     ToCameraVector = u_view_pos - world_pos.xyz;
-    Normal = a_normal;
+    Normal = normalize(mat3(u_model) * normal);
 
     gl_ClipDistance[0] = dot(world_pos, u_clip_plane);
 
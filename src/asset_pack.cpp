@@ -0,0 +1,446 @@
+#include "asset_pack.h"
+#include "mapped_file.h"
+#include "shader_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#ifdef ASSET_PACK_LZ4
+#include <lz4.h>
+#endif
+
+#define ASSET_PACK_MAGIC 0x4B434150 // "PACK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 64
+// LZ4 never expands a blob by more than this, bounds a damaged Size
+#define ASSET_PACK_LZ4_MAX_RATIO 255
+
+enum class asset_pack_compression : uint32_t { None, LZ4 };
+
+// Whether the loose file of an entry was edited since packing
+enum class asset_pack_freshness : uint8_t { Unchecked, Fresh, Stale };
+
+struct asset_pack_header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    uint32_t Padding;
+    // a truncated write never matches
+    uint64_t FileSize;
+    uint64_t EntriesOffset;
+    uint64_t PathsOffset;
+};
+
+struct asset_pack_entry {
+    uint64_t Hash;
+    uint64_t Offset;
+    // of the file, and of the blob when compressed
+    uint64_t Size;
+    uint64_t StoredSize;
+    // of the source file, for caches keyed on it
+    int64_t SourceTime;
+    uint32_t PathOffset;
+    uint32_t PathLength;
+    uint32_t Compression;
+    uint32_t Padding;
+};
+
+// Read only once mounted, the loading threads share it without locks
+struct asset_pack {
+    mapped_file Mapping;
+    const asset_pack_entry *Entries;
+    uint32_t EntryCount;
+    const char *Paths;
+    // Only with CheckStale, by entry. Filled in on the first lookup, the
+    // loading threads may race to check an entry and agree on the result.
+    bool CheckStale;
+    std::unique_ptr<std::atomic<asset_pack_freshness>[]> Freshness;
+};
+
+static asset_pack Pack;
+static std::atomic<int> PackReads;
+static std::atomic<int> LooseReads;
+
+// resources/textures/x.png for ./resources//textures/x.png and the like
+static std::string AssetPack_Normalize(const std::string &Path) {
+    std::vector<std::string> Parts;
+    size_t Start = 0;
+    while (Start <= Path.size()) {
+        size_t End = Path.find_first_of("/\\", Start);
+        if (End == std::string::npos) {
+            End = Path.size();
+        }
+        std::string Part = Path.substr(Start, End - Start);
+        if (Part == "..") {
+            if (!Parts.empty() && Parts.back() != "..") {
+                Parts.pop_back();
+            } else {
+                Parts.push_back(Part);
+            }
+        } else if (!Part.empty() && Part != ".") {
+            Parts.push_back(Part);
+        }
+        Start = End + 1;
+    }
+
+    std::string Normalized;
+    for (const std::string &Part : Parts) {
+        if (!Normalized.empty()) {
+            Normalized += '/';
+        }
+        Normalized += Part;
+    }
+    return Normalized;
+}
+
+static bool AssetPack_StatLoose(const std::string &Path, uint64_t &Size,
+                                int64_t &Time) {
+    std::error_code Error;
+    Size = std::filesystem::file_size(Path, Error);
+    if (Error) {
+        return false;
+    }
+    Time = std::filesystem::last_write_time(Path, Error)
+               .time_since_epoch()
+               .count();
+    return !Error;
+}
+
+// A loose file that was edited after packing wins over its entry, files
+// missing from disk are read from the pack
+static bool AssetPack_IsStale(const asset_pack_entry &Entry) {
+    std::atomic<asset_pack_freshness> &Freshness =
+        Pack.Freshness[&Entry - Pack.Entries];
+    asset_pack_freshness State = Freshness.load(std::memory_order_relaxed);
+    if (State == asset_pack_freshness::Unchecked) {
+        std::string Path(Pack.Paths + Entry.PathOffset, Entry.PathLength);
+        uint64_t Size;
+        int64_t Time;
+        bool Stale = AssetPack_StatLoose(Path, Size, Time) &&
+                     (Size != Entry.Size || Time != Entry.SourceTime);
+        State = Stale ? asset_pack_freshness::Stale
+                      : asset_pack_freshness::Fresh;
+        Freshness.store(State, std::memory_order_relaxed);
+    }
+    return State == asset_pack_freshness::Stale;
+}
+
+static const asset_pack_entry *AssetPack_Find(const std::string &Path) {
+    if (!Pack.Mapping.Data) {
+        return nullptr;
+    }
+    std::string Normalized = AssetPack_Normalize(Path);
+    uint64_t Hash = ShaderCache_Hash(Normalized);
+    const asset_pack_entry *End = Pack.Entries + Pack.EntryCount;
+    const asset_pack_entry *Entry = std::lower_bound(
+        Pack.Entries, End, Hash,
+        [](const asset_pack_entry &Entry, uint64_t Hash) {
+            return Entry.Hash < Hash;
+        });
+    for (; Entry != End && Entry->Hash == Hash; Entry++) {
+        if (Entry->PathLength == Normalized.size() &&
+            memcmp(Pack.Paths + Entry->PathOffset, Normalized.data(),
+                   Normalized.size()) == 0) {
+            if (Pack.CheckStale && AssetPack_IsStale(*Entry)) {
+                return nullptr;
+            }
+            return Entry;
+        }
+    }
+    return nullptr;
+}
+
+bool AssetPack_Mount(const char *PackPath, bool CheckStale) {
+    AssetPack_Unmount();
+    if (!MappedFile_Open(Pack.Mapping, PackPath)) {
+        return false;
+    }
+
+    const mapped_file &Mapping = Pack.Mapping;
+    const asset_pack_header &Header =
+        *(const asset_pack_header *)Mapping.Data;
+    bool Valid =
+        Mapping.Size >= sizeof(asset_pack_header) &&
+        Header.Magic == ASSET_PACK_MAGIC &&
+        Header.Version == ASSET_PACK_VERSION &&
+        Header.FileSize == Mapping.Size &&
+        Header.EntriesOffset % alignof(asset_pack_entry) == 0 &&
+        Header.EntriesOffset <= Mapping.Size &&
+        Header.EntryCount <= (Mapping.Size - Header.EntriesOffset) /
+                                 sizeof(asset_pack_entry) &&
+        Header.PathsOffset <= Mapping.Size;
+    const asset_pack_entry *Entries =
+        (const asset_pack_entry *)(Mapping.Data + Header.EntriesOffset);
+    size_t PathsSize = Mapping.Size - Header.PathsOffset;
+    for (uint32_t i = 0; Valid && i < Header.EntryCount; i++) {
+        const asset_pack_entry &Entry = Entries[i];
+        bool SizeValid =
+            Entry.Compression == (uint32_t)asset_pack_compression::None
+                ? Entry.Size == Entry.StoredSize
+                : Entry.Size <= INT_MAX &&
+                      Entry.Size <=
+                          Entry.StoredSize * ASSET_PACK_LZ4_MAX_RATIO;
+        Valid = Entry.Offset <= Mapping.Size &&
+                Entry.StoredSize <= Mapping.Size - Entry.Offset &&
+                SizeValid && Entry.PathOffset <= PathsSize &&
+                Entry.PathLength <= PathsSize - Entry.PathOffset &&
+                Entry.Compression <= (uint32_t)asset_pack_compression::LZ4;
+    }
+    if (!Valid) {
+        std::cout << "ERROR::ASSET_PACK::INVALID " << PackPath << std::endl;
+        AssetPack_Unmount();
+        return false;
+    }
+
+    Pack.Entries = Entries;
+    Pack.EntryCount = Header.EntryCount;
+    Pack.Paths = (const char *)Mapping.Data + Header.PathsOffset;
+    Pack.CheckStale = CheckStale;
+    if (CheckStale) {
+        Pack.Freshness.reset(
+            new std::atomic<asset_pack_freshness>[Pack.EntryCount]);
+        for (uint32_t i = 0; i < Pack.EntryCount; i++) {
+            Pack.Freshness[i] = asset_pack_freshness::Unchecked;
+        }
+    }
+    return true;
+}
+
+void AssetPack_Unmount() {
+    MappedFile_Close(Pack.Mapping);
+    Pack.Entries = nullptr;
+    Pack.EntryCount = 0;
+    Pack.Paths = nullptr;
+    Pack.CheckStale = false;
+    Pack.Freshness.reset();
+}
+
+static bool AssetPack_ReadLoose(asset_file &File, const std::string &Path) {
+    std::ifstream Input(Path, std::ios::binary | std::ios::ate);
+    if (!Input) {
+        return false;
+    }
+    File.Buffer.resize((size_t)Input.tellg());
+    Input.seekg(0);
+    Input.read((char *)File.Buffer.data(), File.Buffer.size());
+    File.Data = File.Buffer.data();
+    File.Size = File.Buffer.size();
+    return (bool)Input;
+}
+
+bool AssetPack_Read(asset_file &File, const std::string &Path) {
+    File.Data = nullptr;
+    File.Size = 0;
+    File.Buffer.clear();
+
+    const asset_pack_entry *Entry = AssetPack_Find(Path);
+    if (!Entry) {
+        LooseReads++;
+        return AssetPack_ReadLoose(File, Path);
+    }
+
+    PackReads++;
+    const unsigned char *Blob = Pack.Mapping.Data + Entry->Offset;
+    if (Entry->Compression == (uint32_t)asset_pack_compression::None) {
+        File.Data = Blob;
+        File.Size = Entry->Size;
+        return true;
+    }
+#ifdef ASSET_PACK_LZ4
+    File.Buffer.resize(Entry->Size);
+    int Size = LZ4_decompress_safe((const char *)Blob,
+                                   (char *)File.Buffer.data(),
+                                   (int)Entry->StoredSize, (int)Entry->Size);
+    if (Size == (int)Entry->Size) {
+        File.Data = File.Buffer.data();
+        File.Size = File.Buffer.size();
+        return true;
+    }
+#endif
+    // packed by a build with LZ4, the loose file may still be there
+    std::cout << "ERROR::ASSET_PACK::DECOMPRESS_FAILED " << Path << std::endl;
+    return AssetPack_ReadLoose(File, Path);
+}
+
+bool AssetPack_Contains(const std::string &Path) {
+    return AssetPack_Find(Path) != nullptr;
+}
+
+bool AssetPack_Stat(const std::string &Path, uint64_t &Size, int64_t &Time) {
+    const asset_pack_entry *Entry = AssetPack_Find(Path);
+    if (Entry) {
+        Size = Entry->Size;
+        Time = Entry->SourceTime;
+        return true;
+    }
+    return AssetPack_StatLoose(Path, Size, Time);
+}
+
+static bool AssetPack_EndsWith(const std::string &Text,
+                               const std::string &Suffix) {
+    return Text.size() >= Suffix.size() &&
+           Text.compare(Text.size() - Suffix.size(), Suffix.size(),
+                        Suffix) == 0;
+}
+
+std::vector<std::string> AssetPack_List(const std::string &Directory,
+                                        const std::string &Extension) {
+    std::vector<std::string> Files;
+    std::string Prefix = AssetPack_Normalize(Directory);
+    if (!Prefix.empty()) {
+        Prefix += '/';
+    }
+    for (uint32_t i = 0; i < Pack.EntryCount; i++) {
+        std::string Path(Pack.Paths + Pack.Entries[i].PathOffset,
+                         Pack.Entries[i].PathLength);
+        if (Path.compare(0, Prefix.size(), Prefix) == 0 &&
+            Path.find('/', Prefix.size()) == std::string::npos &&
+            AssetPack_EndsWith(Path, Extension)) {
+            Files.push_back(Path);
+        }
+    }
+
+    std::error_code Error;
+    for (const auto &Entry : std::filesystem::directory_iterator(
+             Directory.empty() ? "." : Directory, Error)) {
+        std::string Path = AssetPack_Normalize(Entry.path().string());
+        if (Entry.is_regular_file() && AssetPack_EndsWith(Path, Extension)) {
+            Files.push_back(Path);
+        }
+    }
+    std::sort(Files.begin(), Files.end());
+    Files.erase(std::unique(Files.begin(), Files.end()), Files.end());
+    return Files;
+}
+
+void AssetPack_GetStats(int &PackReadCount, int &LooseReadCount) {
+    PackReadCount = PackReads;
+    LooseReadCount = LooseReads;
+}
+
+static uint64_t AssetPack_Align(uint64_t Offset) {
+    return (Offset + ASSET_PACK_ALIGNMENT - 1) &
+           ~(uint64_t)(ASSET_PACK_ALIGNMENT - 1);
+}
+
+bool AssetPack_Write(const char *Directory, const char *PackPath) {
+    std::vector<std::string> Sources;
+    std::error_code Error;
+    for (const auto &Entry :
+         std::filesystem::recursive_directory_iterator(Directory, Error)) {
+        if (Entry.is_regular_file()) {
+            Sources.push_back(Entry.path().string());
+        }
+    }
+    if (Error) {
+        std::cout << "ERROR::ASSET_PACK::LIST_FAILED " << Directory << ": "
+                  << Error.message() << std::endl;
+        return false;
+    }
+
+    std::vector<asset_pack_entry> Entries;
+    std::vector<std::vector<unsigned char>> Blobs;
+    std::string Paths;
+    uint64_t Offset = AssetPack_Align(sizeof(asset_pack_header));
+    for (const std::string &Source : Sources) {
+        asset_file File;
+        if (!AssetPack_ReadLoose(File, Source)) {
+            std::cout << "ERROR::ASSET_PACK::READ_FAILED " << Source
+                      << std::endl;
+            return false;
+        }
+        uint64_t Size;
+        int64_t Time;
+        if (!AssetPack_StatLoose(Source, Size, Time)) {
+            std::cout << "ERROR::ASSET_PACK::STAT_FAILED " << Source
+                      << std::endl;
+            return false;
+        }
+
+        std::string Path = AssetPack_Normalize(Source);
+        asset_pack_entry Entry = {};
+        Entry.Hash = ShaderCache_Hash(Path);
+        Entry.Size = File.Size;
+        Entry.StoredSize = File.Size;
+        Entry.SourceTime = Time;
+        Entry.PathOffset = (uint32_t)Paths.size();
+        Entry.PathLength = (uint32_t)Path.size();
+        Entry.Compression = (uint32_t)asset_pack_compression::None;
+        Paths += Path;
+
+#ifdef ASSET_PACK_LZ4
+        // Kept only when it saves an eighth, images are compressed already
+        std::vector<unsigned char> Compressed(
+            LZ4_compressBound((int)File.Size));
+        int CompressedSize = LZ4_compress_default(
+            (const char *)File.Data, (char *)Compressed.data(),
+            (int)File.Size, (int)Compressed.size());
+        if (CompressedSize > 0 &&
+            (uint64_t)CompressedSize < File.Size - File.Size / 8) {
+            Compressed.resize(CompressedSize);
+            File.Buffer = std::move(Compressed);
+            Entry.StoredSize = File.Buffer.size();
+            Entry.Compression = (uint32_t)asset_pack_compression::LZ4;
+        }
+#endif
+        Entry.Offset = Offset;
+        Offset = AssetPack_Align(Offset + Entry.StoredSize);
+        Entries.push_back(Entry);
+        Blobs.push_back(std::move(File.Buffer));
+    }
+
+    asset_pack_header Header = {};
+    Header.Magic = ASSET_PACK_MAGIC;
+    Header.Version = ASSET_PACK_VERSION;
+    Header.EntryCount = (uint32_t)Entries.size();
+    Header.EntriesOffset = Offset;
+    Header.PathsOffset = Offset + Entries.size() * sizeof(asset_pack_entry);
+    Header.FileSize = Header.PathsOffset + Paths.size();
+
+    // The blobs keep their offsets, only the index is sorted
+    std::vector<asset_pack_entry> Index = Entries;
+    std::sort(Index.begin(), Index.end(),
+              [](const asset_pack_entry &A, const asset_pack_entry &B) {
+                  return A.Hash < B.Hash;
+              });
+
+    // Written next to the pack and renamed over it, like the caches
+    std::string TempPath = ShaderCache_GetTempPath(PackPath);
+    {
+        std::ofstream Output(TempPath, std::ios::binary | std::ios::trunc);
+        const char Zeros[ASSET_PACK_ALIGNMENT] = {};
+        Output.write((const char *)&Header, sizeof(Header));
+        uint64_t Written = sizeof(Header);
+        for (size_t i = 0; i < Entries.size(); i++) {
+            Output.write(Zeros, Entries[i].Offset - Written);
+            Output.write((const char *)Blobs[i].data(),
+                         Entries[i].StoredSize);
+            Written = Entries[i].Offset + Entries[i].StoredSize;
+        }
+        Output.write(Zeros, Header.EntriesOffset - Written);
+        Output.write((const char *)Index.data(),
+                     Index.size() * sizeof(asset_pack_entry));
+        Output.write(Paths.data(), Paths.size());
+        if (!Output) {
+            std::cout << "ERROR::ASSET_PACK::WRITE_FAILED " << TempPath
+                      << std::endl;
+            Output.close();
+            std::filesystem::remove(TempPath, Error);
+            return false;
+        }
+    }
+    std::filesystem::rename(TempPath, PackPath, Error);
+    if (Error) {
+        std::cout << "ERROR::ASSET_PACK::WRITE_FAILED " << PackPath << ": "
+                  << Error.message() << std::endl;
+        std::filesystem::remove(TempPath, Error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef ASSET_PACK_H_
+#define ASSET_PACK_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Every file under ./resources in one archive, written by --pack. It holds
+// an index of path hashes, sorted for binary search, and the files as
+// 64-byte aligned blobs, stored as is or LZ4 compressed when that was
+// built in (make LZ4=1). Mounted once at startup. Loaders read through
+// AssetPack_Read, which falls back to loose files for anything the pack
+// doesn't hold, or for everything when there is no pack. The pack is
+// trusted as is. Mounted with CheckStale (--check-stale), a loose file
+// whose size or modification time no longer matches its entry, edited
+// since packing, is read instead of the entry. Each entry is checked on its
+// first lookup.
+#define ASSET_PACK_PATH "./resources.pack"
+
+// A file's bytes. Data points into the pack's mapping for entries stored
+// uncompressed, nothing is copied. Otherwise it points into Buffer.
+struct asset_file {
+    const unsigned char *Data;
+    size_t Size;
+    std::vector<unsigned char> Buffer;
+};
+
+// False when there is no valid pack at PackPath, reads go to loose files
+bool AssetPack_Mount(const char *PackPath, bool CheckStale = false);
+void AssetPack_Unmount();
+// Any thread once mounted. Path may be relative or start with ./, it is
+// normalized the way the pack's index is.
+bool AssetPack_Read(asset_file &File, const std::string &Path);
+// True when Path is read from the mapping rather than from disk
+bool AssetPack_Contains(const std::string &Path);
+// Size and modification time of the source file, as recorded when packed
+bool AssetPack_Stat(const std::string &Path, uint64_t &Size, int64_t &Time);
+// Files right inside Directory ending in Extension, from the pack and from
+// disk, sorted
+std::vector<std::string> AssetPack_List(const std::string &Directory,
+                                        const std::string &Extension);
+// Reads served by the pack and by loose files since startup
+void AssetPack_GetStats(int &PackReads, int &LooseReads);
+// Offline: packs every file under Directory into PackPath
+bool AssetPack_Write(const char *Directory, const char *PackPath);
+
+#endif
@@ -0,0 +1,339 @@
+#include "asset_stream.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static void AssetStream_CreatePlaceholder(texture *Tex, const char *Name,
+                                          unsigned char R, unsigned char G,
+                                          unsigned char B) {
+    unsigned char Pixel[4] = {R, G, B, 255};
+    texture_image Image = {
+        .Data = Pixel,
+        .Width = 1,
+        .Height = 1,
+        .Channels = 4,
+        .IsColorData = false,
+        .IsNormalMap = false,
+        .Compression = texture_compression::None,
+        .LevelCount = 0,
+        .LevelOffsets = {},
+        .Mapping = {},
+    };
+    Texture_Upload(Tex, Image, GL_TEXTURE_2D, GL_TEXTURE0, GL_UNSIGNED_BYTE);
+    Tex->Name = Name;
+}
+
+static const texture &AssetStream_GetPlaceholder(const asset_stream &Stream,
+                                                 const std::string &Name) {
+    return Name == "normal" ? Stream.PlaceholderNormal
+                            : Stream.PlaceholderTexture;
+}
+
+void AssetStream_Create(asset_stream &Stream, thread_pool *Pool) {
+    Stream.Pool = Pool;
+    UploadQueue_Create(Stream.Arrivals);
+    Stream.Requests.clear();
+    Stream.ModelStates.clear();
+    Stream.TextureStates.clear();
+
+    AssetStream_CreatePlaceholder(&Stream.PlaceholderTexture, "diffuse", 255,
+                                  255, 255);
+    AssetStream_CreatePlaceholder(&Stream.PlaceholderNormal, "normal", 128,
+                                  128, 255);
+    material Material = {};
+    Material_Create(Material);
+    Material.Textures.push_back(&Stream.PlaceholderTexture);
+    Mesh_CreateCube(&Stream.PlaceholderMesh, Material);
+
+    glGenBuffers(1, &Stream.PBO);
+    Stream.FrameByteBudget = 4 * 1024 * 1024;
+    Stream.FrameTimeBudget = 2.0f;
+
+    Stream.LastFrameBytes = 0;
+    Stream.LastFrameTime = 0.0f;
+    Stream.MaxFrameTime = 0.0f;
+    Stream.TotalBytes = 0;
+}
+
+void AssetStream_Destroy(asset_stream &Stream) {
+    // The pool ran its queued jobs before it stopped, every import arrived
+    UploadQueue_Run(Stream.Arrivals, false);
+    for (stream_request &Request : Stream.Requests) {
+        Model_FreeImport(*Request.Import);
+        for (texture &Texture : Request.Textures) {
+            if (!AssetStream_IsPlaceholder(Stream, Texture.ID)) {
+                glDeleteTextures(1, &Texture.ID);
+            }
+        }
+    }
+    Stream.Requests.clear();
+
+    glDeleteTextures(1, &Stream.PlaceholderTexture.ID);
+    glDeleteTextures(1, &Stream.PlaceholderNormal.ID);
+    glDeleteBuffers(1, &Stream.PBO);
+}
+
+// Import or decode on the pool, the result is handed back through Arrivals
+static void AssetStream_Submit(asset_stream &Stream, stream_request Request,
+                               std::string Path) {
+    UploadQueue_Expect(Stream.Arrivals);
+    auto Arrive = [&Stream](stream_request Request) {
+        UploadQueue_Push(Stream.Arrivals, [&Stream, Request] {
+            if (Request.Model) {
+                Stream.ModelStates[Request.Model] = asset_state::Uploading;
+            } else {
+                Stream.TextureStates[Request.Texture] =
+                    asset_state::Uploading;
+            }
+            Stream.Requests.push_back(Request);
+        });
+    };
+    auto Job = [&Stream, Request, Path, Arrive]() mutable {
+        model_import &Import = *Request.Import;
+        if (Request.Model) {
+            Request.Imported = Model_Import(Import, Path, Stream.Pool);
+            if (Request.Imported) {
+                Model_LoadImages(Import, Stream.Pool);
+            }
+            Arrive(Request);
+            return;
+        }
+
+        // the worker moves on while the source is read
+        Texture_LoadImageAsync(
+            Path, true, Stream.Pool,
+            [Request, Path, Arrive](texture_image &Image,
+                                    bool Loaded) mutable {
+                Request.Import->Textures[0].Image = Image;
+                Request.Imported = Loaded;
+                if (!Loaded) {
+                    std::cout << "ERROR::ASSET_STREAM::LOAD_FAILED " << Path
+                              << std::endl;
+                }
+                Arrive(Request);
+            });
+    };
+
+    if (Stream.Pool) {
+        ThreadPool_Submit(*Stream.Pool, std::move(Job));
+    } else {
+        Job();
+    }
+}
+
+void AssetStream_RequestModel(asset_stream &Stream, model *Model,
+                              const char *File) {
+    Model->GammaCorrection = false;
+    Model->Meshes = {Stream.PlaceholderMesh};
+    Model_UpdateBounds(Model);
+    Stream.ModelStates[Model] = asset_state::Loading;
+
+    stream_request Request = {};
+    Request.Model = Model;
+    Request.Import = std::make_shared<model_import>();
+    AssetStream_Submit(Stream, Request, File);
+}
+
+void AssetStream_RequestTexture(asset_stream &Stream, texture *Texture,
+                                const char *File) {
+    Texture->ID = AssetStream_GetPlaceholder(Stream, Texture->Name).ID;
+    Texture->Type = GL_TEXTURE_2D;
+    Texture->Size = 0;
+    Texture->UncompressedSize = 0;
+    Texture->Repeat = glm::vec2(1.0f);
+    Stream.TextureStates[Texture] = asset_state::Loading;
+
+    stream_request Request = {};
+    Request.Texture = Texture;
+    Request.Import = std::make_shared<model_import>();
+    model_texture_data Data = {};
+    Data.Path = File;
+    Data.Name = Texture->Name;
+    Request.Import->Textures.push_back(Data);
+    AssetStream_Submit(Stream, Request, File);
+}
+
+static bool AssetStream_IsDone(const stream_request &Request) {
+    return !Request.Imported ||
+           (Request.TextureIndex >= (int)Request.Import->Textures.size() &&
+            Request.MeshIndex >= (int)Request.Import->Meshes.size());
+}
+
+// Uploads the next band of rows of the current texture level, as many as
+// fit in Budget but at least one, so a large texture spreads over several
+// frames
+static size_t AssetStream_UploadRows(asset_stream &Stream,
+                                     stream_request &Request, size_t Budget) {
+    model_texture_data &Data = Request.Import->Textures[Request.TextureIndex];
+    texture_image &Image = Data.Image;
+
+    if (Request.Level == 0 && Request.Row == 0) {
+        texture Texture = {};
+        Texture.Path = Data.Path;
+        Texture.Name = Data.Name;
+        if (Image.Data) {
+            Texture_Allocate(&Texture, Image);
+        } else {
+            Texture = AssetStream_GetPlaceholder(Stream, Data.Name);
+            Texture.Path = Data.Path;
+        }
+        Request.Textures.push_back(Texture);
+    }
+    if (!Image.Data) {
+        Request.TextureIndex++;
+        return 0;
+    }
+
+    texture &Texture = Request.Textures.back();
+    int Level = Request.Level;
+    // rows of 4x4 blocks for compressed images
+    int Height = Texture_GetLevelRows(Image, Level);
+    size_t RowBytes = Texture_GetRowSize(Image, Level);
+    int Rows = (int)std::max<size_t>(1, Budget / RowBytes);
+    Rows = std::min(Rows, Height - Request.Row);
+    size_t Size = RowBytes * Rows;
+    const unsigned char *Pixels =
+        Texture_GetLevelData(Image, Level) + RowBytes * Request.Row;
+
+    // Orphaned every band, the driver hands out fresh storage while it
+    // still copies the last one into the texture
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Stream.PBO);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, Size, nullptr, GL_STREAM_DRAW);
+    void *Target =
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, Size,
+                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (Target) {
+        memcpy(Target, Pixels, Size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        Texture_UploadRows(&Texture, Image, Level, Request.Row, Rows,
+                           nullptr);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    } else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        Texture_UploadRows(&Texture, Image, Level, Request.Row, Rows, Pixels);
+    }
+
+    Request.Row += Rows;
+    if (Request.Row >= Height) {
+        Request.Level++;
+        Request.Row = 0;
+    }
+    if (Request.Level >= std::max(1, Image.LevelCount)) {
+        Texture_FinishUpload(&Texture, Image);
+        Texture_FreeImage(Image);
+        Request.TextureIndex++;
+        Request.Level = 0;
+    }
+    return Size;
+}
+
+static size_t AssetStream_UploadMesh(stream_request &Request) {
+    model_mesh_data &Data = Request.Import->Meshes[Request.MeshIndex++];
+    size_t Size = Data.Vertices.size() * sizeof(vertex) +
+                  Data.Indices.size() * sizeof(unsigned int);
+    if (Data.MappedVertices) {
+        Size = Data.VertexCount * (sizeof(vertex) + sizeof(glm::vec3)) +
+               Data.IndexCount * sizeof(unsigned int);
+    }
+
+    // the textures are pointed at once they moved into the model
+    Request.Meshes.emplace_back();
+    Model_UploadMesh(&Request.Meshes.back(), Data, Model_CreateMaterial());
+    return Size;
+}
+
+// Swaps the uploaded asset in for the placeholder
+static void AssetStream_Finish(asset_stream &Stream, stream_request &Request) {
+    asset_state State =
+        Request.Imported ? asset_state::Ready : asset_state::Failed;
+
+    if (Request.Model && Request.Imported) {
+        model *Model = Request.Model;
+        size_t FirstTexture = Model->TexturesLoaded.size();
+        for (const texture &Texture : Request.Textures) {
+            Model->TexturesLoaded.push_back(Texture);
+        }
+        for (size_t i = 0; i < Request.Meshes.size(); i++) {
+            material &Material = Request.Meshes[i].Material;
+            for (int Index : Request.Import->Meshes[i].Textures) {
+                Material.Textures.push_back(
+                    &Model->TexturesLoaded[FirstTexture + Index]);
+            }
+        }
+        Model->Directory = Request.Import->Directory;
+        Model->Meshes = std::move(Request.Meshes);
+        Model_UpdateBounds(Model);
+    } else if (Request.Texture && Request.Imported) {
+        const texture &Uploaded = Request.Textures[0];
+        Request.Texture->ID = Uploaded.ID;
+        Request.Texture->Type = Uploaded.Type;
+        Request.Texture->Size = Uploaded.Size;
+        Request.Texture->UncompressedSize = Uploaded.UncompressedSize;
+        Request.Texture->Path = Uploaded.Path;
+    }
+
+    if (Request.Model) {
+        Stream.ModelStates[Request.Model] = State;
+    } else {
+        Stream.TextureStates[Request.Texture] = State;
+    }
+    Model_FreeImport(*Request.Import);
+}
+
+void AssetStream_Update(asset_stream &Stream) {
+    double StartTime = glfwGetTime();
+    UploadQueue_Run(Stream.Arrivals, false);
+
+    // CPU time of the GL calls only, copies the driver defers to later in
+    // the frame don't show up here
+    size_t Bytes = 0;
+    float Time = 0.0f;
+    while (!Stream.Requests.empty() && Bytes < Stream.FrameByteBudget &&
+           Time < Stream.FrameTimeBudget) {
+        stream_request &Request = Stream.Requests.front();
+        if (!AssetStream_IsDone(Request)) {
+            size_t Budget = Stream.FrameByteBudget - Bytes;
+            if (Request.TextureIndex < (int)Request.Import->Textures.size()) {
+                Bytes += AssetStream_UploadRows(Stream, Request, Budget);
+            } else {
+                Bytes += AssetStream_UploadMesh(Request);
+            }
+        }
+        if (AssetStream_IsDone(Request)) {
+            AssetStream_Finish(Stream, Request);
+            Stream.Requests.pop_front();
+        }
+        Time = (float)((glfwGetTime() - StartTime) * 1000.0);
+    }
+
+    Stream.LastFrameBytes = Bytes;
+    Stream.TotalBytes += Bytes;
+    Stream.LastFrameTime = (float)((glfwGetTime() - StartTime) * 1000.0);
+    Stream.MaxFrameTime = std::max(Stream.MaxFrameTime, Stream.LastFrameTime);
+}
+
+asset_state AssetStream_GetState(const asset_stream &Stream,
+                                 const model *Model) {
+    auto Existing = Stream.ModelStates.find(Model);
+    return Existing == Stream.ModelStates.end() ? asset_state::Ready
+                                                : Existing->second;
+}
+
+asset_state AssetStream_GetState(const asset_stream &Stream,
+                                 const texture *Texture) {
+    auto Existing = Stream.TextureStates.find(Texture);
+    return Existing == Stream.TextureStates.end() ? asset_state::Ready
+                                                  : Existing->second;
+}
+
+int AssetStream_GetPendingCount(const asset_stream &Stream) {
+    return Stream.Arrivals.Outstanding + (int)Stream.Requests.size();
+}
+
+bool AssetStream_IsPlaceholder(const asset_stream &Stream, GLuint TextureID) {
+    return TextureID == Stream.PlaceholderTexture.ID ||
+           TextureID == Stream.PlaceholderNormal.ID;
+}
@@ -0,0 +1,84 @@
+#ifndef ASSET_STREAM_H_
+#define ASSET_STREAM_H_
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "mesh.h"
+#include "model.h"
+#include "texture.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
+
+enum class asset_state { Loading, Uploading, Ready, Failed };
+
+// An import the workers finished, uploaded a piece at a time on the GL
+// thread. Fills exactly one of Model or Texture once everything is in.
+struct stream_request {
+    model *Model;
+    texture *Texture;
+    std::shared_ptr<model_import> Import;
+    bool Imported;
+
+    // Progress, textures first, level by level and row by row, then one
+    // mesh at a time
+    int TextureIndex;
+    int Level;
+    int Row;
+    std::vector<texture> Textures;
+    int MeshIndex;
+    std::vector<mesh> Meshes;
+};
+
+// Assets requested mid-session. Decoding and imports run on the pool,
+// pixels go through a PBO and AssetStream_Update stops uploading once the
+// frame's byte or time budget is spent, the rest waits for the next frame.
+struct asset_stream {
+    thread_pool *Pool;
+    // Workers push finished imports here, AssetStream_Update collects them
+    upload_queue Arrivals;
+    std::deque<stream_request> Requests;
+    std::map<const model *, asset_state> ModelStates;
+    std::map<const texture *, asset_state> TextureStates;
+
+    // Stand in until the real asset is uploaded
+    texture PlaceholderTexture;
+    // flat (0.5, 0.5, 1.0), for requests named "normal"
+    texture PlaceholderNormal;
+    mesh PlaceholderMesh;
+
+    unsigned int PBO;
+    size_t FrameByteBudget;
+    // milliseconds
+    float FrameTimeBudget;
+
+    size_t LastFrameBytes;
+    float LastFrameTime;
+    float MaxFrameTime;
+    size_t TotalBytes;
+};
+
+// Needs a current context. Pool does the imports, null imports on the GL
+// thread when the request is made.
+void AssetStream_Create(asset_stream &Stream, thread_pool *Pool);
+// After the pool is gone, drops whatever didn't finish uploading
+void AssetStream_Destroy(asset_stream &Stream);
+// Once per frame on the GL thread, before drawing
+void AssetStream_Update(asset_stream &Stream);
+// Model starts out as the placeholder cube and is filled in place
+void AssetStream_RequestModel(asset_stream &Stream, model *Model,
+                              const char *File);
+// Texture starts out as a 1x1 placeholder, its ID is swapped once uploaded
+void AssetStream_RequestTexture(asset_stream &Stream, texture *Texture,
+                                const char *File);
+// Ready for anything that was never streamed
+asset_state AssetStream_GetState(const asset_stream &Stream,
+                                 const model *Model);
+asset_state AssetStream_GetState(const asset_stream &Stream,
+                                 const texture *Texture);
+// Requests not fully uploaded yet, imports included
+int AssetStream_GetPendingCount(const asset_stream &Stream);
+bool AssetStream_IsPlaceholder(const asset_stream &Stream, GLuint TextureID);
+
+#endif
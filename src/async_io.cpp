@@ -0,0 +1,447 @@
+#include "async_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Kernel headers older than 5.1 have no io_uring, reads then always go
+// through the pool
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define ASYNC_IO_URING
+#endif
+#endif
+
+// A loose file being read, Offset bytes of it in so far
+struct async_io_read {
+    asset_file File;
+    int Descriptor;
+    size_t Offset;
+    async_io_callback Done;
+};
+
+#ifdef ASYNC_IO_URING
+// The kernel's submission and completion rings, mapped in by hand so there
+// is no liburing to link
+struct async_io_ring {
+    int Descriptor;
+    void *SubmitRing;
+    size_t SubmitRingSize;
+    void *CompleteRing;
+    size_t CompleteRingSize;
+    io_uring_sqe *Entries;
+    size_t EntriesSize;
+
+    unsigned *SubmitTail;
+    unsigned *SubmitMask;
+    unsigned *SubmitArray;
+    unsigned *CompleteHead;
+    unsigned *CompleteTail;
+    unsigned *CompleteMask;
+    io_uring_cqe *Completions;
+};
+#endif
+
+struct async_io {
+    thread_pool *Pool;
+    // only changes under Mutex, read without it where a stale value is fine
+    std::atomic<bool> Started;
+#ifdef ASYNC_IO_URING
+    bool Uring;
+    async_io_ring Ring;
+    // one thread fills submission entries at a time
+    std::mutex SubmitMutex;
+    std::thread Reaper;
+#endif
+
+    // guards everything below
+    std::mutex Mutex;
+    std::condition_variable Changed;
+    int InFlight;
+    int MaxInFlight;
+    int Reads;
+    uint64_t Bytes;
+    double BusyTime;
+    std::chrono::steady_clock::time_point BusyStart;
+};
+
+static async_io IO;
+
+// Counts a read in, false once AsyncIO_Stop has begun and the read has to
+// be made on the caller. The ring's reads wait while it is full, the pool's
+// queue bounds its own, and its workers must not wait on each other.
+static bool AsyncIO_Begin(bool Bounded) {
+    std::unique_lock<std::mutex> Lock(IO.Mutex);
+    IO.Changed.wait(Lock, [Bounded] {
+        return !IO.Started || !Bounded ||
+               IO.InFlight < ASYNC_IO_QUEUE_DEPTH;
+    });
+    if (!IO.Started) {
+        return false;
+    }
+    if (IO.InFlight++ == 0) {
+        IO.BusyStart = std::chrono::steady_clock::now();
+    }
+    IO.MaxInFlight = std::max(IO.MaxInFlight, IO.InFlight);
+    return true;
+}
+
+static void AsyncIO_End(size_t Bytes) {
+    std::lock_guard<std::mutex> Lock(IO.Mutex);
+    IO.Reads++;
+    IO.Bytes += Bytes;
+    if (--IO.InFlight == 0) {
+        IO.BusyTime += std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - IO.BusyStart)
+                           .count();
+    }
+    IO.Changed.notify_all();
+}
+
+// On the pool, the decoding happens in Done. The pool outlives the reads,
+// AsyncIO_Stop comes before ThreadPool_Destroy.
+static void AsyncIO_Dispatch(async_io_read *Read, bool Succeeded) {
+    ThreadPool_Submit(*IO.Pool, [Read, Succeeded] {
+        Read->Done(Read->File, Succeeded);
+        delete Read;
+    });
+}
+
+#ifdef ASYNC_IO_URING
+static int AsyncIO_Enter(unsigned Submit, unsigned Complete, unsigned Flags) {
+    return (int)syscall(__NR_io_uring_enter, IO.Ring.Descriptor, Submit,
+                        Complete, Flags, nullptr, 0);
+}
+
+static void AsyncIO_DestroyRing(async_io_ring &Ring) {
+    if (Ring.Entries) {
+        munmap(Ring.Entries, Ring.EntriesSize);
+    }
+    if (Ring.CompleteRing && Ring.CompleteRing != Ring.SubmitRing) {
+        munmap(Ring.CompleteRing, Ring.CompleteRingSize);
+    }
+    if (Ring.SubmitRing) {
+        munmap(Ring.SubmitRing, Ring.SubmitRingSize);
+    }
+    close(Ring.Descriptor);
+    Ring = {};
+}
+
+// False when the kernel has no io_uring, or one too old to read into a
+// plain buffer (IORING_OP_READ is 5.6)
+static bool AsyncIO_CreateRing(async_io_ring &Ring) {
+    Ring = {};
+    io_uring_params Params = {};
+    Ring.Descriptor = (int)syscall(__NR_io_uring_setup, ASYNC_IO_QUEUE_DEPTH,
+                                   &Params);
+    if (Ring.Descriptor < 0) {
+        return false;
+    }
+
+    size_t ProbeSize =
+        sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::vector<unsigned char> ProbeData(ProbeSize, 0);
+    io_uring_probe *Probe = (io_uring_probe *)ProbeData.data();
+    if (syscall(__NR_io_uring_register, Ring.Descriptor,
+                IORING_REGISTER_PROBE, Probe, 256) < 0 ||
+        Probe->last_op < IORING_OP_READ ||
+        !(Probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED)) {
+        close(Ring.Descriptor);
+        return false;
+    }
+
+    Ring.SubmitRingSize =
+        Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+    Ring.CompleteRingSize =
+        Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+    bool SingleMapping = Params.features & IORING_FEAT_SINGLE_MMAP;
+    if (SingleMapping) {
+        Ring.SubmitRingSize =
+            std::max(Ring.SubmitRingSize, Ring.CompleteRingSize);
+    }
+    void *Mapping =
+        mmap(nullptr, Ring.SubmitRingSize, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, Ring.Descriptor, IORING_OFF_SQ_RING);
+    if (Mapping == MAP_FAILED) {
+        close(Ring.Descriptor);
+        Ring = {};
+        return false;
+    }
+    Ring.SubmitRing = Mapping;
+    if (SingleMapping) {
+        Ring.CompleteRing = Ring.SubmitRing;
+    } else {
+        Mapping = mmap(nullptr, Ring.CompleteRingSize, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, Ring.Descriptor,
+                       IORING_OFF_CQ_RING);
+        if (Mapping == MAP_FAILED) {
+            AsyncIO_DestroyRing(Ring);
+            return false;
+        }
+        Ring.CompleteRing = Mapping;
+    }
+    Ring.EntriesSize = Params.sq_entries * sizeof(io_uring_sqe);
+    Mapping = mmap(nullptr, Ring.EntriesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, Ring.Descriptor,
+                   IORING_OFF_SQES);
+    if (Mapping == MAP_FAILED) {
+        AsyncIO_DestroyRing(Ring);
+        return false;
+    }
+    Ring.Entries = (io_uring_sqe *)Mapping;
+
+    unsigned char *Submit = (unsigned char *)Ring.SubmitRing;
+    unsigned char *Complete = (unsigned char *)Ring.CompleteRing;
+    Ring.SubmitTail = (unsigned *)(Submit + Params.sq_off.tail);
+    Ring.SubmitMask = (unsigned *)(Submit + Params.sq_off.ring_mask);
+    Ring.SubmitArray = (unsigned *)(Submit + Params.sq_off.array);
+    Ring.CompleteHead = (unsigned *)(Complete + Params.cq_off.head);
+    Ring.CompleteTail = (unsigned *)(Complete + Params.cq_off.tail);
+    Ring.CompleteMask = (unsigned *)(Complete + Params.cq_off.ring_mask);
+    Ring.Completions = (io_uring_cqe *)(Complete + Params.cq_off.cqes);
+    return true;
+}
+
+// Null Read is the reaper's signal to stop. The kernel takes the entry
+// in during io_uring_enter, so the ring never has more than one pending.
+// False when the kernel refused it, the entry is taken back out.
+static bool AsyncIO_Submit(async_io_read *Read) {
+    std::lock_guard<std::mutex> Lock(IO.SubmitMutex);
+    async_io_ring &Ring = IO.Ring;
+    unsigned Tail = *Ring.SubmitTail;
+    unsigned Index = Tail & *Ring.SubmitMask;
+    io_uring_sqe &Entry = Ring.Entries[Index];
+    memset(&Entry, 0, sizeof(Entry));
+    if (Read) {
+        // at most 1 GB a read, bigger files take several
+        Entry.opcode = IORING_OP_READ;
+        Entry.fd = Read->Descriptor;
+        Entry.addr = (uint64_t)(Read->File.Buffer.data() + Read->Offset);
+        Entry.len = (unsigned)std::min<size_t>(
+            Read->File.Buffer.size() - Read->Offset, 1u << 30);
+        Entry.off = Read->Offset;
+    } else {
+        Entry.opcode = IORING_OP_NOP;
+    }
+    Entry.user_data = (uint64_t)Read;
+    Ring.SubmitArray[Index] = Index;
+    __atomic_store_n(Ring.SubmitTail, Tail + 1, __ATOMIC_RELEASE);
+
+    int Error;
+    for (;;) {
+        if (AsyncIO_Enter(1, 0, 0) >= 0) {
+            return true;
+        }
+        Error = errno;
+        if (Error != EINTR && Error != EAGAIN && Error != EBUSY) {
+            break;
+        }
+        std::this_thread::yield();
+    }
+    // nothing was consumed when io_uring_enter fails
+    std::cout << "ERROR::ASYNC_IO::SUBMIT_FAILED " << strerror(Error)
+              << std::endl;
+    __atomic_store_n(Ring.SubmitTail, Tail, __ATOMIC_RELEASE);
+    return false;
+}
+
+static void AsyncIO_Finish(async_io_read *Read, bool Succeeded) {
+    close(Read->Descriptor);
+    Read->File.Buffer.resize(Read->Offset);
+    Read->File.Data = Read->File.Buffer.data();
+    Read->File.Size = Read->Offset;
+    AsyncIO_End(Read->Offset);
+    AsyncIO_Dispatch(Read, Succeeded);
+}
+
+// A read the ring refused still completes, as failed
+static void AsyncIO_Queue(async_io_read *Read) {
+    if (!AsyncIO_Submit(Read)) {
+        AsyncIO_Finish(Read, false);
+    }
+}
+
+static void AsyncIO_Complete(async_io_read *Read, int Result) {
+    if (Result == -EINTR || Result == -EAGAIN) {
+        AsyncIO_Queue(Read);
+        return;
+    }
+    if (Result < 0) {
+        std::cout << "ERROR::ASYNC_IO::READ_FAILED " << strerror(-Result)
+                  << std::endl;
+        AsyncIO_Finish(Read, false);
+        return;
+    }
+    Read->Offset += Result;
+    // short reads carry on where they stopped, a file that shrank ends
+    if (Result > 0 && Read->Offset < Read->File.Buffer.size()) {
+        AsyncIO_Queue(Read);
+        return;
+    }
+    AsyncIO_Finish(Read, true);
+}
+
+// Collects completions for the whole ring, until the stop signal
+static void AsyncIO_Reap() {
+    async_io_ring &Ring = IO.Ring;
+    for (;;) {
+        if (AsyncIO_Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR) {
+            std::cout << "ERROR::ASYNC_IO::WAIT_FAILED " << strerror(errno)
+                      << std::endl;
+        }
+        unsigned Head = *Ring.CompleteHead;
+        unsigned Tail = __atomic_load_n(Ring.CompleteTail, __ATOMIC_ACQUIRE);
+        bool Stop = false;
+        for (; Head != Tail; Head++) {
+            io_uring_cqe Completion =
+                Ring.Completions[Head & *Ring.CompleteMask];
+            __atomic_store_n(Ring.CompleteHead, Head + 1, __ATOMIC_RELEASE);
+            async_io_read *Read = (async_io_read *)Completion.user_data;
+            if (!Read) {
+                Stop = true;
+            } else {
+                AsyncIO_Complete(Read, Completion.res);
+            }
+        }
+        if (Stop) {
+            return;
+        }
+    }
+}
+
+// Queued on the ring, already counted in by AsyncIO_Begin
+static void AsyncIO_ReadUring(async_io_read *Read, const std::string &Path) {
+    int Descriptor = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat Status;
+    if (Descriptor < 0 || fstat(Descriptor, &Status) < 0) {
+        if (Descriptor >= 0) {
+            close(Descriptor);
+        }
+        AsyncIO_End(0);
+        AsyncIO_Dispatch(Read, false);
+        return;
+    }
+
+    Read->Descriptor = Descriptor;
+    Read->Offset = 0;
+    Read->File.Buffer.resize((size_t)Status.st_size);
+    if (Read->File.Buffer.empty()) {
+        AsyncIO_Finish(Read, true);
+    } else {
+        AsyncIO_Queue(Read);
+    }
+}
+#endif
+
+void AsyncIO_Start(thread_pool *Pool) {
+    IO.Pool = Pool;
+    IO.InFlight = 0;
+    IO.MaxInFlight = 0;
+    IO.Reads = 0;
+    IO.Bytes = 0;
+    IO.BusyTime = 0.0;
+#ifdef ASYNC_IO_URING
+    IO.Uring = Pool && AsyncIO_CreateRing(IO.Ring);
+    if (IO.Uring) {
+        IO.Reaper = std::thread(AsyncIO_Reap);
+    }
+#endif
+    std::lock_guard<std::mutex> Lock(IO.Mutex);
+    IO.Started = Pool != nullptr;
+}
+
+void AsyncIO_Stop() {
+    // Reads asked for from here on are made on the caller, the ring only
+    // has to drain
+    {
+        std::unique_lock<std::mutex> Lock(IO.Mutex);
+        IO.Started = false;
+        IO.Changed.notify_all();
+        IO.Changed.wait(Lock, [] { return IO.InFlight == 0; });
+    }
+#ifdef ASYNC_IO_URING
+    if (IO.Uring) {
+        if (AsyncIO_Submit(nullptr)) {
+            IO.Reaper.join();
+            AsyncIO_DestroyRing(IO.Ring);
+        } else {
+            // The reaper can't be woken, it keeps the ring until exit.
+            // Nothing is in flight, later reads block on the caller.
+            IO.Reaper.detach();
+        }
+    }
+#endif
+}
+
+void AsyncIO_Read(const std::string &Path, async_io_callback Done) {
+    async_io_read *Read = new async_io_read();
+    Read->Done = std::move(Done);
+    // Mapped already, the pages fault in on the worker that decodes them
+    bool Packed = AssetPack_Contains(Path);
+    bool Uring = false;
+#ifdef ASYNC_IO_URING
+    Uring = IO.Uring && !Packed;
+#endif
+    if (Packed || !AsyncIO_Begin(Uring)) {
+        bool Succeeded = AssetPack_Read(Read->File, Path);
+        if (Packed && IO.Started) {
+            AsyncIO_Dispatch(Read, Succeeded);
+        } else {
+            Read->Done(Read->File, Succeeded);
+            delete Read;
+        }
+        return;
+    }
+
+#ifdef ASYNC_IO_URING
+    if (Uring) {
+        AsyncIO_ReadUring(Read, Path);
+        return;
+    }
+#endif
+    // Without io_uring each read blocks a worker instead
+    ThreadPool_Submit(*IO.Pool, [Read, Path] {
+        bool Succeeded = AssetPack_Read(Read->File, Path);
+        AsyncIO_End(Read->File.Size);
+        Read->Done(Read->File, Succeeded);
+        delete Read;
+    });
+}
+
+async_io_stats AsyncIO_GetStats() {
+    std::lock_guard<std::mutex> Lock(IO.Mutex);
+    async_io_stats Stats;
+    Stats.Reads = IO.Reads;
+    Stats.Bytes = IO.Bytes;
+    Stats.InFlight = IO.InFlight;
+    Stats.MaxInFlight = IO.MaxInFlight;
+    double BusyTime = IO.BusyTime;
+    if (IO.InFlight > 0) {
+        BusyTime += std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - IO.BusyStart)
+                        .count();
+    }
+    Stats.BusyTime = (float)BusyTime;
+    Stats.BytesPerSecond =
+        BusyTime > 0.0 ? (float)(IO.Bytes / (BusyTime / 1000.0)) : 0.0f;
+#ifdef ASYNC_IO_URING
+    Stats.Uring = IO.Uring;
+#else
+    Stats.Uring = false;
+#endif
+    return Stats;
+}
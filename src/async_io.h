@@ -0,0 +1,44 @@
+#ifndef ASYNC_IO_H_
+#define ASYNC_IO_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "asset_pack.h"
+#include "thread_pool.h"
+
+// Whole-file reads that don't block the thread asking for them. Loose
+// files go through an io_uring on Linux, many reads in flight at once
+// with one thread collecting the completions. Without io_uring they are
+// blocking reads on the pool's workers. Files in the asset pack are mapped
+// already and skip the queue.
+#define ASYNC_IO_QUEUE_DEPTH 64
+
+// Read is false when the file couldn't be read. Runs on a pool worker,
+// File is only valid during the call.
+typedef std::function<void(asset_file &File, bool Read)> async_io_callback;
+
+struct async_io_stats {
+    int Reads;
+    uint64_t Bytes;
+    int InFlight;
+    // most reads in flight at once
+    int MaxInFlight;
+    // milliseconds with at least one read in flight
+    float BusyTime;
+    float BytesPerSecond;
+    bool Uring;
+};
+
+// Completions run on Pool. Until started, and after stopping, reads are
+// blocking and Done runs on the caller, as for the offline cook.
+void AsyncIO_Start(thread_pool *Pool);
+// Waits for the reads in flight, their callbacks may still be queued.
+// Reads asked for once it has begun are made on the caller. Before
+// ThreadPool_Destroy.
+void AsyncIO_Stop();
+// Any thread. Blocks only when ASYNC_IO_QUEUE_DEPTH reads are in flight.
+void AsyncIO_Read(const std::string &Path, async_io_callback Done);
+async_io_stats AsyncIO_GetStats();
+
+#endif
@@ -4,6 +4,7 @@
 #include "camera.h"
 #include "entity.h"
 #include "scene.h"
+#include "thread_pool.h"
 #include <GLFW/glfw3.h>
 
 struct context {
@@ -19,6 +20,8 @@ struct context {
 
     float DeltaTime;
     float LastFrame;
+    // milliseconds from glfwInit to the first swap, 0 until then
+    float FirstFrameTime;
 
     float LastX;
     float LastY;
@@ -26,6 +29,8 @@ struct context {
 
     int CurrentSceneIdx;
     std::vector<scene *> Scenes;
+    // Owned by main, a pointer so the context stays copyable
+    thread_pool *ThreadPool;
 };
 
 #endif
@@ -2,6 +2,7 @@
 #define ENTITY_H_
 
 #include <glm/glm.hpp>
+#include "lod_grid.h"
 #include "mesh.h"
 #include "model.h"
 #include "texture.h"
@@ -13,6 +14,9 @@ enum class entity_type {
     CubeMesh,
     QuadMesh,
     Model,
+    // Large grid surface drawn through a lod_grid, Mesh only holds the
+    // material
+    LodGrid,
 };
 
 struct entity {
@@ -23,6 +27,7 @@ struct entity {
     bool IsSelected;
     mesh Mesh;
     model *Model;
+    lod_grid *Grid;
 };
 
 enum class light_type {
@@ -31,6 +36,14 @@ enum class light_type {
     Spot,
 };
 
+// How a point light renders its omnidirectional shadow map. The dual
+// paraboloid mode only renders two hemispheres instead of six cube faces at
+// the cost of some distortion on large triangles.
+enum class point_shadow_mode {
+    Cubemap,
+    DualParaboloid,
+};
+
 struct light {
     entity Entity;
     glm::vec4 Color;
@@ -41,6 +54,7 @@ struct light {
     bool UseBlinn;
     bool CastsShadow;
     bool ShowDebug;
+    point_shadow_mode ShadowMode;
 };
 
 #endif
@@ -1,8 +1,11 @@
 #include "gui.h"
+#include "asset_pack.h"
+#include "async_io.h"
 #include "entity.h"
 #include "glm/gtc/type_ptr.hpp"
 #include "imgui/imgui.h"
 #include "scene.h"
+#include "texture_cache.h"
 
 gui Gui_Create(const context &Context) {
     // Setup Dear ImGui context
@@ -23,7 +26,24 @@ void Gui_NewFrame() {
     ImGui::NewFrame();
 }
 
-void Gui_Draw(context &Context) {
+// In front of the camera, drawn as the placeholder until it streamed in
+static void Gui_StreamModel(context &Context, renderer &Renderer,
+                            const char *File, std::string Key) {
+    model *Model =
+        ResourceManager_LoadModelAsync(Renderer.ResourceManager, File, Key);
+
+    entity Entity = {
+        .Type = entity_type::Model,
+        .Position = Context.Camera.Position + Context.Camera.Front * 5.0f,
+        .Scale = glm::vec3(0.3f),
+        .Rotation = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+        .IsSelected = false,
+        .Model = Model,
+    };
+    Scene_AddEntity(*Context.Scenes.at(Context.CurrentSceneIdx), Entity);
+}
+
+void Gui_Draw(context &Context, renderer &Renderer) {
     int CurrentSceneIdx = Context.CurrentSceneIdx;
     scene *CurrentScene = Context.Scenes.at(CurrentSceneIdx);
 
@@ -56,6 +76,192 @@ void Gui_Draw(context &Context) {
     ImGui::DragFloat("Exposure", &CurrentScene->HDRExposure, 0.01f, 0.0f,
                      10.0f);
     ImGui::Checkbox("Use Bloom", &CurrentScene->BloomEnabled);
+    ImGui::DragFloat("Bloom Radius", &Renderer.BloomFilterRadius, 0.0005f,
+                     0.0f, 0.05f, "%.4f");
+    ImGui::DragFloat("Bloom Threshold", &Renderer.BloomThreshold, 0.01f, 0.0f,
+                     10.0f);
+    ImGui::Checkbox("Color Grading", &CurrentScene->ColorGradingEnabled);
+    ImGui::DragFloat("Contrast", &CurrentScene->Contrast, 0.01f, 0.0f, 2.0f);
+    ImGui::DragFloat("Saturation", &CurrentScene->Saturation, 0.01f, 0.0f,
+                     2.0f);
+    ImGui::Text("Present: %s", Renderer.SceneFramebuffer == 0
+                                   ? "direct to backbuffer"
+                                   : "post-processing pass");
+    ImGui::End();
+
+    // Renderer
+    const char *DepthPrePassModes[] = {"Off", "On", "Auto"};
+    const char *TransparencyModes[] = {"Sorted", "Weighted Blended"};
+    const char *WaterModes[] = {"Planar", "Screen Space"};
+    ImGui::Begin("Renderer");
+    int DepthPrePassMode = (int)CurrentScene->DepthPrePassMode;
+    if (ImGui::Combo("Depth Pre-Pass", &DepthPrePassMode, DepthPrePassModes,
+                     IM_ARRAYSIZE(DepthPrePassModes))) {
+        CurrentScene->DepthPrePassMode = (depth_prepass_mode)DepthPrePassMode;
+    }
+    auto DepthPrePassState = Renderer.DepthPrePassStates.find(CurrentScene);
+    if (DepthPrePassState != Renderer.DepthPrePassStates.end()) {
+        ImGui::Text("Overdraw: %.2fx (pre-pass %s)",
+                    DepthPrePassState->second.Overdraw,
+                    DepthPrePassState->second.Active ? "on" : "off");
+    }
+    ImGui::DragFloat("Overdraw Threshold",
+                     &Renderer.DepthPrePassOverdrawThreshold, 0.01f, 1.0f,
+                     4.0f);
+    ImGui::Checkbox("Dynamic Resolution", &Renderer.DynamicResolutionEnabled);
+    ImGui::SliderFloat("Render Scale", &Renderer.RenderScale,
+                       Renderer.MinRenderScale, 1.0f);
+    ImGui::DragFloat("Target GPU Time (ms)", &Renderer.TargetFrameTime, 0.1f,
+                     1.0f, 100.0f);
+    ImGui::SliderFloat("Sharpness", &Renderer.Sharpness, 0.0f, 1.0f);
+    ImGui::Text("GPU: %.2f ms, scene %dx%d", Renderer.GPUFrameTime,
+                Renderer.SceneWidth, Renderer.SceneHeight);
+    ImGui::Text("Startup loading: %.1f ms, first frame after %.1f ms",
+                Renderer.ResourceManager.LoadTime, Context.FirstFrameTime);
+    texture_cache_stats TextureStats = TextureCache_GetStats();
+    ImGui::Text("Textures: %d cached (%.1f ms), %d decoded (%.1f ms), "
+                "upload %.1f ms",
+                TextureStats.Hits, TextureStats.LoadTime, TextureStats.Misses,
+                TextureStats.DecodeTime, TextureStats.UploadTime);
+    async_io_stats IOStats = AsyncIO_GetStats();
+    ImGui::Text("File reads: %d, %.1f MB at %.1f MB/s, %d in flight "
+                "(up to %d, %s)",
+                IOStats.Reads, IOStats.Bytes / (1024.0f * 1024.0f),
+                IOStats.BytesPerSecond / (1024.0f * 1024.0f),
+                IOStats.InFlight, IOStats.MaxInFlight,
+                IOStats.Uring ? "io_uring" : "thread pool");
+    int PackReads;
+    int LooseReads;
+    AssetPack_GetStats(PackReads, LooseReads);
+    ImGui::Text("Asset reads: %d from the pack, %d loose", PackReads,
+                LooseReads);
+    size_t TextureSize;
+    size_t UncompressedSize;
+    Scene_GetTextureMemory(*CurrentScene, TextureSize, UncompressedSize);
+    const char *Compression = "off";
+    if (Texture_IsCompressionSupported(texture_compression::BC1, false)) {
+        Compression = "BC1/BC3/BC4/BC5";
+    } else if (Texture_IsCompressionSupported(texture_compression::BC4,
+                                              false)) {
+        Compression = "BC4/BC5 only";
+    }
+    ImGui::Text("Scene textures: %.1f MB (%.1f MB uncompressed), "
+                "compression %s",
+                TextureSize / (1024.0f * 1024.0f),
+                UncompressedSize / (1024.0f * 1024.0f), Compression);
+    const shader_cache &ShaderCache = Renderer.ResourceManager.ShaderCache;
+    ImGui::Text("Shaders: %.1f ms at startup, %d cached, %d compiled "
+                "(%d stale), %d stages reused",
+                ShaderCache.StartupTime, ShaderCache.ProgramsLoaded,
+                ShaderCache.ProgramsCompiled, ShaderCache.ProgramsStale,
+                ShaderCache.StagesReused);
+    ImGui::Text("Permutations compiling: %d (parallel compile %s)",
+                Renderer.ResourceManager.PendingLitShaders,
+                Renderer.ResourceManager.ParallelShaderCompile ? "on" : "off");
+    int TransparencyMode = (int)CurrentScene->TransparencyMode;
+    if (ImGui::Combo("Transparency", &TransparencyMode, TransparencyModes,
+                     IM_ARRAYSIZE(TransparencyModes))) {
+        CurrentScene->TransparencyMode = (transparency_mode)TransparencyMode;
+    }
+    int WaterMode = (int)CurrentScene->WaterMode;
+    if (ImGui::Combo("Water", &WaterMode, WaterModes,
+                     IM_ARRAYSIZE(WaterModes))) {
+        CurrentScene->WaterMode = (water_mode)WaterMode;
+    }
+    if (CurrentScene->WaterMode == water_mode::Planar) {
+        ImGui::SliderInt("Water Update Interval",
+                         &Renderer.PlanarWaterInterval, 1, 8);
+        ImGui::DragFloat("Water Min Object Size",
+                         &Renderer.PlanarWaterMinObjectSize, 0.001f, 0.0f,
+                         0.2f, "%.3f rad");
+        ImGui::Text("Water targets: %s, %.0f%%",
+                    Renderer.PlanarWaterVisible ? "visible" : "skipped",
+                    Renderer.PlanarWaterScale * 100.0f);
+    }
+    for (size_t i = 0; i < CurrentScene->Grids.size(); i++) {
+        const lod_grid &Grid = CurrentScene->Grids[i];
+        ImGui::Text("LOD Grid %d: %d patches, %d levels", (int)(i + 1),
+                    LodGrid_GetNodeCount(Grid), Grid.LevelCount);
+    }
+    if (CurrentScene->OceanEnabled && ImGui::TreeNode("Ocean")) {
+        ocean &Ocean = CurrentScene->Ocean;
+        const char *OceanResolutions[] = {"64", "128", "256", "512"};
+        int ResolutionIdx = 0;
+        while ((64 << ResolutionIdx) < Ocean.Spectrum.Resolution) {
+            ResolutionIdx++;
+        }
+        if (ImGui::Combo("FFT Size", &ResolutionIdx, OceanResolutions,
+                         IM_ARRAYSIZE(OceanResolutions))) {
+            Ocean_SetResolution(Ocean, 64 << ResolutionIdx);
+        }
+        ImGui::SliderFloat("Choppiness", &Ocean.Choppiness, 0.0f, 2.0f);
+        ImGui::Text("Simulation: %.2f ms on %u threads, %d stalled frames",
+                    Ocean.SimulationTime,
+                    ThreadPool_GetThreadCount(Context.ThreadPool),
+                    Ocean.StalledFrames);
+        if (ImGui::Button("Benchmark FFT Sizes")) {
+            Ocean_Benchmark(Ocean, *Context.ThreadPool);
+        }
+        // compared against the frame, the step has that long to finish
+        float FrameTime = Context.DeltaTime * 1000.0f;
+        for (const ocean_benchmark &Benchmark : Ocean.Benchmarks) {
+            ImGui::Text("%dx%d: %.2f ms (%.2f ms single), %.0f%% of frame",
+                        Benchmark.Resolution, Benchmark.Resolution,
+                        Benchmark.Time, Benchmark.SingleThreadTime,
+                        FrameTime > 0.0f ? Benchmark.Time / FrameTime * 100.0f
+                                         : 0.0f);
+        }
+        ImGui::TreePop();
+    }
+    if (ImGui::TreeNode("Streaming")) {
+        asset_stream &Stream = *Renderer.ResourceManager.Stream;
+        int BudgetKB = (int)(Stream.FrameByteBudget / 1024);
+        if (ImGui::SliderInt("Upload Budget (KB)", &BudgetKB, 64, 32768)) {
+            Stream.FrameByteBudget = (size_t)BudgetKB * 1024;
+        }
+        ImGui::SliderFloat("Upload Time Budget (ms)", &Stream.FrameTimeBudget,
+                           0.1f, 16.0f);
+        ImGui::Text("%d pending, last frame %.0f KB in %.2f ms (max %.2f)",
+                    AssetStream_GetPendingCount(Stream),
+                    Stream.LastFrameBytes / 1024.0f, Stream.LastFrameTime,
+                    Stream.MaxFrameTime);
+        if (ImGui::Button("Stream Cyborg")) {
+            Gui_StreamModel(Context, Renderer,
+                            "./resources/models/cyborg/cyborg.obj",
+                            "cyborg_model");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Stream Nanosuit")) {
+            Gui_StreamModel(Context, Renderer,
+                            "./resources/models/nanosuit/nanosuit.obj",
+                            "nanosuit_model");
+        }
+        if (ImGui::Button("Benchmark Model Import")) {
+            ResourceManager_BenchmarkImports(Renderer.ResourceManager,
+                                             Context.ThreadPool);
+        }
+        for (const model_import_benchmark &Benchmark :
+             Renderer.ResourceManager.ImportBenchmarks) {
+            ImGui::Text("%s: %d meshes, %d vertices, read %.1f ms, "
+                        "convert %.2f ms on %u threads (%.2f ms single)",
+                        Benchmark.Path.c_str(), Benchmark.MeshCount,
+                        Benchmark.VertexCount, Benchmark.ReadTime,
+                        Benchmark.Time,
+                        ThreadPool_GetThreadCount(Context.ThreadPool),
+                        Benchmark.SingleThreadTime);
+        }
+        ImGui::TreePop();
+    }
+    if (ImGui::TreeNode("Render Graph")) {
+        ImGui::Text("%d passes culled, %d transients in %d textures",
+                    Renderer.Graph.CulledPassCount,
+                    Renderer.Graph.TransientCount,
+                    Renderer.Graph.PhysicalCount);
+        for (const render_graph_pass &Pass : Renderer.Graph.Passes) {
+            ImGui::Text("%s%s", Pass.Name, Pass.Culled ? " (culled)" : "");
+        }
+        ImGui::TreePop();
+    }
     ImGui::End();
 
     // Scenes
@@ -77,6 +283,14 @@ void Gui_Draw(context &Context) {
         ImGui::Checkbox("Enabled", &Light.IsEnabled);
         ImGui::Checkbox("Use Blinn", &Light.UseBlinn);
         ImGui::Checkbox("Casts Shadow", &Light.CastsShadow);
+        if (Light.LightType == light_type::Point) {
+            const char *ShadowModes[] = {"Cubemap", "Dual Paraboloid"};
+            int ShadowMode = (int)Light.ShadowMode;
+            if (ImGui::Combo("Shadow Mode", &ShadowMode, ShadowModes,
+                             IM_ARRAYSIZE(ShadowModes))) {
+                Light.ShadowMode = (point_shadow_mode)ShadowMode;
+            }
+        }
         ImGui::DragFloat3("Position", glm::value_ptr(Light.Entity.Position),
                           0.1f);
         ImGui::ColorEdit4("Color", glm::value_ptr(Light.Color));
@@ -2,6 +2,7 @@
 #define GUI_H_
 
 #include "context.h"
+#include "renderer.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -14,7 +15,7 @@ struct gui {
 
 gui Gui_Create(const context &Context);
 void Gui_NewFrame();
-void Gui_Draw(context &Context);
+void Gui_Draw(context &Context, renderer &Renderer);
 void Gui_Destroy();
 
 #endif
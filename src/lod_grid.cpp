@@ -0,0 +1,295 @@
+#include "lod_grid.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+
+static void LodGrid_CreatePatch(lod_grid_patch &Patch, int Resolution,
+                                GLuint InstanceVBO) {
+    std::vector<glm::vec2> Vertices;
+    std::vector<GLuint> Indices;
+    Vertices.reserve((Resolution + 1) * (Resolution + 1));
+    Indices.reserve(Resolution * Resolution * 6);
+
+    for (int z = 0; z <= Resolution; z++) {
+        for (int x = 0; x <= Resolution; x++) {
+            Vertices.push_back(glm::vec2((float)x, (float)z));
+        }
+    }
+
+    // Counter-clockwise seen from above, same as Mesh_CreateGrid
+    for (int z = 0; z < Resolution; z++) {
+        for (int x = 0; x < Resolution; x++) {
+            GLuint TopLeft = z * (Resolution + 1) + x;
+            GLuint TopRight = TopLeft + 1;
+            GLuint BottomLeft = (z + 1) * (Resolution + 1) + x;
+            GLuint BottomRight = BottomLeft + 1;
+
+            Indices.push_back(TopLeft);
+            Indices.push_back(BottomLeft);
+            Indices.push_back(TopRight);
+
+            Indices.push_back(TopRight);
+            Indices.push_back(BottomLeft);
+            Indices.push_back(BottomRight);
+        }
+    }
+
+    Patch.Resolution = Resolution;
+    Patch.IndicesNum = (GLsizei)Indices.size();
+
+    glGenVertexArrays(1, &Patch.VAO);
+    glGenBuffers(1, &Patch.VBO);
+    glGenBuffers(1, &Patch.EBO);
+
+    glBindVertexArray(Patch.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, Patch.VBO);
+    glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(glm::vec2),
+                 &Vertices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Patch.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(GLuint),
+                 &Indices[0], GL_STATIC_DRAW);
+
+    // grid position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2),
+                          (void *)0);
+    // node, the offset into the instance buffer is set when drawing
+    glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4),
+                          (void *)0);
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+}
+
+void LodGrid_Create(lod_grid &Grid, float Size, int LevelCount,
+                    int PatchResolution, float RangeScale) {
+    Grid = {};
+
+    // The quarter patch has to keep the odd/even vertex pattern of the full
+    // one for the morph to line up
+    if (PatchResolution < 4 || PatchResolution % 4 != 0) {
+        std::cout << "ERROR::LOD_GRID:: Patch resolution " << PatchResolution
+                  << " is not a multiple of 4" << std::endl;
+        PatchResolution = std::max((PatchResolution + 3) / 4 * 4, 4);
+    }
+    LevelCount = std::clamp(LevelCount, 1, LOD_GRID_MAX_LEVELS);
+    // A node reaches up to its diagonal past its range, below ~2 node sizes
+    // that gets into the morph of the next level and opens cracks
+    RangeScale = std::max(RangeScale, 2.1f);
+
+    Grid.Size = Size;
+    Grid.LevelCount = LevelCount;
+    Grid.LeafSize = Size / (float)(1 << (LevelCount - 1));
+
+    float PreviousRange = 0.0f;
+    for (int Level = 0; Level < LevelCount; Level++) {
+        if (Level == LevelCount - 1) {
+            // The root is always drawn and has nothing to morph into
+            Grid.Ranges[Level] = std::numeric_limits<float>::max();
+            Grid.Morph[Level] = glm::vec2(1e30f, 2e30f);
+            break;
+        }
+        float Range = RangeScale * Grid.LeafSize * (float)(1 << Level);
+        Grid.Ranges[Level] = Range;
+        Grid.Morph[Level] = glm::vec2(
+            PreviousRange + (Range - PreviousRange) * 0.7f, Range);
+        PreviousRange = Range;
+    }
+
+    glGenBuffers(1, &Grid.InstanceVBO);
+    LodGrid_CreatePatch(Grid.Patches[0], PatchResolution, Grid.InstanceVBO);
+    LodGrid_CreatePatch(Grid.Patches[1], PatchResolution / 2,
+                        Grid.InstanceVBO);
+}
+
+void LodGrid_SetHeightmap(lod_grid &Grid, const std::vector<float> &Heights,
+                          int Resolution) {
+    if (Heights.size() != (size_t)Resolution * Resolution) {
+        std::cout << "ERROR::LOD_GRID:: Heightmap needs " << Resolution << "x"
+                  << Resolution << " heights" << std::endl;
+        return;
+    }
+
+    auto [Min, Max] = std::minmax_element(Heights.begin(), Heights.end());
+    Grid.MinHeight = *Min;
+    Grid.MaxHeight = *Max;
+
+    if (!Grid.Heightmap) {
+        glGenTextures(1, &Grid.Heightmap);
+    }
+    glBindTexture(GL_TEXTURE_2D, Grid.Heightmap);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, Resolution, Resolution, 0, GL_RED,
+                 GL_FLOAT, &Heights[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static bool LodGrid_NodeInFrustum(const lod_grid &Grid, glm::vec2 Origin,
+                                  float Size, const glm::vec4 Planes[6]) {
+    glm::vec3 Min = glm::vec3(Origin.x, Grid.MinHeight, Origin.y);
+    glm::vec3 Max = glm::vec3(Origin.x + Size, Grid.MaxHeight, Origin.y + Size);
+    for (unsigned int i = 0; i < 6; i++) {
+        // the corner furthest along the plane normal
+        glm::vec3 Corner = glm::vec3(Planes[i].x >= 0.0f ? Max.x : Min.x,
+                                     Planes[i].y >= 0.0f ? Max.y : Min.y,
+                                     Planes[i].z >= 0.0f ? Max.z : Min.z);
+        if (glm::dot(glm::vec3(Planes[i]), Corner) + Planes[i].w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Closest distance of the node under the metric of the vertex shaders
+static float LodGrid_NodeDistance(const lod_grid &Grid, glm::vec2 Origin,
+                                  float Size) {
+    glm::vec2 View = glm::vec2(Grid.LodView.x, Grid.LodView.z);
+    glm::vec2 Delta = View - glm::clamp(View, Origin, Origin + Size);
+    return glm::length(glm::vec3(Delta.x, Grid.LodView.y, Delta.y));
+}
+
+// Returns false when the node is out of the range of its level and has to
+// be covered by its parent
+static bool LodGrid_SelectNode(lod_grid &Grid, glm::vec2 Origin, float Size,
+                               int Level, const glm::vec4 Planes[6]) {
+    if (!LodGrid_NodeInFrustum(Grid, Origin, Size, Planes)) {
+        // nothing to draw, but handled
+        return true;
+    }
+
+    float Distance = LodGrid_NodeDistance(Grid, Origin, Size);
+    if (Distance > Grid.Ranges[Level]) {
+        return false;
+    }
+    if (Level == 0 || Distance > Grid.Ranges[Level - 1]) {
+        Grid.Nodes[0].push_back(glm::vec4(Origin, Size, (float)Level));
+        return true;
+    }
+
+    float Half = Size * 0.5f;
+    for (unsigned int i = 0; i < 4; i++) {
+        glm::vec2 ChildOrigin =
+            Origin + glm::vec2(i & 1 ? Half : 0.0f, i & 2 ? Half : 0.0f);
+        if (!LodGrid_SelectNode(Grid, ChildOrigin, Half, Level - 1, Planes)) {
+            // keeps the cells of this level
+            Grid.Nodes[1].push_back(glm::vec4(ChildOrigin, Half, (float)Level));
+        }
+    }
+    return true;
+}
+
+void LodGrid_Select(lod_grid &Grid, glm::vec3 ViewPosition,
+                    const glm::vec4 FrustumPlanes[6]) {
+    // The height of a vertex doesn't change its distance, only how far the
+    // view is from the whole height range. The nodes and the vertex shaders
+    // then agree on every distance.
+    float Above = std::max(ViewPosition.y - Grid.MaxHeight, 0.0f);
+    float Below = std::max(Grid.MinHeight - ViewPosition.y, 0.0f);
+    Grid.LodView = glm::vec3(ViewPosition.x, Above + Below, ViewPosition.z);
+
+    Grid.Nodes[0].clear();
+    Grid.Nodes[1].clear();
+    float HalfSize = Grid.Size * 0.5f;
+    LodGrid_SelectNode(Grid, glm::vec2(-HalfSize), Grid.Size,
+                       Grid.LevelCount - 1, FrustumPlanes);
+}
+
+static void LodGrid_BindMaterial(const shader &Shader,
+                                 const material &Material) {
+    Shader_SetFloat(Shader, "u_material.shininess", Material.Shininess);
+    Shader_SetInt(Shader, "u_material.has_specular", 0);
+    Shader_SetInt(Shader, "u_material.has_normal", 0);
+    Shader_SetInt(Shader, "u_reverse_normal", 0);
+
+    for (unsigned int i = 0; i < Material.Textures.size(); i++) {
+        const texture *Texture = Material.Textures[i];
+        if (Texture->Name == "specular") {
+            Shader_SetInt(Shader, "u_material.has_specular", 1);
+        } else if (Texture->Name == "normal") {
+            Shader_SetInt(Shader, "u_material.has_normal", 1);
+        }
+        Shader_SetInt(Shader, ("u_material." + Texture->Name).c_str(), i);
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(Texture->Type, Texture->ID);
+    }
+}
+
+void LodGrid_Draw(const lod_grid &Grid, const shader &Shader,
+                  const material &Material) {
+    if (Grid.Nodes[0].empty() && Grid.Nodes[1].empty()) {
+        return;
+    }
+
+    Shader_Use(Shader);
+    LodGrid_BindMaterial(Shader, Material);
+
+    // Units 0-6 are taken by the materials, the shadow maps and the water
+    glActiveTexture(GL_TEXTURE7);
+    glBindTexture(GL_TEXTURE_2D, Grid.Heightmap);
+    Shader_SetInt(Shader, "u_heightmap", 7);
+
+    Shader_SetFloat(Shader, "u_lod_size", Grid.Size);
+    Shader_SetVec3(Shader, "u_lod_view", Grid.LodView);
+    char Name[32];
+    for (int Level = 0; Level < Grid.LevelCount; Level++) {
+        snprintf(Name, sizeof(Name), "u_lod_morph[%d]", Level);
+        Shader_SetVec2(Shader, Name, Grid.Morph[Level]);
+    }
+
+    // Both patches read from one buffer, the quarter nodes come after the
+    // full ones
+    size_t NodeCount = Grid.Nodes[0].size() + Grid.Nodes[1].size();
+    glBindBuffer(GL_ARRAY_BUFFER, Grid.InstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, NodeCount * sizeof(glm::vec4), NULL,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    Grid.Nodes[0].size() * sizeof(glm::vec4),
+                    Grid.Nodes[0].data());
+    glBufferSubData(GL_ARRAY_BUFFER, Grid.Nodes[0].size() * sizeof(glm::vec4),
+                    Grid.Nodes[1].size() * sizeof(glm::vec4),
+                    Grid.Nodes[1].data());
+
+    size_t FirstNode = 0;
+    for (unsigned int i = 0; i < 2; i++) {
+        const lod_grid_patch &Patch = Grid.Patches[i];
+        size_t Count = Grid.Nodes[i].size();
+        if (Count > 0) {
+            Shader_SetFloat(Shader, "u_lod_patch_resolution",
+                            (float)Patch.Resolution);
+            glBindVertexArray(Patch.VAO);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4),
+                                  (void *)(FirstNode * sizeof(glm::vec4)));
+            glDrawElementsInstanced(GL_TRIANGLES, Patch.IndicesNum,
+                                    GL_UNSIGNED_INT, 0, (GLsizei)Count);
+        }
+        FirstNode += Count;
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+int LodGrid_GetNodeCount(const lod_grid &Grid) {
+    return (int)(Grid.Nodes[0].size() + Grid.Nodes[1].size());
+}
+
+void LodGrid_Destroy(lod_grid &Grid) {
+    for (lod_grid_patch &Patch : Grid.Patches) {
+        glDeleteVertexArrays(1, &Patch.VAO);
+        glDeleteBuffers(1, &Patch.VBO);
+        glDeleteBuffers(1, &Patch.EBO);
+    }
+    glDeleteBuffers(1, &Grid.InstanceVBO);
+    if (Grid.Heightmap) {
+        glDeleteTextures(1, &Grid.Heightmap);
+    }
+    Grid = {};
+}
@@ -0,0 +1,68 @@
+#ifndef LOD_GRID_H_
+#define LOD_GRID_H_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "material.h"
+#include "shader.h"
+
+#define LOD_GRID_MAX_LEVELS 8
+
+// Quadtree LOD for large grid surfaces (water, heightmap terrain), after
+// CDLOD. The surface is a square on the local xz plane. Every frame the
+// quadtree picks nodes by distance to the camera, with ranges doubling per
+// level, so a node twice as far has cells twice as big and the cell size on
+// screen stays roughly constant.
+//
+// Every node is an instance of one of two shared patches: a full node, or a
+// quarter of a node at the same cell size where a parent is only partly in
+// the range of its children. Towards the end of its range a node slides its
+// odd vertices onto the grid of the next level in the vertex shader, so
+// where two levels meet the finer side already matches the coarser one and
+// no cracks open. See water.vert and terrain.vert.
+struct lod_grid_patch {
+    // Vertex positions in cells, 8 bytes a vertex
+    GLuint VAO;
+    GLuint VBO;
+    GLuint EBO;
+    GLsizei IndicesNum;
+    int Resolution; // cells per side
+};
+
+struct lod_grid {
+    // [0] covers a whole node, [1] a quarter of it
+    lod_grid_patch Patches[2];
+    // Selected nodes per patch: origin (xy), size (z) and level (w)
+    std::vector<glm::vec4> Nodes[2];
+    GLuint InstanceVBO;
+
+    float Size; // side of the whole surface, centered on the origin
+    int LevelCount;
+    float LeafSize;
+    float Ranges[LOD_GRID_MAX_LEVELS];
+    // Distance where each level starts and ends morphing into the next one
+    glm::vec2 Morph[LOD_GRID_MAX_LEVELS];
+
+    // Optional R32F heightmap covering the whole surface, 0 when flat
+    GLuint Heightmap;
+    float MinHeight;
+    float MaxHeight;
+
+    // Distances are measured from here: the view position on xz, and in y
+    // how far it is above or below the height range. Set by LodGrid_Select.
+    glm::vec3 LodView;
+};
+
+void LodGrid_Create(lod_grid &Grid, float Size, int LevelCount,
+                    int PatchResolution, float RangeScale = 2.5f);
+void LodGrid_SetHeightmap(lod_grid &Grid, const std::vector<float> &Heights,
+                          int Resolution);
+void LodGrid_Select(lod_grid &Grid, glm::vec3 ViewPosition,
+                    const glm::vec4 FrustumPlanes[6]);
+void LodGrid_Draw(const lod_grid &Grid, const shader &Shader,
+                  const material &Material);
+int LodGrid_GetNodeCount(const lod_grid &Grid);
+void LodGrid_Destroy(lod_grid &Grid);
+
+#endif
@@ -2,13 +2,18 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <string>
 
+#include "asset_pack.h"
+#include "asset_stream.h"
+#include "async_io.h"
 #include "camera.h"
 #include "context.h"
 #include "gui.h"
 #include "renderer.h"
 #include "resource_manager.h"
 #include "scene.h"
+#include "thread_pool.h"
 
 void FramebufferSizeCallback(GLFWwindow *Window, int Width, int Height);
 void MouseScrollCallback(GLFWwindow *Window, double OffsetX, double OffsetY);
@@ -20,13 +25,51 @@ const unsigned int SCREEN_HEIGHT = 800;
 
 context Context = {0};
 
-int main() {
+int main(int argc, char **argv) {
+    // offline pack: bin/3DEngine --pack writes ./resources.pack and exits
+    if (argc > 1 && std::string(argv[1]) == "--pack") {
+        return AssetPack_Write("./resources", ASSET_PACK_PATH) ? 0 : 1;
+    }
+    // --loose reads everything from ./resources without mapping the pack,
+    // --check-stale keeps the pack but prefers files edited since packing
+    bool Loose = false;
+    bool CheckStale = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--loose") {
+            Loose = true;
+        } else if (std::string(argv[i]) == "--check-stale") {
+            CheckStale = true;
+        }
+    }
+    if (!Loose) {
+        AssetPack_Mount(ASSET_PACK_PATH, CheckStale);
+    }
+
+    // offline cook: bin/3DEngine --cook writes ./cache/meshes and exits
+    if (argc > 1 && std::string(argv[1]) == "--cook") {
+        thread_pool ThreadPool;
+        ThreadPool_Create(ThreadPool);
+        bool Cooked = ResourceManager_CookModels(&ThreadPool);
+        ThreadPool_Destroy(ThreadPool);
+        AssetPack_Unmount();
+        return Cooked ? 0 : 1;
+    }
+    // --uncompressed keeps textures as decoded, to compare video memory
+    bool CompressTextures = true;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--uncompressed") {
+            CompressTextures = false;
+        }
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // lets the renderer skip the present pass when no effect is active
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -63,6 +106,7 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    Texture_InitCompression(CompressTextures);
 
     glfwGetFramebufferSize(Context.Window, &Context.FramebufferWidth,
                            &Context.FramebufferHeight);
@@ -70,11 +114,17 @@ int main() {
     Context.ScreenHeight = Context.FramebufferHeight;
     glViewport(0, 0, Context.FramebufferWidth, Context.FramebufferHeight);
 
+    thread_pool ThreadPool;
+    ThreadPool_Create(ThreadPool);
+    Context.ThreadPool = &ThreadPool;
+    AsyncIO_Start(&ThreadPool);
+
     gui Gui = Gui_Create(Context);
     renderer Renderer = Renderer_Create(Context);
-    ResourceManager_LoadTextures(Renderer.ResourceManager);
-    ResourceManager_LoadModels(Renderer.ResourceManager);
-    ResourceManager_LoadShaders(Renderer.ResourceManager);
+    asset_stream AssetStream;
+    AssetStream_Create(AssetStream, &ThreadPool);
+    Renderer.ResourceManager.Stream = &AssetStream;
+    ResourceManager_LoadAssets(Renderer.ResourceManager, &ThreadPool);
     Renderer_SetTextureUniforms(Renderer);
     camera Camera = Camera_Create(glm::vec3(0.0f, 0.0f, 3.0f),
                                   glm::vec3(0.0f, 1.0f, 0.0f), YAW, PITCH);
@@ -186,22 +236,40 @@ int main() {
         // ------
         Renderer_ClearBackground(0.01f, 0.01f, 0.01f, 1.0f);
 
+        // whatever finished loading and fits this frame's upload budget
+        AssetStream_Update(AssetStream);
+
         scene *CurrentScene = Context.Scenes.at(Context.CurrentSceneIdx);
+        Scene_Update(*CurrentScene, ThreadPool, Context.LastFrame);
         Renderer_Draw(Renderer, *CurrentScene, Context);
 
         // gui
         // ------
-        Gui_Draw(Context);
+        Gui_Draw(Context, Renderer);
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse
         // moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(Context.Window);
         glfwPollEvents();
+
+        if (Context.FirstFrameTime == 0.0f) {
+            // glfwGetTime counts from glfwInit
+            Context.FirstFrameTime = (float)(glfwGetTime() * 1000.0);
+        }
+    }
+
+    // Scenes first, their jobs may still be running on the pool
+    for (scene *Scene : Context.Scenes) {
+        Scene_Destroy(*Scene);
     }
+    AsyncIO_Stop();
+    ThreadPool_Destroy(ThreadPool);
 
     Gui_Destroy();
     Renderer_Destroy(Renderer);
+    AssetStream_Destroy(AssetStream);
+    AssetPack_Unmount();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
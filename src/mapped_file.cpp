@@ -0,0 +1,41 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile_Open(mapped_file &File, const char *Path) {
+    File.Data = nullptr;
+    File.Size = 0;
+
+    int Descriptor = open(Path, O_RDONLY);
+    if (Descriptor < 0) {
+        return false;
+    }
+    struct stat Stat;
+    if (fstat(Descriptor, &Stat) != 0 || Stat.st_size <= 0) {
+        close(Descriptor);
+        return false;
+    }
+
+    void *Data = mmap(nullptr, (size_t)Stat.st_size, PROT_READ, MAP_PRIVATE,
+                      Descriptor, 0);
+    // the mapping keeps its own reference to the file
+    close(Descriptor);
+    if (Data == MAP_FAILED) {
+        return false;
+    }
+
+    File.Data = (const unsigned char *)Data;
+    File.Size = (size_t)Stat.st_size;
+    return true;
+}
+
+void MappedFile_Close(mapped_file &File) {
+    if (File.Data) {
+        munmap((void *)File.Data, File.Size);
+    }
+    File.Data = nullptr;
+    File.Size = 0;
+}
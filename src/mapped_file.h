@@ -0,0 +1,18 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <cstddef>
+
+// A whole file mapped read only. Pages are only read in when touched, so
+// opening costs the same however large the file is.
+struct mapped_file {
+    const unsigned char *Data;
+    size_t Size;
+};
+
+// False for missing and empty files, File is then left closed
+bool MappedFile_Open(mapped_file &File, const char *Path);
+// Safe on a closed file
+void MappedFile_Close(mapped_file &File);
+
+#endif
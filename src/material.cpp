@@ -1,4 +1,5 @@
 #include "material.h"
+#include "shader.h"
 
 void Material_Create(material &Material) {
     Material.HasNormalMap = false;
@@ -7,5 +8,18 @@ void Material_Create(material &Material) {
     Material.Shininess = 10.0f;
     Material.CullFace = true;
     Material.ReverseNormal = false;
+    Material.IsTransparent = false;
     Material.Color = glm::vec4(1.0f);
 }
+
+unsigned int Material_GetShaderFeatures(const material &Material) {
+    unsigned int Features = 0;
+    for (const texture *Texture : Material.Textures) {
+        if (Texture->Name == "normal") {
+            Features |= SHADER_FEATURE_NORMAL_MAP;
+        } else if (Texture->Name == "specular") {
+            Features |= SHADER_FEATURE_SPECULAR_MAP;
+        }
+    }
+    return Features;
+}
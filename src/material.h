@@ -19,8 +19,12 @@ struct material {
     float Shininess;
     bool CullFace;
     bool ReverseNormal;
+    // Blended instead of alpha tested, see Renderer_TransparentPass
+    bool IsTransparent;
 };
 
 void Material_Create(material &Material);
+// shader_feature bits the material's textures need
+unsigned int Material_GetShaderFeatures(const material &Material);
 
 #endif
@@ -5,14 +5,49 @@
 
 void Mesh_Create(mesh *Mesh, std::vector<vertex> Vertices,
                  std::vector<GLuint> Indices, material Material) {
-    Mesh->Vertices = Vertices;
-    Mesh->Indices = Indices;
+    Mesh->Vertices = std::move(Vertices);
+    Mesh->Indices = std::move(Indices);
     Mesh->Material = Material;
 
+    Mesh->BoundsMin = glm::vec3(0.0f);
+    Mesh->BoundsMax = glm::vec3(0.0f);
+    if (!Mesh->Vertices.empty()) {
+        Mesh->BoundsMin = Mesh->Vertices[0].Position;
+        Mesh->BoundsMax = Mesh->Vertices[0].Position;
+        for (const vertex &Vertex : Mesh->Vertices) {
+            Mesh->BoundsMin = glm::min(Mesh->BoundsMin, Vertex.Position);
+            Mesh->BoundsMax = glm::max(Mesh->BoundsMax, Vertex.Position);
+        }
+    }
+
+    Mesh->IndicesNum = (GLsizei)Mesh->Indices.size();
+
     Mesh_Setup(Mesh);
 }
 
+void Mesh_CreateFromMemory(mesh *Mesh, const vertex *Vertices,
+                           const glm::vec3 *Positions, size_t VertexCount,
+                           const GLuint *Indices, size_t IndexCount,
+                           material Material, glm::vec3 BoundsMin,
+                           glm::vec3 BoundsMax) {
+    Mesh->Material = Material;
+    Mesh->BoundsMin = BoundsMin;
+    Mesh->BoundsMax = BoundsMax;
+    Mesh->IndicesNum = (GLsizei)IndexCount;
+
+    Mesh_SetupBuffers(Mesh, Vertices, VertexCount, Indices, IndexCount);
+    Mesh_SetupDepthBuffer(Mesh, Positions, VertexCount);
+}
+
 void Mesh_Setup(mesh *Mesh) {
+    Mesh_SetupBuffers(Mesh, Mesh->Vertices.data(), Mesh->Vertices.size(),
+                      Mesh->Indices.data(), Mesh->Indices.size());
+    Mesh_SetupDepth(Mesh);
+}
+
+void Mesh_SetupBuffers(mesh *Mesh, const vertex *Vertices,
+                       size_t VertexCount, const GLuint *Indices,
+                       size_t IndexCount) {
     // create buffers/arrays
     glGenVertexArrays(1, &Mesh->VAO);
     glGenBuffers(1, &Mesh->VBO);
@@ -25,13 +60,12 @@ void Mesh_Setup(mesh *Mesh) {
     // all its items. The effect is that we can simply pass a pointer to the
     // struct and it translates perfectly to a glm::vec3/2 array which again
     // translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, Mesh->Vertices.size() * sizeof(vertex),
-                 &Mesh->Vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, VertexCount * sizeof(vertex), Vertices,
+                 GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh->EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 Mesh->Indices.size() * sizeof(unsigned int), &Mesh->Indices[0],
-                 GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, IndexCount * sizeof(unsigned int),
+                 Indices, GL_STATIC_DRAW);
 
     // set the vertex attribute pointers
     // vertex Positions
@@ -65,6 +99,37 @@ void Mesh_Setup(mesh *Mesh) {
     glBindVertexArray(0);
 }
 
+void Mesh_SetupDepth(mesh *Mesh) {
+    // Depth-only passes only need the position, so keep a tightly packed
+    // 12-byte stream instead of fetching the full interleaved vertex.
+    std::vector<glm::vec3> Positions;
+    Positions.reserve(Mesh->Vertices.size());
+    for (const vertex &Vertex : Mesh->Vertices) {
+        Positions.push_back(Vertex.Position);
+    }
+    Mesh_SetupDepthBuffer(Mesh, Positions.data(), Positions.size());
+}
+
+void Mesh_SetupDepthBuffer(mesh *Mesh, const glm::vec3 *Positions,
+                           size_t Count) {
+    glGenVertexArrays(1, &Mesh->DepthVAO);
+    glGenBuffers(1, &Mesh->DepthVBO);
+
+    glBindVertexArray(Mesh->DepthVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, Mesh->DepthVBO);
+    glBufferData(GL_ARRAY_BUFFER, Count * sizeof(glm::vec3), Positions,
+                 GL_STATIC_DRAW);
+
+    // reuse the index buffer of the full vertex layout
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh->EBO);
+
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                          (void *)0);
+    glBindVertexArray(0);
+}
+
 void Mesh_Draw(const mesh &Mesh, shader Shader) {
     // bind appropriate textures
     unsigned int DiffuseNr = 1;
@@ -116,8 +181,7 @@ void Mesh_Draw(const mesh &Mesh, shader Shader) {
 
     // draw mesh
     glBindVertexArray(Mesh.VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(Mesh.Indices.size()),
-                   GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, Mesh.IndicesNum, GL_UNSIGNED_INT, 0);
     glBindVertexArray(0);
 
     // always good practice to set everything back to defaults once configured.
@@ -164,9 +228,8 @@ void Mesh_DrawInstance(const mesh &Mesh, shader Shader,
 
     // draw mesh
     glBindVertexArray(Mesh.VAO);
-    glDrawElementsInstanced(GL_TRIANGLES,
-                            static_cast<unsigned int>(Mesh.Indices.size()),
-                            GL_UNSIGNED_INT, 0, InstancesNum);
+    glDrawElementsInstanced(GL_TRIANGLES, Mesh.IndicesNum, GL_UNSIGNED_INT, 0,
+                            InstancesNum);
     glBindVertexArray(0);
 
     // always good practice to set everything back to defaults once configured.
@@ -22,23 +22,46 @@ struct vertex {
 };
 
 struct mesh {
+    // Empty for meshes created from memory, IndicesNum is what gets drawn
     std::vector<vertex> Vertices;
     std::vector<unsigned int> Indices;
+    GLsizei IndicesNum;
 
     material Material;
 
     GLuint VAO;
     GLuint VBO;
     GLuint EBO;
+
+    // Position-only stream used by depth-only passes (shadows, pre-pass).
+    // Shares the EBO with the full vertex layout.
+    GLuint DepthVAO;
+    GLuint DepthVBO;
+    // Local space bounding box, used for CPU culling
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
 };
 
 void Mesh_Create(mesh *Mesh, std::vector<vertex> Vertices,
                  std::vector<GLuint> Indices, material Material);
+// Uploads straight from the arrays, without keeping a copy. Positions is
+// the depth-only stream, the vertex positions packed tightly.
+void Mesh_CreateFromMemory(mesh *Mesh, const vertex *Vertices,
+                           const glm::vec3 *Positions, size_t VertexCount,
+                           const GLuint *Indices, size_t IndexCount,
+                           material Material, glm::vec3 BoundsMin,
+                           glm::vec3 BoundsMax);
 void Mesh_CreateCube(mesh *Mesh, material Material);
 void Mesh_CreateQuad(mesh *Mesh, material Material);
 void Mesh_CreateGrid(mesh *Mesh, material Material, int Resolution, float Size);
 void Mesh_CreateGuiQuad(mesh *Mesh, material Material);
 void Mesh_Setup(mesh *Mesh);
+void Mesh_SetupDepth(mesh *Mesh);
+void Mesh_SetupBuffers(mesh *Mesh, const vertex *Vertices,
+                       size_t VertexCount, const GLuint *Indices,
+                       size_t IndexCount);
+void Mesh_SetupDepthBuffer(mesh *Mesh, const glm::vec3 *Positions,
+                           size_t Count);
 void Mesh_Draw(const mesh &Mesh, shader Shader);
 void Mesh_DrawInstance(const mesh &Mesh, shader Shader,
                        unsigned int InstancesNum);
@@ -0,0 +1,418 @@
+#include "mesh_cache.h"
+#include "asset_pack.h"
+#include "shader_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#define MESH_CACHE_MAGIC 0x4853454d // "MESH"
+#define MESH_CACHE_VERSION 1
+#define MESH_CACHE_MAX_LODS 4
+// Every section starts on this, the arrays are used in place
+#define MESH_CACHE_ALIGNMENT 16
+
+struct mesh_cache_header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t SourceHash;
+    // a truncated write never matches
+    uint64_t FileSize;
+    // sizeof(vertex) at cook time, the layout is stored as is
+    uint32_t VertexSize;
+    uint32_t MeshCount;
+    uint32_t MaterialCount;
+    uint32_t MaterialTextureCount;
+    uint32_t TextureCount;
+    uint32_t StringSize;
+    uint64_t VertexCount;
+    uint64_t IndexCount;
+    // from the start of the file
+    uint64_t MeshesOffset;
+    uint64_t MaterialsOffset;
+    uint64_t MaterialTexturesOffset;
+    uint64_t TexturesOffset;
+    uint64_t StringsOffset;
+    uint64_t VerticesOffset;
+    uint64_t PositionsOffset;
+    uint64_t IndicesOffset;
+};
+
+// Indices of one level of detail, LOD 0 is the full mesh. The cook only
+// writes LOD 0 for now, nothing simplifies meshes yet.
+struct mesh_cache_lod {
+    uint64_t IndexOffset;
+    uint64_t IndexCount;
+};
+
+struct mesh_cache_mesh {
+    uint32_t Material;
+    uint32_t LodCount;
+    // into the vertex and position arrays, the indices are relative to it
+    uint64_t VertexOffset;
+    uint64_t VertexCount;
+    mesh_cache_lod Lods[MESH_CACHE_MAX_LODS];
+    float BoundsMin[3];
+    float BoundsMax[3];
+};
+
+// A range of the material texture array, which indexes the texture table
+struct mesh_cache_material {
+    uint32_t FirstTexture;
+    uint32_t TextureCount;
+};
+
+// Offsets into the string table
+struct mesh_cache_texture {
+    uint32_t PathOffset;
+    uint32_t PathLength;
+    uint32_t NameOffset;
+    uint32_t NameLength;
+};
+
+static uint64_t MeshCache_Align(uint64_t Offset) {
+    return (Offset + MESH_CACHE_ALIGNMENT - 1) &
+           ~(uint64_t)(MESH_CACHE_ALIGNMENT - 1);
+}
+
+static std::string MeshCache_GetPath(const std::string &Path) {
+    char File[32];
+    snprintf(File, sizeof(File), "%016llx.mesh",
+             (unsigned long long)ShaderCache_Hash(Path));
+    return std::string(MESH_CACHE_DIRECTORY) + "/" + File;
+}
+
+// Hashed where AssetPack_Read left it, the pack mapping or the loose file's
+// buffer. A missing file hashes as an empty one.
+static uint64_t MeshCache_HashFile(const std::string &Path, uint64_t Seed) {
+    asset_file File;
+    if (!AssetPack_Read(File, Path)) {
+        return Seed;
+    }
+    return ShaderCache_Hash(File.Data, File.Size, Seed);
+}
+
+uint64_t MeshCache_HashSource(const std::string &Path) {
+    uint64_t Hash = MeshCache_HashFile(Path, SHADER_CACHE_HASH_SEED);
+
+    // The materials live in .mtl files, sorted so the hash doesn't depend
+    // on the order of the directory listing
+    std::vector<std::string> Materials = AssetPack_List(
+        std::filesystem::path(Path).parent_path().string(), ".mtl");
+    for (const std::string &Material : Materials) {
+        Hash = MeshCache_HashFile(Material, Hash);
+    }
+    return Hash;
+}
+
+// Offset is aligned and Count elements of Size fit in the file
+static bool MeshCache_InFile(const mapped_file &File, uint64_t Offset,
+                             uint64_t Count, uint64_t Size) {
+    return Offset % MESH_CACHE_ALIGNMENT == 0 && Offset <= File.Size &&
+           Count <= (File.Size - Offset) / Size;
+}
+
+static bool MeshCache_IsValid(const mapped_file &File, uint64_t SourceHash) {
+    if (File.Size < sizeof(mesh_cache_header)) {
+        return false;
+    }
+    const mesh_cache_header &Header = *(const mesh_cache_header *)File.Data;
+    return Header.Magic == MESH_CACHE_MAGIC &&
+           Header.Version == MESH_CACHE_VERSION &&
+           Header.SourceHash == SourceHash && Header.FileSize == File.Size &&
+           Header.VertexSize == sizeof(vertex) &&
+           MeshCache_InFile(File, Header.MeshesOffset, Header.MeshCount,
+                            sizeof(mesh_cache_mesh)) &&
+           MeshCache_InFile(File, Header.MaterialsOffset,
+                            Header.MaterialCount,
+                            sizeof(mesh_cache_material)) &&
+           MeshCache_InFile(File, Header.MaterialTexturesOffset,
+                            Header.MaterialTextureCount, sizeof(uint32_t)) &&
+           MeshCache_InFile(File, Header.TexturesOffset, Header.TextureCount,
+                            sizeof(mesh_cache_texture)) &&
+           MeshCache_InFile(File, Header.StringsOffset, Header.StringSize,
+                            1) &&
+           MeshCache_InFile(File, Header.VerticesOffset, Header.VertexCount,
+                            sizeof(vertex)) &&
+           MeshCache_InFile(File, Header.PositionsOffset, Header.VertexCount,
+                            sizeof(glm::vec3)) &&
+           MeshCache_InFile(File, Header.IndicesOffset, Header.IndexCount,
+                            sizeof(unsigned int));
+}
+
+bool MeshCache_Load(model_import &Import, const std::string &Path,
+                    uint64_t SourceHash) {
+    auto Start = std::chrono::steady_clock::now();
+    mapped_file File;
+    if (!MappedFile_Open(File, MeshCache_GetPath(Path).c_str())) {
+        return false;
+    }
+    if (!MeshCache_IsValid(File, SourceHash)) {
+        MappedFile_Close(File);
+        return false;
+    }
+
+    const mesh_cache_header &Header = *(const mesh_cache_header *)File.Data;
+    const mesh_cache_mesh *Meshes =
+        (const mesh_cache_mesh *)(File.Data + Header.MeshesOffset);
+    const mesh_cache_material *Materials =
+        (const mesh_cache_material *)(File.Data + Header.MaterialsOffset);
+    const uint32_t *MaterialTextures =
+        (const uint32_t *)(File.Data + Header.MaterialTexturesOffset);
+    const mesh_cache_texture *Textures =
+        (const mesh_cache_texture *)(File.Data + Header.TexturesOffset);
+    const char *Strings = (const char *)(File.Data + Header.StringsOffset);
+    const vertex *Vertices =
+        (const vertex *)(File.Data + Header.VerticesOffset);
+    const glm::vec3 *Positions =
+        (const glm::vec3 *)(File.Data + Header.PositionsOffset);
+    const unsigned int *Indices =
+        (const unsigned int *)(File.Data + Header.IndicesOffset);
+
+    // Tables are checked entry by entry, the vertex arrays only by their
+    // ranges. Indices are read by the GPU, each one has to stay inside its
+    // mesh.
+    model_import Loaded = {};
+    for (uint32_t i = 0; i < Header.TextureCount; i++) {
+        const mesh_cache_texture &Texture = Textures[i];
+        if ((uint64_t)Texture.PathOffset + Texture.PathLength >
+                Header.StringSize ||
+            (uint64_t)Texture.NameOffset + Texture.NameLength >
+                Header.StringSize) {
+            MappedFile_Close(File);
+            return false;
+        }
+        model_texture_data Data = {};
+        Data.Path.assign(Strings + Texture.PathOffset, Texture.PathLength);
+        Data.Name.assign(Strings + Texture.NameOffset, Texture.NameLength);
+        Loaded.TextureIndices.emplace(Data.Path, (int)i);
+        Loaded.Textures.push_back(Data);
+    }
+
+    Loaded.Meshes.resize(Header.MeshCount);
+    for (uint32_t i = 0; i < Header.MeshCount; i++) {
+        const mesh_cache_mesh &Mesh = Meshes[i];
+        const mesh_cache_lod &Lod = Mesh.Lods[0];
+        bool Valid =
+            Mesh.LodCount >= 1 && Mesh.LodCount <= MESH_CACHE_MAX_LODS &&
+            Mesh.Material < Header.MaterialCount &&
+            Mesh.VertexOffset + Mesh.VertexCount <= Header.VertexCount &&
+            Lod.IndexOffset + Lod.IndexCount <= Header.IndexCount;
+        const mesh_cache_material *Material =
+            Valid ? &Materials[Mesh.Material] : nullptr;
+        Valid = Valid && (uint64_t)Material->FirstTexture +
+                                 Material->TextureCount <=
+                             Header.MaterialTextureCount;
+        for (uint64_t j = 0; Valid && j < Lod.IndexCount; j++) {
+            Valid = Indices[Lod.IndexOffset + j] < Mesh.VertexCount;
+        }
+        if (!Valid) {
+            MappedFile_Close(File);
+            return false;
+        }
+
+        model_mesh_data &Data = Loaded.Meshes[i];
+        for (uint32_t j = 0; j < Material->TextureCount; j++) {
+            uint32_t Texture = MaterialTextures[Material->FirstTexture + j];
+            if (Texture >= Header.TextureCount) {
+                MappedFile_Close(File);
+                return false;
+            }
+            Data.Textures.push_back((int)Texture);
+        }
+        // only LOD 0 is drawn, the renderer doesn't pick mesh LODs
+        Data.MappedVertices = Vertices + Mesh.VertexOffset;
+        Data.MappedPositions = Positions + Mesh.VertexOffset;
+        Data.MappedIndices = Indices + Lod.IndexOffset;
+        Data.VertexCount = Mesh.VertexCount;
+        Data.IndexCount = Lod.IndexCount;
+        Data.BoundsMin = glm::vec3(Mesh.BoundsMin[0], Mesh.BoundsMin[1],
+                                   Mesh.BoundsMin[2]);
+        Data.BoundsMax = glm::vec3(Mesh.BoundsMax[0], Mesh.BoundsMax[1],
+                                   Mesh.BoundsMax[2]);
+    }
+
+    Import.Directory = Path.substr(0, Path.find_last_of('/'));
+    Import.Meshes = std::move(Loaded.Meshes);
+    Import.Textures = std::move(Loaded.Textures);
+    Import.TextureIndices = std::move(Loaded.TextureIndices);
+    Import.Mapping = File;
+    std::chrono::duration<float, std::milli> Elapsed =
+        std::chrono::steady_clock::now() - Start;
+    Import.ReadTime = Elapsed.count();
+    Import.ConvertTime = 0.0f;
+    return true;
+}
+
+bool MeshCache_Store(const model_import &Import, const std::string &Path,
+                     uint64_t SourceHash) {
+    // Meshes with the same texture list share a material
+    std::map<std::vector<int>, uint32_t> MaterialIndices;
+    std::vector<mesh_cache_material> Materials;
+    std::vector<uint32_t> MaterialTextures;
+    std::vector<mesh_cache_mesh> Meshes(Import.Meshes.size());
+    uint64_t VertexCount = 0;
+    uint64_t IndexCount = 0;
+    for (size_t i = 0; i < Import.Meshes.size(); i++) {
+        const model_mesh_data &Data = Import.Meshes[i];
+        auto [Iter, Inserted] =
+            MaterialIndices.emplace(Data.Textures, (uint32_t)Materials.size());
+        if (Inserted) {
+            Materials.push_back({(uint32_t)MaterialTextures.size(),
+                                 (uint32_t)Data.Textures.size()});
+            for (int Texture : Data.Textures) {
+                MaterialTextures.push_back((uint32_t)Texture);
+            }
+        }
+
+        glm::vec3 BoundsMin = glm::vec3(0.0f);
+        glm::vec3 BoundsMax = glm::vec3(0.0f);
+        if (!Data.Vertices.empty()) {
+            BoundsMin = BoundsMax = Data.Vertices[0].Position;
+        }
+        for (const vertex &Vertex : Data.Vertices) {
+            BoundsMin = glm::min(BoundsMin, Vertex.Position);
+            BoundsMax = glm::max(BoundsMax, Vertex.Position);
+        }
+
+        mesh_cache_mesh &Mesh = Meshes[i];
+        Mesh = {};
+        Mesh.Material = Iter->second;
+        Mesh.LodCount = 1;
+        Mesh.VertexOffset = VertexCount;
+        Mesh.VertexCount = Data.Vertices.size();
+        Mesh.Lods[0] = {IndexCount, Data.Indices.size()};
+        for (int Axis = 0; Axis < 3; Axis++) {
+            Mesh.BoundsMin[Axis] = BoundsMin[Axis];
+            Mesh.BoundsMax[Axis] = BoundsMax[Axis];
+        }
+        VertexCount += Data.Vertices.size();
+        IndexCount += Data.Indices.size();
+    }
+
+    std::string Strings;
+    std::vector<mesh_cache_texture> Textures;
+    for (const model_texture_data &Data : Import.Textures) {
+        mesh_cache_texture Texture = {};
+        Texture.PathOffset = (uint32_t)Strings.size();
+        Texture.PathLength = (uint32_t)Data.Path.size();
+        Strings += Data.Path;
+        Texture.NameOffset = (uint32_t)Strings.size();
+        Texture.NameLength = (uint32_t)Data.Name.size();
+        Strings += Data.Name;
+        Textures.push_back(Texture);
+    }
+
+    mesh_cache_header Header = {};
+    Header.Magic = MESH_CACHE_MAGIC;
+    Header.Version = MESH_CACHE_VERSION;
+    Header.SourceHash = SourceHash;
+    Header.VertexSize = sizeof(vertex);
+    Header.MeshCount = (uint32_t)Meshes.size();
+    Header.MaterialCount = (uint32_t)Materials.size();
+    Header.MaterialTextureCount = (uint32_t)MaterialTextures.size();
+    Header.TextureCount = (uint32_t)Textures.size();
+    Header.StringSize = (uint32_t)Strings.size();
+    Header.VertexCount = VertexCount;
+    Header.IndexCount = IndexCount;
+
+    uint64_t Offset = MeshCache_Align(sizeof(Header));
+    Header.MeshesOffset = Offset;
+    Offset = MeshCache_Align(Offset + Meshes.size() * sizeof(mesh_cache_mesh));
+    Header.MaterialsOffset = Offset;
+    Offset = MeshCache_Align(Offset +
+                             Materials.size() * sizeof(mesh_cache_material));
+    Header.MaterialTexturesOffset = Offset;
+    Offset = MeshCache_Align(Offset +
+                             MaterialTextures.size() * sizeof(uint32_t));
+    Header.TexturesOffset = Offset;
+    Offset = MeshCache_Align(Offset +
+                             Textures.size() * sizeof(mesh_cache_texture));
+    Header.StringsOffset = Offset;
+    Offset = MeshCache_Align(Offset + Strings.size());
+    Header.VerticesOffset = Offset;
+    Offset = MeshCache_Align(Offset + VertexCount * sizeof(vertex));
+    Header.PositionsOffset = Offset;
+    Offset = MeshCache_Align(Offset + VertexCount * sizeof(glm::vec3));
+    Header.IndicesOffset = Offset;
+    Header.FileSize = Offset + IndexCount * sizeof(unsigned int);
+
+    std::error_code Error;
+    std::filesystem::create_directories(MESH_CACHE_DIRECTORY, Error);
+    if (Error) {
+        std::cout << "ERROR::MESH_CACHE::CREATE_DIRECTORY_FAILED "
+                  << MESH_CACHE_DIRECTORY << ": " << Error.message()
+                  << std::endl;
+        return false;
+    }
+
+    // Written next to the entry and renamed over it, like the shader cache.
+    // Two workers may cook the same file, each writes its own temp file.
+    std::string CachePath = MeshCache_GetPath(Path);
+    std::string TempPath = ShaderCache_GetTempPath(CachePath);
+    {
+        std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+        uint64_t Written = 0;
+        auto Write = [&File, &Written](const void *Data, uint64_t Size) {
+            File.write((const char *)Data, Size);
+            Written += Size;
+        };
+        auto Pad = [&File, &Written](uint64_t To) {
+            const char Zeros[MESH_CACHE_ALIGNMENT] = {};
+            File.write(Zeros, To - Written);
+            Written = To;
+        };
+
+        Write(&Header, sizeof(Header));
+        Pad(Header.MeshesOffset);
+        Write(Meshes.data(), Meshes.size() * sizeof(mesh_cache_mesh));
+        Pad(Header.MaterialsOffset);
+        Write(Materials.data(),
+              Materials.size() * sizeof(mesh_cache_material));
+        Pad(Header.MaterialTexturesOffset);
+        Write(MaterialTextures.data(),
+              MaterialTextures.size() * sizeof(uint32_t));
+        Pad(Header.TexturesOffset);
+        Write(Textures.data(), Textures.size() * sizeof(mesh_cache_texture));
+        Pad(Header.StringsOffset);
+        Write(Strings.data(), Strings.size());
+        Pad(Header.VerticesOffset);
+        for (const model_mesh_data &Data : Import.Meshes) {
+            Write(Data.Vertices.data(), Data.Vertices.size() * sizeof(vertex));
+        }
+        Pad(Header.PositionsOffset);
+        std::vector<glm::vec3> Positions;
+        for (const model_mesh_data &Data : Import.Meshes) {
+            Positions.clear();
+            for (const vertex &Vertex : Data.Vertices) {
+                Positions.push_back(Vertex.Position);
+            }
+            Write(Positions.data(), Positions.size() * sizeof(glm::vec3));
+        }
+        Pad(Header.IndicesOffset);
+        for (const model_mesh_data &Data : Import.Meshes) {
+            Write(Data.Indices.data(),
+                  Data.Indices.size() * sizeof(unsigned int));
+        }
+        if (!File) {
+            std::cout << "ERROR::MESH_CACHE::WRITE_FAILED " << TempPath
+                      << std::endl;
+            File.close();
+            std::filesystem::remove(TempPath, Error);
+            return false;
+        }
+    }
+    std::filesystem::rename(TempPath, CachePath, Error);
+    if (Error) {
+        std::cout << "ERROR::MESH_CACHE::WRITE_FAILED " << CachePath << ": "
+                  << Error.message() << std::endl;
+        std::filesystem::remove(TempPath, Error);
+        return false;
+    }
+    return true;
+}
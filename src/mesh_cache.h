@@ -0,0 +1,25 @@
+#ifndef MESH_CACHE_H_
+#define MESH_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include "model.h"
+
+// Cooked models, one file per source model under ./cache/meshes. A file
+// holds the vertex, depth position and index arrays in the layout they are
+// uploaded in, per mesh bounds and LOD index ranges, the material table and
+// the texture paths. Loading maps the file and points the import into it,
+// nothing is parsed per vertex.
+#define MESH_CACHE_DIRECTORY "./cache/meshes"
+
+// The source file's bytes and those of the .mtl files next to it
+uint64_t MeshCache_HashSource(const std::string &Path);
+// Fills Import from the cooked file of Path. False when there is none or it
+// was cooked from another SourceHash, Import is then left untouched.
+bool MeshCache_Load(model_import &Import, const std::string &Path,
+                    uint64_t SourceHash);
+// Import as converted from the source, before Model_Upload moved it out
+bool MeshCache_Store(const model_import &Import, const std::string &Path,
+                     uint64_t SourceHash);
+
+#endif
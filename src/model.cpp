@@ -1,20 +1,104 @@
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <iostream>
 
+#include "asset_pack.h"
 #include "model.h"
 #include "mesh.h"
+#include "mesh_cache.h"
+
+// Assimp opens the model and the files it references (.mtl) through these,
+// so they come out of the asset pack like everything else
+struct asset_pack_stream : public Assimp::IOStream {
+    asset_file File;
+    size_t Position;
+
+    size_t Read(void *Buffer, size_t Size, size_t Count) override {
+        if (Size == 0) {
+            return 0;
+        }
+        Count = std::min(Count, (File.Size - Position) / Size);
+        memcpy(Buffer, File.Data + Position, Size * Count);
+        Position += Size * Count;
+        return Count;
+    }
+    size_t Write(const void *, size_t, size_t) override { return 0; }
+    aiReturn Seek(size_t Offset, aiOrigin Origin) override {
+        size_t Base = Origin == aiOrigin_SET   ? 0
+                      : Origin == aiOrigin_CUR ? Position
+                                               : File.Size;
+        if (Base + Offset > File.Size) {
+            return aiReturn_FAILURE;
+        }
+        Position = Base + Offset;
+        return aiReturn_SUCCESS;
+    }
+    size_t Tell() const override { return Position; }
+    size_t FileSize() const override { return File.Size; }
+    void Flush() override {}
+};
+
+struct asset_pack_io_system : public Assimp::IOSystem {
+    bool Exists(const char *Path) const override {
+        uint64_t Size;
+        int64_t Time;
+        return AssetPack_Stat(Path, Size, Time);
+    }
+    char getOsSeparator() const override { return '/'; }
+    Assimp::IOStream *Open(const char *Path, const char *Mode) override {
+        // read only, the importer never writes
+        if (strchr(Mode, 'w') || strchr(Mode, 'a')) {
+            return nullptr;
+        }
+        asset_pack_stream *Stream = new asset_pack_stream();
+        Stream->Position = 0;
+        if (!AssetPack_Read(Stream->File, Path)) {
+            delete Stream;
+            return nullptr;
+        }
+        return Stream;
+    }
+    void Close(Assimp::IOStream *Stream) override { delete Stream; }
+};
 
 void Model_Create(model *Model, const char *Path, bool GammaCorrection) {
     Model->GammaCorrection = GammaCorrection;
 
-    Model_Load(Model, std::string(Path));
+    model_import Import = {};
+    if (Model_Import(Import, std::string(Path), nullptr)) {
+        Model_LoadImages(Import, nullptr);
+        Model_Upload(Model, Import);
+    }
+}
+
+bool Model_Import(model_import &Import, std::string Path,
+                  thread_pool *Pool) {
+    Import.Mapping = {};
+    uint64_t SourceHash = MeshCache_HashSource(Path);
+    if (MeshCache_Load(Import, Path, SourceHash)) {
+        return true;
+    }
+
+    if (!Model_ImportSource(Import, Path, Pool)) {
+        return false;
+    }
+    MeshCache_Store(Import, Path, SourceHash);
+    return true;
 }
 
-void Model_Load(model *Model, std::string Path) {
+bool Model_ImportSource(model_import &Import, std::string Path,
+                        thread_pool *Pool) {
+    auto Start = std::chrono::steady_clock::now();
     Assimp::Importer Importer;
+    // the importer owns and deletes it
+    Importer.SetIOHandler(new asset_pack_io_system());
     const aiScene *Scene = Importer.ReadFile(
         Path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
                   aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -23,11 +107,126 @@ void Model_Load(model *Model, std::string Path) {
         !Scene->mRootNode) {
         std::cout << "ERROR::ASSIMP::" << Importer.GetErrorString()
                   << std::endl;
-        return;
+        return false;
+    }
+    auto Read = std::chrono::steady_clock::now();
+    Import.Directory = Path.substr(0, Path.find_last_of('/'));
+
+    std::vector<const aiMesh *> AiMeshes;
+    Model_CollectMeshes(AiMeshes, Scene->mRootNode, Scene);
+
+    // Materials are shared between meshes, each is resolved the first time
+    // a mesh uses it. Serial, the texture list is shared.
+    std::vector<std::vector<int>> MaterialTextures(Scene->mNumMaterials);
+    std::vector<bool> Resolved(Scene->mNumMaterials, false);
+    Import.Meshes.resize(AiMeshes.size());
+    for (size_t i = 0; i < AiMeshes.size(); i++) {
+        unsigned int MaterialIndex = AiMeshes[i]->mMaterialIndex;
+        if (!Resolved[MaterialIndex]) {
+            Model_ResolveMaterial(Import, MaterialTextures[MaterialIndex],
+                                  Scene->mMaterials[MaterialIndex]);
+            Resolved[MaterialIndex] = true;
+        }
+        Import.Meshes[i].Textures = MaterialTextures[MaterialIndex];
+    }
+
+    // Every mesh converts into its own arrays, nothing shared between them
+    ThreadPool_ParallelFor(Pool, (int)AiMeshes.size(), 1,
+                           [&Import, &AiMeshes](int Begin, int End) {
+                               for (int i = Begin; i < End; i++) {
+                                   Model_ProcessMesh(Import.Meshes[i],
+                                                     AiMeshes[i]);
+                               }
+                           });
+
+    std::chrono::duration<float, std::milli> ReadTime = Read - Start;
+    std::chrono::duration<float, std::milli> ConvertTime =
+        std::chrono::steady_clock::now() - Read;
+    Import.ReadTime = ReadTime.count();
+    Import.ConvertTime = ConvertTime.count();
+    return true;
+}
+
+void Model_LoadImages(model_import &Import, thread_pool *Pool) {
+    ThreadPool_ParallelFor(
+        Pool, (int)Import.Textures.size(), 1,
+        [&Import, Pool](int Begin, int End) {
+            for (int i = Begin; i < End; i++) {
+                model_texture_data &Texture = Import.Textures[i];
+                std::string Filename = Import.Directory + '/' + Texture.Path;
+                Texture_LoadImage(Texture.Image, Filename.c_str(), true,
+                                  Pool);
+            }
+        });
+}
+
+void Model_Upload(model *Model, model_import &Import) {
+    Model->Directory = Import.Directory;
+
+    for (model_texture_data &Data : Import.Textures) {
+        texture Texture;
+        Texture.Path = Data.Path;
+        Texture.Name = Data.Name;
+        Texture_Upload(&Texture, Data.Image, GL_TEXTURE_2D, GL_TEXTURE0,
+                       GL_UNSIGNED_BYTE);
+        Texture_FreeImage(Data.Image);
+        Model->TexturesLoaded.push_back(Texture);
+    }
+
+    // Created in place, the vertex arrays move all the way into the mesh
+    Model->Meshes.reserve(Model->Meshes.size() + Import.Meshes.size());
+    for (model_mesh_data &Data : Import.Meshes) {
+        material Material = Model_CreateMaterial();
+        for (int Index : Data.Textures) {
+            Material.Textures.push_back(&Model->TexturesLoaded[Index]);
+        }
+
+        Model->Meshes.emplace_back();
+        Model_UploadMesh(&Model->Meshes.back(), Data, Material);
     }
-    Model->Directory = Path.substr(0, Path.find_last_of('/'));
+    Model_FreeImport(Import);
 
-    Model_ProcessNode(Model, Scene->mRootNode, Scene);
+    Model_UpdateBounds(Model);
+}
+
+material Model_CreateMaterial() {
+    material Material = {};
+    Material_Create(Material);
+    Material.Shininess = 10.0f;
+    return Material;
+}
+
+void Model_UploadMesh(mesh *Mesh, model_mesh_data &Data,
+                      material Material) {
+    if (Data.MappedVertices) {
+        Mesh_CreateFromMemory(Mesh, Data.MappedVertices, Data.MappedPositions,
+                              Data.VertexCount, Data.MappedIndices,
+                              Data.IndexCount, Material, Data.BoundsMin,
+                              Data.BoundsMax);
+    } else {
+        Mesh_Create(Mesh, std::move(Data.Vertices), std::move(Data.Indices),
+                    Material);
+    }
+}
+
+void Model_FreeImport(model_import &Import) {
+    for (model_texture_data &Texture : Import.Textures) {
+        Texture_FreeImage(Texture.Image);
+    }
+    MappedFile_Close(Import.Mapping);
+}
+
+void Model_UpdateBounds(model *Model) {
+    Model->BoundsMin = glm::vec3(0.0f);
+    Model->BoundsMax = glm::vec3(0.0f);
+    if (!Model->Meshes.empty()) {
+        Model->BoundsMin = Model->Meshes[0].BoundsMin;
+        Model->BoundsMax = Model->Meshes[0].BoundsMax;
+    }
+    for (const mesh &Mesh : Model->Meshes) {
+        Model->BoundsMin = glm::min(Model->BoundsMin, Mesh.BoundsMin);
+        Model->BoundsMax = glm::max(Model->BoundsMax, Mesh.BoundsMax);
+    }
 }
 
 void Model_Draw(const model &Model, shader Shader) {
@@ -43,85 +242,62 @@ void Model_DrawInstances(const model &Model, shader Shader,
     }
 }
 
-void Model_ProcessNode(model *Model, aiNode *Node, const aiScene *Scene) {
+void Model_CollectMeshes(std::vector<const aiMesh *> &Meshes, aiNode *Node,
+                         const aiScene *Scene) {
     // process all the node's meshes (if any)
     for (unsigned int i = 0; i < Node->mNumMeshes; i++) {
-        aiMesh *Ai_mesh = Scene->mMeshes[Node->mMeshes[i]];
-        mesh Mesh;
-        Model_ProcessMesh(Model, &Mesh, Ai_mesh, Scene);
-        Model->Meshes.push_back(Mesh);
+        Meshes.push_back(Scene->mMeshes[Node->mMeshes[i]]);
     }
 
     // then do the same for each of its children
     for (unsigned int i = 0; i < Node->mNumChildren; i++) {
-        Model_ProcessNode(Model, Node->mChildren[i], Scene);
+        Model_CollectMeshes(Meshes, Node->mChildren[i], Scene);
     }
 }
 
-void Model_ProcessMesh(model *Model, mesh *Mesh, aiMesh *Ai_mesh,
-                       const aiScene *Scene) {
-    // data to fill
-    std::vector<vertex> Vertices;
-    std::vector<unsigned int> Indices;
-    std::vector<texture *> Textures;
-
-    // walk through each of the mesh's vertices
+void Model_ProcessMesh(model_mesh_data &Mesh, const aiMesh *Ai_mesh) {
+    // Sized up front and written in place, a mesh is converted on one
+    // thread but several meshes convert at once
+    Mesh.Vertices.resize(Ai_mesh->mNumVertices);
+    const aiVector3D *TexCoords = Ai_mesh->mTextureCoords[0];
     for (unsigned int i = 0; i < Ai_mesh->mNumVertices; i++) {
-        vertex Vertex;
-        glm::vec3 Vec3; // we declare a placeholder vector since assimp uses
-                        // its own vector class that doesn't directly convert
-                        // to glm's vec3 class so we transfer the data to this
-                        // placeholder glm::vec3 first.
-        // positions
-        Vec3.x = Ai_mesh->mVertices[i].x;
-        Vec3.y = Ai_mesh->mVertices[i].y;
-        Vec3.z = Ai_mesh->mVertices[i].z;
-        Vertex.Position = Vec3;
-        // normals
-        if (Ai_mesh->HasNormals()) {
-            Vec3.x = Ai_mesh->mNormals[i].x;
-            Vec3.y = Ai_mesh->mNormals[i].y;
-            Vec3.z = Ai_mesh->mNormals[i].z;
-            Vertex.Normal = Vec3;
+        vertex &Vertex = Mesh.Vertices[i];
+        const aiVector3D &Position = Ai_mesh->mVertices[i];
+        Vertex.Position = glm::vec3(Position.x, Position.y, Position.z);
+        if (Ai_mesh->mNormals) {
+            const aiVector3D &Normal = Ai_mesh->mNormals[i];
+            Vertex.Normal = glm::vec3(Normal.x, Normal.y, Normal.z);
+        }
+        // only the first of the up to 8 texture coordinate sets is used
+        if (TexCoords) {
+            Vertex.TexCoords = glm::vec2(TexCoords[i].x, TexCoords[i].y);
         }
-        // texture coordinates
-        // does the mesh contain texture coordinates?
-        if (Ai_mesh->mTextureCoords[0]) {
-            glm::vec2 Vec2;
-            // a vertex can contain up to 8 different texture coordinates. We
-            // thus make the assumption that we won't use models where a vertex
-            // can have multiple texture coordinates so we always take the first
-            // set (0).
-            Vec2.x = Ai_mesh->mTextureCoords[0][i].x;
-            Vec2.y = Ai_mesh->mTextureCoords[0][i].y;
-            Vertex.TexCoords = Vec2;
-            // // tangent
-            Vec3.x = Ai_mesh->mTangents[i].x;
-            Vec3.y = Ai_mesh->mTangents[i].y;
-            Vec3.z = Ai_mesh->mTangents[i].z;
-            Vertex.Tangent = Vec3;
-            // bitangent
-            Vec3.x = Ai_mesh->mBitangents[i].x;
-            Vec3.y = Ai_mesh->mBitangents[i].y;
-            Vec3.z = Ai_mesh->mBitangents[i].z;
-            Vertex.Bitangent = Vec3;
-        } else {
-            Vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+        if (TexCoords && Ai_mesh->mTangents && Ai_mesh->mBitangents) {
+            const aiVector3D &Tangent = Ai_mesh->mTangents[i];
+            const aiVector3D &Bitangent = Ai_mesh->mBitangents[i];
+            Vertex.Tangent = glm::vec3(Tangent.x, Tangent.y, Tangent.z);
+            Vertex.Bitangent =
+                glm::vec3(Bitangent.x, Bitangent.y, Bitangent.z);
         }
+    }
 
-        Vertices.push_back(Vertex);
+    // triangulated, but points and lines keep fewer indices per face
+    size_t IndexCount = 0;
+    for (unsigned int i = 0; i < Ai_mesh->mNumFaces; i++) {
+        IndexCount += Ai_mesh->mFaces[i].mNumIndices;
     }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle)
-    // and retrieve the corresponding vertex indices.
+    Mesh.Indices.resize(IndexCount);
+    unsigned int *Indices = Mesh.Indices.data();
     for (unsigned int i = 0; i < Ai_mesh->mNumFaces; i++) {
-        aiFace Face = Ai_mesh->mFaces[i];
-        // retrieve all indices of the face and store them in the indices
+        const aiFace &Face = Ai_mesh->mFaces[i];
         for (unsigned int j = 0; j < Face.mNumIndices; j++) {
-            Indices.push_back(Face.mIndices[j]);
+            *Indices++ = Face.mIndices[j];
         }
     }
-    // process materials
-    aiMaterial *AiMaterial = Scene->mMaterials[Ai_mesh->mMaterialIndex];
+}
+
+void Model_ResolveMaterial(model_import &Import, std::vector<int> &Textures,
+                           aiMaterial *Mat) {
     // we assume a convention for sampler names in the shaders. Each diffuse
     // texture should be named as 'texture_diffuseN' where N is a sequential
     // number ranging from 1 to MAX_SAMPLER_NUMBER. Same applies to other
@@ -130,59 +306,57 @@ void Model_ProcessMesh(model *Model, mesh *Mesh, aiMesh *Ai_mesh,
     // normal: texture_normalN
 
     // 1. diffuse maps
-    Model_LoadMaterialTextures(Model, &Textures, AiMaterial,
-                               aiTextureType_DIFFUSE, "diffuse");
+    Model_LoadMaterialTextures(Import, Textures, Mat, aiTextureType_DIFFUSE,
+                               "diffuse");
     // // 2. specular maps
-    Model_LoadMaterialTextures(Model, &Textures, AiMaterial,
-                               aiTextureType_SPECULAR, "specular");
+    Model_LoadMaterialTextures(Import, Textures, Mat, aiTextureType_SPECULAR,
+                               "specular");
     // 3. normal maps
-    Model_LoadMaterialTextures(Model, &Textures, AiMaterial,
-                               aiTextureType_HEIGHT, "normal");
+    Model_LoadMaterialTextures(Import, Textures, Mat, aiTextureType_HEIGHT,
+                               "normal");
     // 4. height maps
-    Model_LoadMaterialTextures(Model, &Textures, AiMaterial,
-                               aiTextureType_AMBIENT, "height");
-
-    material Material = {};
-    Material_Create(Material);
-    Material.Textures = Textures;
-    Material.Shininess = 10.0f;
-
-    // return a mesh object created from the extracted mesh data
-    Mesh_Create(Mesh, Vertices, Indices, Material);
+    Model_LoadMaterialTextures(Import, Textures, Mat, aiTextureType_AMBIENT,
+                               "height");
 }
 
-void Model_LoadMaterialTextures(model *Model, std::vector<texture *> *Textures,
-                                aiMaterial *Mat, aiTextureType Type,
-                                std::string TypeName) {
+void Model_LoadMaterialTextures(model_import &Import,
+                                std::vector<int> &Textures, aiMaterial *Mat,
+                                aiTextureType Type, std::string TypeName) {
     for (unsigned int i = 0; i < Mat->GetTextureCount(Type); i++) {
         aiString Str;
         Mat->GetTexture(Type, i, &Str);
-        // check if texture was loaded before and if so, continue to next
-        // iteration: skip loading a new texture
-        bool Skip = false;
-        for (unsigned int j = 0; j < Model->TexturesLoaded.size(); j++) {
-            if (std::strcmp(Model->TexturesLoaded[j].Path.data(),
-                            Str.C_Str()) == 0) {
-                Textures->push_back(&Model->TexturesLoaded[j]);
-                // a texture with the same filepath has already been loaded,
-                // continue to next one. (optimization)
-                Skip = true;
-                break;
-            }
-        }
-        if (!Skip) {
-            texture Texture;
+        // a texture with the same filepath is only decoded once
+        auto [Existing, Inserted] = Import.TextureIndices.emplace(
+            Str.C_Str(), (int)Import.Textures.size());
+        if (Inserted) {
+            // decoded later by Model_LoadImages
+            model_texture_data Texture = {};
             Texture.Path = Str.C_Str();
             Texture.Name = TypeName;
+            Import.Textures.push_back(Texture);
+        }
+        Textures.push_back(Existing->second);
+    }
+}
 
-            std::string Filename = std::string(Str.C_Str());
-            Filename = Model->Directory + '/' + Filename;
+model_import_benchmark Model_BenchmarkImport(const char *Path,
+                                             thread_pool *Pool) {
+    model_import_benchmark Benchmark = {};
+    Benchmark.Path = Path;
 
-            Texture_Create(&Texture, Filename.c_str(), GL_TEXTURE_2D,
-                           GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE);
+    model_import Serial = {};
+    if (!Model_ImportSource(Serial, Path, nullptr)) {
+        return Benchmark;
+    }
+    model_import Parallel = {};
+    Model_ImportSource(Parallel, Path, Pool);
 
-            Model->TexturesLoaded.push_back(Texture);
-            Textures->push_back(&Model->TexturesLoaded.back());
-        }
+    Benchmark.MeshCount = (int)Parallel.Meshes.size();
+    for (const model_mesh_data &Mesh : Parallel.Meshes) {
+        Benchmark.VertexCount += (int)Mesh.Vertices.size();
     }
+    Benchmark.ReadTime = Parallel.ReadTime;
+    Benchmark.SingleThreadTime = Serial.ConvertTime;
+    Benchmark.Time = Parallel.ConvertTime;
+    return Benchmark;
 }
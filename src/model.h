@@ -2,9 +2,12 @@
 #define MODEL_H_
 
 #include <deque>
+#include <unordered_map>
 #include <vector>
 #include <assimp/scene.h>
+#include "mapped_file.h"
 #include "mesh.h"
+#include "thread_pool.h"
 
 struct model {
     // Mesh materials keep pointers to these textures. Use deque so pointers
@@ -13,18 +16,98 @@ struct model {
     std::vector<mesh> Meshes;
     std::string Directory;
     bool GammaCorrection;
+    // Union of the mesh bounds
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
 };
 
+// A material texture of an import, decoded but not uploaded
+struct model_texture_data {
+    // as the material names it, relative to the model's directory
+    std::string Path;
+    std::string Name;
+    texture_image Image;
+};
+
+struct model_mesh_data {
+    std::vector<vertex> Vertices;
+    std::vector<unsigned int> Indices;
+    // into model_import::Textures
+    std::vector<int> Textures;
+
+    // Set for meshes from the mesh cache, the arrays point into
+    // model_import::Mapping and Vertices and Indices stay empty
+    const vertex *MappedVertices;
+    const glm::vec3 *MappedPositions;
+    const unsigned int *MappedIndices;
+    size_t VertexCount;
+    size_t IndexCount;
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
+};
+
+// Everything Model_Upload needs, built without touching GL so imports can
+// run on the worker threads
+struct model_import {
+    std::string Directory;
+    std::vector<model_mesh_data> Meshes;
+    std::vector<model_texture_data> Textures;
+    // material texture path to its index in Textures
+    std::unordered_map<std::string, int> TextureIndices;
+    // milliseconds, assimp's ReadFile and the conversion after it
+    float ReadTime;
+    float ConvertTime;
+    // The cooked file the meshes came from, open until they are uploaded
+    mapped_file Mapping;
+};
+
+struct model_import_benchmark {
+    std::string Path;
+    int MeshCount;
+    int VertexCount;
+    // milliseconds, ReadFile is the same either way
+    float ReadTime;
+    float SingleThreadTime;
+    float Time;
+};
+
+// Import, decode and upload on the calling thread
 void Model_Create(model *Model, const char *Path, bool GammaCorrection);
-void Model_Load(model *Model, std::string Path);
+// From the mesh cache when it matches the source, otherwise from the source
+// through assimp, cooking the cache entry on the way
+bool Model_Import(model_import &Import, std::string Path,
+                  thread_pool *Pool);
+// Always through assimp. The meshes convert in parallel on Pool, null
+// converts them serially.
+bool Model_ImportSource(model_import &Import, std::string Path,
+                        thread_pool *Pool);
+// Frees what an import holds on to, the decoded images and the mapping
+void Model_FreeImport(model_import &Import);
+// Decodes the import's textures, spread over Pool when there is one
+void Model_LoadImages(model_import &Import, thread_pool *Pool);
+// GL thread only, frees the import (see Model_FreeImport)
+void Model_Upload(model *Model, model_import &Import);
+// Material of an imported mesh, without its textures
+material Model_CreateMaterial();
+// Mesh_Create, or Mesh_CreateFromMemory for a mesh from the mesh cache
+void Model_UploadMesh(mesh *Mesh, model_mesh_data &Data, material Material);
+// After Meshes changed
+void Model_UpdateBounds(model *Model);
 void Model_Draw(const model &Model, shader Shader);
 void Model_DrawInstances(const model &Model, shader Shader,
                          unsigned int InstancesNum);
-void Model_ProcessNode(model *Model, aiNode *Node, const aiScene *Scene);
-void Model_ProcessMesh(model *Model, mesh *Mesh, aiMesh *Ai_mesh,
-                       const aiScene *Scene);
-void Model_LoadMaterialTextures(model *Model, std::vector<texture *> *Textures,
-                                aiMaterial *Mat, aiTextureType Type,
-                                std::string TypeName);
+// Meshes in node order, a mesh used by several nodes shows up each time
+void Model_CollectMeshes(std::vector<const aiMesh *> &Meshes, aiNode *Node,
+                         const aiScene *Scene);
+// Geometry only, safe to run for different meshes at once
+void Model_ProcessMesh(model_mesh_data &Mesh, const aiMesh *Ai_mesh);
+void Model_ResolveMaterial(model_import &Import, std::vector<int> &Textures,
+                           aiMaterial *Mat);
+void Model_LoadMaterialTextures(model_import &Import,
+                                std::vector<int> &Textures, aiMaterial *Mat,
+                                aiTextureType Type, std::string TypeName);
+// Converts Path serially and on Pool, no images or GL
+model_import_benchmark Model_BenchmarkImport(const char *Path,
+                                             thread_pool *Pool);
 
 #endif
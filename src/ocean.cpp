@@ -0,0 +1,457 @@
+#include "ocean.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+static const float OCEAN_GRAVITY = 9.81f;
+static const float OCEAN_PI = 3.14159265358979f;
+// Columns per job of a transform pass, a few cache lines of each row
+static const int OCEAN_COLUMN_GRAIN = 32;
+static const int OCEAN_ROW_GRAIN = 16;
+
+static bool Ocean_IsPowerOfTwo(int Value) {
+    return Value > 0 && (Value & (Value - 1)) == 0;
+}
+
+static float Ocean_Phillips(float KX, float KZ, float WindSpeed,
+                            glm::vec2 WindDirection, float Amplitude) {
+    float K2 = KX * KX + KZ * KZ;
+    if (K2 < 1e-12f) {
+        return 0.0f;
+    }
+    // largest wave the wind can raise
+    float L = WindSpeed * WindSpeed / OCEAN_GRAVITY;
+    float KDotW = (KX * WindDirection.x + KZ * WindDirection.y) / std::sqrt(K2);
+    // damp ripples far below the grid spacing
+    float Small = L * 0.001f;
+    return Amplitude * std::exp(-1.0f / (K2 * L * L)) / (K2 * K2) * KDotW *
+           KDotW * std::exp(-K2 * Small * Small);
+}
+
+static void Ocean_InitSpectrum(ocean_spectrum &Spectrum, int Resolution,
+                               float PatchLength, float WindSpeed,
+                               glm::vec2 WindDirection, float Amplitude) {
+    int N = Resolution;
+    size_t Count = (size_t)N * N;
+    Spectrum.Resolution = N;
+    Spectrum.PatchLength = PatchLength;
+    Spectrum.H0Re.assign(Count, 0.0f);
+    Spectrum.H0Im.assign(Count, 0.0f);
+    Spectrum.H0ConjRe.assign(Count, 0.0f);
+    Spectrum.H0ConjIm.assign(Count, 0.0f);
+    Spectrum.Omega.assign(Count, 0.0f);
+    Spectrum.ARe.assign(Count, 0.0f);
+    Spectrum.AIm.assign(Count, 0.0f);
+    Spectrum.BRe.assign(Count, 0.0f);
+    Spectrum.BIm.assign(Count, 0.0f);
+    Spectrum.ScratchRe.assign(Count, 0.0f);
+    Spectrum.ScratchIm.assign(Count, 0.0f);
+
+    float WindLength = std::sqrt(WindDirection.x * WindDirection.x +
+                                 WindDirection.y * WindDirection.y);
+    glm::vec2 Wind = WindLength > 0.0f
+                         ? glm::vec2(WindDirection.x / WindLength,
+                                     WindDirection.y / WindLength)
+                         : glm::vec2(1.0f, 0.0f);
+
+    // fixed seed, the same sea every run
+    std::mt19937 Random(1337);
+    std::normal_distribution<float> Gaussian(0.0f, 1.0f);
+    for (int m = 0; m < N; m++) {
+        for (int n = 0; n < N; n++) {
+            float KX = 2.0f * OCEAN_PI * (n - N / 2) / PatchLength;
+            float KZ = 2.0f * OCEAN_PI * (m - N / 2) / PatchLength;
+            float P = Ocean_Phillips(KX, KZ, WindSpeed, Wind, Amplitude);
+            float Scale = std::sqrt(P * 0.5f);
+            size_t i = (size_t)m * N + n;
+            Spectrum.H0Re[i] = Gaussian(Random) * Scale;
+            Spectrum.H0Im[i] = Gaussian(Random) * Scale;
+            Spectrum.Omega[i] =
+                std::sqrt(OCEAN_GRAVITY * std::sqrt(KX * KX + KZ * KZ));
+        }
+    }
+    for (int m = 0; m < N; m++) {
+        for (int n = 0; n < N; n++) {
+            size_t Mirror = (size_t)((N - m) % N) * N + (N - n) % N;
+            size_t i = (size_t)m * N + n;
+            Spectrum.H0ConjRe[i] = Spectrum.H0Re[Mirror];
+            Spectrum.H0ConjIm[i] = -Spectrum.H0Im[Mirror];
+        }
+    }
+
+    // inverse transform, e^(+i 2 pi j / N)
+    Spectrum.TwiddleRe.resize(N / 2);
+    Spectrum.TwiddleIm.resize(N / 2);
+    for (int j = 0; j < N / 2; j++) {
+        Spectrum.TwiddleRe[j] = std::cos(2.0f * OCEAN_PI * j / N);
+        Spectrum.TwiddleIm[j] = std::sin(2.0f * OCEAN_PI * j / N);
+    }
+    int Bits = 0;
+    while ((1 << Bits) < N) {
+        Bits++;
+    }
+    Spectrum.BitReverse.resize(N);
+    for (int i = 0; i < N; i++) {
+        int Reversed = 0;
+        for (int b = 0; b < Bits; b++) {
+            Reversed |= ((i >> b) & 1) << (Bits - 1 - b);
+        }
+        Spectrum.BitReverse[i] = Reversed;
+    }
+}
+
+// h(k, t) and the horizontal displacements for rows [Begin, End)
+static void Ocean_EvolveRows(ocean_spectrum &Spectrum, float Time, int Begin,
+                             int End) {
+    int N = Spectrum.Resolution;
+    for (int m = Begin; m < End; m++) {
+        float KZ = 2.0f * OCEAN_PI * (m - N / 2) / Spectrum.PatchLength;
+        for (int n = 0; n < N; n++) {
+            float KX = 2.0f * OCEAN_PI * (n - N / 2) / Spectrum.PatchLength;
+            float K = std::sqrt(KX * KX + KZ * KZ);
+            size_t i = (size_t)m * N + n;
+
+            float Cos = std::cos(Spectrum.Omega[i] * Time);
+            float Sin = std::sin(Spectrum.Omega[i] * Time);
+            // h0 * e^(iwt) + conj(h0(-k)) * e^(-iwt)
+            float HRe = Spectrum.H0Re[i] * Cos - Spectrum.H0Im[i] * Sin +
+                        Spectrum.H0ConjRe[i] * Cos +
+                        Spectrum.H0ConjIm[i] * Sin;
+            float HIm = Spectrum.H0Re[i] * Sin + Spectrum.H0Im[i] * Cos -
+                        Spectrum.H0ConjRe[i] * Sin +
+                        Spectrum.H0ConjIm[i] * Cos;
+
+            // D = -i k / |k| * h. Adding i * Dx to h folds into
+            // (1 + kx / |k|) * h, its transform is h + i * dx.
+            float UnitX = K > 0.0f ? KX / K : 0.0f;
+            float UnitZ = K > 0.0f ? KZ / K : 0.0f;
+            Spectrum.ARe[i] = HRe * (1.0f + UnitX);
+            Spectrum.AIm[i] = HIm * (1.0f + UnitX);
+            Spectrum.BRe[i] = UnitZ * HIm;
+            Spectrum.BIm[i] = -UnitZ * HRe;
+        }
+    }
+}
+
+// B = A - W * B, A = A + W * B over columns [Begin, End) of two rows
+static void Ocean_Butterfly(float *ARe, float *AIm, float *BRe, float *BIm,
+                            float WRe, float WIm, int Begin, int End) {
+    int c = Begin;
+#if defined(__SSE2__)
+    __m128 WRe4 = _mm_set1_ps(WRe);
+    __m128 WIm4 = _mm_set1_ps(WIm);
+    for (; c + 4 <= End; c += 4) {
+        __m128 Br = _mm_loadu_ps(BRe + c);
+        __m128 Bi = _mm_loadu_ps(BIm + c);
+        __m128 Tr = _mm_sub_ps(_mm_mul_ps(Br, WRe4), _mm_mul_ps(Bi, WIm4));
+        __m128 Ti = _mm_add_ps(_mm_mul_ps(Br, WIm4), _mm_mul_ps(Bi, WRe4));
+        __m128 Ar = _mm_loadu_ps(ARe + c);
+        __m128 Ai = _mm_loadu_ps(AIm + c);
+        _mm_storeu_ps(BRe + c, _mm_sub_ps(Ar, Tr));
+        _mm_storeu_ps(BIm + c, _mm_sub_ps(Ai, Ti));
+        _mm_storeu_ps(ARe + c, _mm_add_ps(Ar, Tr));
+        _mm_storeu_ps(AIm + c, _mm_add_ps(Ai, Ti));
+    }
+#elif defined(__ARM_NEON)
+    float32x4_t WRe4 = vdupq_n_f32(WRe);
+    float32x4_t WIm4 = vdupq_n_f32(WIm);
+    for (; c + 4 <= End; c += 4) {
+        float32x4_t Br = vld1q_f32(BRe + c);
+        float32x4_t Bi = vld1q_f32(BIm + c);
+        float32x4_t Tr = vmlsq_f32(vmulq_f32(Br, WRe4), Bi, WIm4);
+        float32x4_t Ti = vmlaq_f32(vmulq_f32(Br, WIm4), Bi, WRe4);
+        float32x4_t Ar = vld1q_f32(ARe + c);
+        float32x4_t Ai = vld1q_f32(AIm + c);
+        vst1q_f32(BRe + c, vsubq_f32(Ar, Tr));
+        vst1q_f32(BIm + c, vsubq_f32(Ai, Ti));
+        vst1q_f32(ARe + c, vaddq_f32(Ar, Tr));
+        vst1q_f32(AIm + c, vaddq_f32(Ai, Ti));
+    }
+#endif
+    for (; c < End; c++) {
+        float Tr = BRe[c] * WRe - BIm[c] * WIm;
+        float Ti = BRe[c] * WIm + BIm[c] * WRe;
+        BRe[c] = ARe[c] - Tr;
+        BIm[c] = AIm[c] - Ti;
+        ARe[c] += Tr;
+        AIm[c] += Ti;
+    }
+}
+
+// Radix-2 transform down every column in [Begin, End). The butterflies work
+// on whole row segments, so the inner loop runs along contiguous memory.
+static void Ocean_TransformColumns(const ocean_spectrum &Spectrum, float *Re,
+                                   float *Im, int Begin, int End) {
+    int N = Spectrum.Resolution;
+    for (int i = 0; i < N; i++) {
+        int j = Spectrum.BitReverse[i];
+        if (j <= i) {
+            continue;
+        }
+        std::swap_ranges(Re + (size_t)i * N + Begin, Re + (size_t)i * N + End,
+                         Re + (size_t)j * N + Begin);
+        std::swap_ranges(Im + (size_t)i * N + Begin, Im + (size_t)i * N + End,
+                         Im + (size_t)j * N + Begin);
+    }
+
+    for (int Size = 2; Size <= N; Size *= 2) {
+        int Half = Size / 2;
+        int Step = N / Size;
+        for (int Start = 0; Start < N; Start += Size) {
+            for (int j = 0; j < Half; j++) {
+                size_t A = (size_t)(Start + j) * N;
+                size_t B = A + (size_t)Half * N;
+                Ocean_Butterfly(Re + A, Im + A, Re + B, Im + B,
+                                Spectrum.TwiddleRe[j * Step],
+                                Spectrum.TwiddleIm[j * Step], Begin, End);
+            }
+        }
+    }
+}
+
+// Tiled so the strided writes stay in cache at 512
+static void Ocean_Transpose(const float *Source, float *Destination, int N,
+                            int Begin, int End) {
+    const int Tile = 16;
+    for (int Tiled = 0; Tiled < N; Tiled += Tile) {
+        int TileEnd = std::min(Tiled + Tile, N);
+        for (int Row = Begin; Row < End; Row++) {
+            for (int Column = Tiled; Column < TileEnd; Column++) {
+                Destination[(size_t)Column * N + Row] =
+                    Source[(size_t)Row * N + Column];
+            }
+        }
+    }
+}
+
+// Transposes a field into the scratch planes and swaps them in
+static void Ocean_TransposeField(ocean_spectrum &Spectrum, thread_pool *Pool,
+                                 std::vector<float> &Re,
+                                 std::vector<float> &Im) {
+    int N = Spectrum.Resolution;
+    ThreadPool_ParallelFor(Pool, N, OCEAN_ROW_GRAIN, [&](int Begin, int End) {
+        Ocean_Transpose(Re.data(), Spectrum.ScratchRe.data(), N, Begin, End);
+        Ocean_Transpose(Im.data(), Spectrum.ScratchIm.data(), N, Begin, End);
+    });
+    Re.swap(Spectrum.ScratchRe);
+    Im.swap(Spectrum.ScratchIm);
+}
+
+// 2D inverse transform of both fields. The result comes out transposed,
+// indexed [x][z].
+static void Ocean_InverseFFT(ocean_spectrum &Spectrum, thread_pool *Pool) {
+    auto TransformPass = [&](int Begin, int End) {
+        Ocean_TransformColumns(Spectrum, Spectrum.ARe.data(),
+                               Spectrum.AIm.data(), Begin, End);
+        Ocean_TransformColumns(Spectrum, Spectrum.BRe.data(),
+                               Spectrum.BIm.data(), Begin, End);
+    };
+    int N = Spectrum.Resolution;
+    ThreadPool_ParallelFor(Pool, N, OCEAN_COLUMN_GRAIN, TransformPass);
+    Ocean_TransposeField(Spectrum, Pool, Spectrum.ARe, Spectrum.AIm);
+    Ocean_TransposeField(Spectrum, Pool, Spectrum.BRe, Spectrum.BIm);
+    ThreadPool_ParallelFor(Pool, N, OCEAN_COLUMN_GRAIN, TransformPass);
+}
+
+// One step at Time, written to Target as N * N RGB floats
+static void Ocean_Simulate(ocean_spectrum &Spectrum, thread_pool *Pool,
+                           float Time, float Choppiness, float *Target) {
+    int N = Spectrum.Resolution;
+    ThreadPool_ParallelFor(Pool, N, OCEAN_ROW_GRAIN, [&](int Begin, int End) {
+        Ocean_EvolveRows(Spectrum, Time, Begin, End);
+    });
+
+    Ocean_InverseFFT(Spectrum, Pool);
+
+    ThreadPool_ParallelFor(Pool, N, OCEAN_ROW_GRAIN, [&](int Begin, int End) {
+        for (int z = Begin; z < End; z++) {
+            float *Row = Target + (size_t)z * N * 3;
+            for (int x = 0; x < N; x++) {
+                size_t i = (size_t)x * N + z;
+                // the spectrum is centered on k = 0, which flips every
+                // other sample
+                float Sign = ((x + z) & 1) ? -1.0f : 1.0f;
+                Row[x * 3 + 0] = Sign * Spectrum.AIm[i] * Choppiness;
+                Row[x * 3 + 1] = Sign * Spectrum.ARe[i];
+                Row[x * 3 + 2] = Sign * Spectrum.BRe[i] * Choppiness;
+            }
+        }
+    });
+}
+
+void Ocean_Create(ocean &Ocean, int Resolution, float PatchLength,
+                  float WindSpeed, glm::vec2 WindDirection,
+                  float Amplitude) {
+    if (!Ocean_IsPowerOfTwo(Resolution)) {
+        std::cout << "ERROR::OCEAN:: Resolution " << Resolution
+                  << " is not a power of two" << std::endl;
+        Resolution = 128;
+    }
+
+    Ocean.WindSpeed = WindSpeed;
+    Ocean.WindDirection = WindDirection;
+    Ocean.Amplitude = Amplitude;
+    Ocean.Choppiness = 1.0f;
+    Ocean_InitSpectrum(Ocean.Spectrum, Resolution, PatchLength, WindSpeed,
+                       WindDirection, Amplitude);
+
+    glGenTextures(1, &Ocean.Texture);
+    glBindTexture(GL_TEXTURE_2D, Ocean.Texture);
+    // flat until the first step is uploaded
+    std::vector<float> Flat((size_t)Resolution * Resolution * 3, 0.0f);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, Resolution, Resolution, 0,
+                 GL_RGB, GL_FLOAT, Flat.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLsizeiptr Size = (GLsizeiptr)Resolution * Resolution * 3 * sizeof(float);
+    glGenBuffers(OCEAN_PBO_COUNT, Ocean.PBOs);
+    for (int i = 0; i < OCEAN_PBO_COUNT; i++) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Ocean.PBOs[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, Size, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    Ocean.PBOIndex = 0;
+    Ocean.Target = NULL;
+    Ocean.JobPending = false;
+    Ocean.SimulationTime = 0.0f;
+    Ocean.JobTime = 0.0f;
+    Ocean.StalledFrames = 0;
+}
+
+void Ocean_Destroy(ocean &Ocean) {
+    if (Ocean.JobPending) {
+        Ocean.Job.wait();
+        Ocean.JobPending = false;
+    }
+    if (Ocean.Target) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Ocean.PBOs[Ocean.PBOIndex]);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        Ocean.Target = NULL;
+    }
+    glDeleteBuffers(OCEAN_PBO_COUNT, Ocean.PBOs);
+    glDeleteTextures(1, &Ocean.Texture);
+    Ocean.Texture = 0;
+}
+
+void Ocean_Update(ocean &Ocean, thread_pool &Pool, float Time) {
+    int N = Ocean.Spectrum.Resolution;
+
+    if (Ocean.JobPending) {
+        // The GL thread never waits on the simulation, the displacement of
+        // the last finished step stays up instead
+        if (Ocean.Job.wait_for(std::chrono::seconds(0)) !=
+            std::future_status::ready) {
+            Ocean.StalledFrames++;
+            return;
+        }
+        Ocean.Job.get();
+        Ocean.JobPending = false;
+        Ocean.SimulationTime = Ocean.JobTime;
+
+        // The copy out of the PBO is queued, the texture is updated whenever
+        // the GPU gets to it
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Ocean.PBOs[Ocean.PBOIndex]);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        Ocean.Target = NULL;
+        glBindTexture(GL_TEXTURE_2D, Ocean.Texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, N, N, GL_RGB, GL_FLOAT, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        Ocean.PBOIndex = (Ocean.PBOIndex + 1) % OCEAN_PBO_COUNT;
+    }
+
+    // The next step goes straight into the next PBO of the ring. It was last
+    // read OCEAN_PBO_COUNT uploads ago, so mapping it unsynchronized doesn't
+    // stall, and invalidating lets the driver hand out fresh memory anyway.
+    GLsizeiptr Size = (GLsizeiptr)N * N * 3 * sizeof(float);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Ocean.PBOs[Ocean.PBOIndex]);
+    float *Target = (float *)glMapBufferRange(
+        GL_PIXEL_UNPACK_BUFFER, 0, Size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!Target) {
+        std::cout << "ERROR::OCEAN:: Failed to map the displacement buffer"
+                  << std::endl;
+        return;
+    }
+
+    // The job gets its own copy of the settings the GUI can change
+    Ocean.Target = Target;
+    Ocean.JobPending = true;
+    ocean_spectrum *Spectrum = &Ocean.Spectrum;
+    float *JobTime = &Ocean.JobTime;
+    float Choppiness = Ocean.Choppiness;
+    thread_pool *Workers = &Pool;
+    Ocean.Job = ThreadPool_Submit(Pool, [=] {
+        auto Start = std::chrono::steady_clock::now();
+        Ocean_Simulate(*Spectrum, Workers, Time, Choppiness, Target);
+        std::chrono::duration<float, std::milli> Elapsed =
+            std::chrono::steady_clock::now() - Start;
+        *JobTime = Elapsed.count();
+    });
+}
+
+void Ocean_SetResolution(ocean &Ocean, int Resolution) {
+    float PatchLength = Ocean.Spectrum.PatchLength;
+    float Choppiness = Ocean.Choppiness;
+    Ocean_Destroy(Ocean);
+    Ocean_Create(Ocean, Resolution, PatchLength, Ocean.WindSpeed,
+                 Ocean.WindDirection, Ocean.Amplitude);
+    Ocean.Choppiness = Choppiness;
+}
+
+static float Ocean_TimeSteps(ocean_spectrum &Spectrum, thread_pool *Pool,
+                             float *Target, int Steps) {
+    // first step warms the caches and the workers up
+    Ocean_Simulate(Spectrum, Pool, 0.0f, 1.0f, Target);
+    auto Start = std::chrono::steady_clock::now();
+    for (int i = 0; i < Steps; i++) {
+        Ocean_Simulate(Spectrum, Pool, i / 60.0f, 1.0f, Target);
+    }
+    std::chrono::duration<float, std::milli> Elapsed =
+        std::chrono::steady_clock::now() - Start;
+    return Elapsed.count() / Steps;
+}
+
+void Ocean_Benchmark(ocean &Ocean, thread_pool &Pool) {
+    // the workers are all ours while this runs
+    if (Ocean.JobPending) {
+        Ocean.Job.wait();
+    }
+
+    Ocean.Benchmarks.clear();
+    const int Resolutions[] = {64, 128, 256, 512};
+    for (int Resolution : Resolutions) {
+        ocean_spectrum Spectrum = {};
+        Ocean_InitSpectrum(Spectrum, Resolution, Ocean.Spectrum.PatchLength,
+                           Ocean.WindSpeed, Ocean.WindDirection,
+                           Ocean.Amplitude);
+        std::vector<float> Target((size_t)Resolution * Resolution * 3);
+
+        ocean_benchmark Benchmark = {
+            .Resolution = Resolution,
+            .SingleThreadTime =
+                Ocean_TimeSteps(Spectrum, NULL, Target.data(), 8),
+            .Time = Ocean_TimeSteps(Spectrum, &Pool, Target.data(), 8),
+        };
+        Ocean.Benchmarks.push_back(Benchmark);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef OCEAN_H_
+#define OCEAN_H_
+
+#include <future>
+#include <vector>
+#include "glm/glm.hpp"
+#include "thread_pool.h"
+
+// Enough that the PBO being filled was consumed by the GPU frames ago
+#define OCEAN_PBO_COUNT 3
+
+// Tessendorf's FFT ocean. The spectrum is evolved and transformed on the
+// worker threads, no GL in here so benchmarks can run it on its own.
+struct ocean_spectrum {
+    int Resolution;
+    float PatchLength;
+    // h0(k) and conj(h0(-k)) as separate real and imaginary planes
+    std::vector<float> H0Re;
+    std::vector<float> H0Im;
+    std::vector<float> H0ConjRe;
+    std::vector<float> H0ConjIm;
+    std::vector<float> Omega;
+    // Two real fields per complex transform: A = h + i * Dx, B = Dz
+    std::vector<float> ARe;
+    std::vector<float> AIm;
+    std::vector<float> BRe;
+    std::vector<float> BIm;
+    std::vector<float> ScratchRe;
+    std::vector<float> ScratchIm;
+    std::vector<float> TwiddleRe;
+    std::vector<float> TwiddleIm;
+    std::vector<int> BitReverse;
+};
+
+struct ocean_benchmark {
+    int Resolution;
+    // milliseconds per simulation step
+    float SingleThreadTime;
+    float Time;
+};
+
+struct ocean {
+    ocean_spectrum Spectrum;
+    float WindSpeed;
+    glm::vec2 WindDirection;
+    float Amplitude;
+    float Choppiness;
+
+    // RGB32F: x, y and z displacement over one patch, tiles with GL_REPEAT
+    unsigned int Texture;
+    unsigned int PBOs[OCEAN_PBO_COUNT];
+    int PBOIndex;
+    // Mapped PBOs[PBOIndex] the pending job writes into
+    float *Target;
+    std::future<void> Job;
+    bool JobPending;
+
+    // milliseconds of the last collected step, JobTime is the job's own
+    float SimulationTime;
+    float JobTime;
+    // Frames the job wasn't done and the last displacement stayed up
+    int StalledFrames;
+    std::vector<ocean_benchmark> Benchmarks;
+};
+
+void Ocean_Create(ocean &Ocean, int Resolution, float PatchLength,
+                  float WindSpeed, glm::vec2 WindDirection,
+                  float Amplitude);
+void Ocean_Destroy(ocean &Ocean);
+// Uploads the last finished step and starts the next one, never blocks
+void Ocean_Update(ocean &Ocean, thread_pool &Pool, float Time);
+// Resolution is a power of two, rebuilds the spectrum and the GL objects
+void Ocean_SetResolution(ocean &Ocean, int Resolution);
+// Times one step at 64 to 512, multi and single threaded, blocks until done
+void Ocean_Benchmark(ocean &Ocean, thread_pool &Pool);
+
+#endif
@@ -0,0 +1,74 @@
+#include "postprocess.h"
+
+postprocess_chain PostProcess_BuildChain(const scene &Scene) {
+    postprocess_chain Chain = {};
+    Chain.Exposure = Scene.HDRExposure;
+    Chain.Contrast = Scene.Contrast;
+    Chain.Saturation = Scene.Saturation;
+    Chain.UVScale = glm::vec2(1.0f);
+
+    if (Scene.BloomEnabled) {
+        Chain.Effects |= POSTPROCESS_BLOOM;
+    }
+    if (Scene.HDREnabled) {
+        Chain.Effects |= POSTPROCESS_TONEMAP;
+    }
+    if (Scene.ColorGradingEnabled) {
+        Chain.Effects |= POSTPROCESS_GRADING;
+    }
+
+    // Same order as the Effects combo in the gui
+    switch (Scene.Effect) {
+    case 1:
+        Chain.Effects |= POSTPROCESS_INVERSION;
+        break;
+    case 2:
+        Chain.Effects |= POSTPROCESS_GRAYSCALE;
+        break;
+    case 3:
+        Chain.Effects |= POSTPROCESS_SHARPEN;
+        break;
+    case 4:
+        Chain.Effects |= POSTPROCESS_BLUR;
+        break;
+    case 5:
+        Chain.Effects |= POSTPROCESS_EDGES;
+        break;
+    default:
+        break;
+    }
+
+    return Chain;
+}
+
+std::string PostProcess_GetDefines(unsigned int Effects) {
+    std::string Defines;
+    if (Effects & POSTPROCESS_BLOOM) {
+        Defines += "#define EFFECT_BLOOM\n";
+    }
+    if (Effects & POSTPROCESS_TONEMAP) {
+        Defines += "#define EFFECT_TONEMAP\n";
+    }
+    if (Effects & POSTPROCESS_INVERSION) {
+        Defines += "#define EFFECT_INVERSION\n";
+    }
+    if (Effects & POSTPROCESS_GRAYSCALE) {
+        Defines += "#define EFFECT_GRAYSCALE\n";
+    }
+    if (Effects & POSTPROCESS_SHARPEN) {
+        Defines += "#define EFFECT_SHARPEN\n";
+    }
+    if (Effects & POSTPROCESS_BLUR) {
+        Defines += "#define EFFECT_BLUR\n";
+    }
+    if (Effects & POSTPROCESS_EDGES) {
+        Defines += "#define EFFECT_EDGES\n";
+    }
+    if (Effects & POSTPROCESS_GRADING) {
+        Defines += "#define EFFECT_GRADING\n";
+    }
+    if (Effects & POSTPROCESS_UPSCALE) {
+        Defines += "#define EFFECT_UPSCALE\n";
+    }
+    return Defines;
+}
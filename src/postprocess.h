@@ -0,0 +1,39 @@
+#ifndef POSTPROCESS_H_
+#define POSTPROCESS_H_
+
+#include <string>
+#include <glm/glm.hpp>
+#include "scene.h"
+
+// Effects fused into the single post-processing pass. Every combination
+// compiles its own framebuffer.frag permutation with the matching defines.
+enum postprocess_effect : unsigned int {
+    POSTPROCESS_BLOOM = 1 << 0,
+    POSTPROCESS_TONEMAP = 1 << 1,
+    POSTPROCESS_INVERSION = 1 << 2,
+    POSTPROCESS_GRAYSCALE = 1 << 3,
+    POSTPROCESS_SHARPEN = 1 << 4,
+    POSTPROCESS_BLUR = 1 << 5,
+    POSTPROCESS_EDGES = 1 << 6,
+    POSTPROCESS_GRADING = 1 << 7,
+    POSTPROCESS_UPSCALE = 1 << 8,
+};
+
+// What the post-processing pass has to do this frame. No effects means the
+// scene can be drawn straight into the backbuffer.
+struct postprocess_chain {
+    unsigned int Effects;
+
+    float Exposure;
+    float Contrast;
+    float Saturation;
+
+    // Upscaling from a dynamic resolution scene
+    glm::vec2 UVScale;
+    float Sharpness;
+};
+
+postprocess_chain PostProcess_BuildChain(const scene &Scene);
+std::string PostProcess_GetDefines(unsigned int Effects);
+
+#endif
@@ -0,0 +1,234 @@
+#include "render_graph.h"
+
+#include <algorithm>
+
+render_resource RenderGraph_BloomMip(unsigned int Index) {
+    return (render_resource)((int)render_resource::BloomMip0 + Index);
+}
+
+GLenum RenderGraph_GetPixelFormat(GLenum InternalFormat) {
+    switch (InternalFormat) {
+    case GL_RGBA8:
+    case GL_RGBA16F:
+    case GL_RGBA32F:
+        return GL_RGBA;
+    case GL_R8:
+    case GL_R16F:
+    case GL_R32F:
+        return GL_RED;
+    case GL_DEPTH24_STENCIL8:
+        return GL_DEPTH_STENCIL;
+    default:
+        return GL_RGB;
+    }
+}
+
+GLenum RenderGraph_GetPixelType(GLenum InternalFormat) {
+    return InternalFormat == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8
+                                                 : GL_FLOAT;
+}
+
+static bool RenderGraph_SameDesc(const render_texture_desc &A,
+                                 const render_texture_desc &B) {
+    return A.InternalFormat == B.InternalFormat && A.Width == B.Width &&
+           A.Height == B.Height;
+}
+
+static GLuint RenderGraph_CreateTexture(const render_texture_desc &Desc) {
+    GLuint Texture;
+    glGenTextures(1, &Texture);
+    glBindTexture(GL_TEXTURE_2D, Texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, Desc.InternalFormat, Desc.Width,
+                 Desc.Height, 0,
+                 RenderGraph_GetPixelFormat(Desc.InternalFormat),
+                 RenderGraph_GetPixelType(Desc.InternalFormat), NULL);
+    // depth is never filtered
+    GLint Filter =
+        Desc.InternalFormat == GL_DEPTH24_STENCIL8 ? GL_NEAREST : GL_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, Filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, Filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return Texture;
+}
+
+void RenderGraph_Begin(render_graph &Graph) {
+    // The pool is kept between frames, only the passes are rebuilt
+    Graph.Passes.clear();
+    for (int i = 0; i < (int)render_resource::Count; i++) {
+        Graph.IsTransient[i] = false;
+        Graph.Physical[i] = -1;
+    }
+}
+
+void RenderGraph_CreateTransient(render_graph &Graph, render_resource Resource,
+                                 render_texture_desc Desc) {
+    Graph.IsTransient[(int)Resource] = true;
+    Graph.Descs[(int)Resource] = Desc;
+}
+
+void RenderGraph_AddPass(render_graph &Graph, const char *Name,
+                         std::vector<render_resource> Inputs,
+                         std::vector<render_resource> Outputs,
+                         std::function<void()> Execute) {
+    render_graph_pass Pass = {
+        .Name = Name,
+        .Inputs = std::move(Inputs),
+        .Outputs = std::move(Outputs),
+        .Execute = std::move(Execute),
+        .Culled = false,
+    };
+    Graph.Passes.push_back(std::move(Pass));
+}
+
+void RenderGraph_Compile(render_graph &Graph) {
+    const int ResourceCount = (int)render_resource::Count;
+    const int PassCount = (int)Graph.Passes.size();
+
+    // ### Culling ###
+    // Walk back from the backbuffer, a pass only runs if a later running
+    // pass reads one of its outputs
+    bool Needed[ResourceCount] = {};
+    Needed[(int)render_resource::Backbuffer] = true;
+    Graph.CulledPassCount = 0;
+    for (int i = PassCount - 1; i >= 0; i--) {
+        render_graph_pass &Pass = Graph.Passes[i];
+        Pass.Culled = true;
+        for (render_resource Output : Pass.Outputs) {
+            if (Needed[(int)Output]) {
+                Pass.Culled = false;
+                break;
+            }
+        }
+
+        if (Pass.Culled) {
+            Graph.CulledPassCount++;
+            continue;
+        }
+        for (render_resource Input : Pass.Inputs) {
+            Needed[(int)Input] = true;
+        }
+    }
+
+    // ### Lifetimes ###
+    // First and last running pass touching each transient
+    int FirstUse[ResourceCount];
+    int LastUse[ResourceCount];
+    std::fill(FirstUse, FirstUse + ResourceCount, -1);
+    std::fill(LastUse, LastUse + ResourceCount, -1);
+    for (int i = 0; i < PassCount; i++) {
+        const render_graph_pass &Pass = Graph.Passes[i];
+        if (Pass.Culled) {
+            continue;
+        }
+
+        for (const auto *Resources : {&Pass.Inputs, &Pass.Outputs}) {
+            for (render_resource Resource : *Resources) {
+                int Index = (int)Resource;
+                if (!Graph.IsTransient[Index]) {
+                    continue;
+                }
+                if (FirstUse[Index] < 0) {
+                    FirstUse[Index] = i;
+                }
+                LastUse[Index] = i;
+            }
+        }
+    }
+
+    // ### Aliasing ###
+    // In pass order, hand every transient a pool texture of the same
+    // description that is free by its first use
+    for (render_graph_texture &Texture : Graph.Pool) {
+        Texture.BusyUntil = -1;
+    }
+    std::vector<bool> Used(Graph.Pool.size(), false);
+    Graph.TransientCount = 0;
+    for (int i = 0; i < PassCount; i++) {
+        for (int Index = 0; Index < ResourceCount; Index++) {
+            if (FirstUse[Index] != i) {
+                continue;
+            }
+            Graph.TransientCount++;
+
+            const render_texture_desc &Desc = Graph.Descs[Index];
+            int Physical = -1;
+            for (size_t p = 0; p < Graph.Pool.size(); p++) {
+                if (Graph.Pool[p].BusyUntil < i &&
+                    RenderGraph_SameDesc(Graph.Pool[p].Desc, Desc)) {
+                    Physical = (int)p;
+                    break;
+                }
+            }
+            if (Physical < 0) {
+                GLuint Texture = RenderGraph_CreateTexture(Desc);
+                Graph.Pool.push_back({Desc, Texture, -1});
+                Used.push_back(false);
+                Physical = (int)Graph.Pool.size() - 1;
+            }
+
+            Graph.Pool[Physical].BusyUntil = LastUse[Index];
+            Used[Physical] = true;
+            Graph.Physical[Index] = Physical;
+        }
+    }
+
+    // Textures nobody used this frame are kept while a transient still
+    // describes them, a toggled effect gets them back next frame. Old sizes
+    // and formats are freed.
+    std::vector<int> Remap(Graph.Pool.size(), -1);
+    size_t Kept = 0;
+    for (size_t p = 0; p < Graph.Pool.size(); p++) {
+        bool Described = false;
+        for (int Index = 0; Index < ResourceCount && !Described; Index++) {
+            Described = Graph.IsTransient[Index] &&
+                        RenderGraph_SameDesc(Graph.Pool[p].Desc,
+                                             Graph.Descs[Index]);
+        }
+        if (!Used[p] && !Described) {
+            glDeleteTextures(1, &Graph.Pool[p].ID);
+            continue;
+        }
+        Remap[p] = (int)Kept;
+        Graph.Pool[Kept++] = Graph.Pool[p];
+    }
+    Graph.Pool.resize(Kept);
+    for (int Index = 0; Index < ResourceCount; Index++) {
+        if (Graph.Physical[Index] >= 0) {
+            Graph.Physical[Index] = Remap[Graph.Physical[Index]];
+        }
+    }
+    Graph.PhysicalCount = (int)Graph.Pool.size();
+}
+
+void RenderGraph_Execute(render_graph &Graph) {
+    for (render_graph_pass &Pass : Graph.Passes) {
+        if (!Pass.Culled) {
+            Pass.Execute();
+        }
+    }
+    // The closures capture the frame's locals, only the names and culling
+    // stay around for the stats
+    for (render_graph_pass &Pass : Graph.Passes) {
+        Pass.Execute = nullptr;
+    }
+}
+
+GLuint RenderGraph_GetTexture(const render_graph &Graph,
+                              render_resource Resource) {
+    int Physical = Graph.Physical[(int)Resource];
+    return Physical >= 0 ? Graph.Pool[Physical].ID : 0;
+}
+
+const render_texture_desc &RenderGraph_GetDesc(const render_graph &Graph,
+                                               render_resource Resource) {
+    return Graph.Descs[(int)Resource];
+}
+
+void RenderGraph_ReleaseTextures(render_graph &Graph) {
+    for (render_graph_texture &Texture : Graph.Pool) {
+        glDeleteTextures(1, &Texture.ID);
+    }
+    Graph.Pool.clear();
+}
@@ -0,0 +1,88 @@
+#ifndef RENDER_GRAPH_H_
+#define RENDER_GRAPH_H_
+
+#include <glad/glad.h>
+#include <functional>
+#include <vector>
+
+#define BLOOM_MIP_COUNT 6
+
+// Everything a pass can read or write. The Backbuffer is the only resource
+// the frame must produce, a pass whose outputs nobody reads gets culled.
+enum class render_resource {
+    ShadowMap,
+    PointShadowMap,
+    Refraction,
+    Reflection,
+    SceneColor,
+    WaterColorCopy,
+    WaterDepthCopy,
+    OITAccum,
+    OITWeight,
+    BloomMip0,
+    BloomMipLast = BloomMip0 + BLOOM_MIP_COUNT - 1,
+    Backbuffer,
+    Count
+};
+
+// Transient targets only live for a part of the frame. They are described
+// every frame and backed by textures of the graph pool, two transients with
+// the same description and non-overlapping lifetimes get the same texture.
+// GL 3.3 can't alias memory between formats or sizes, transients meant to
+// share pick the same description (the water copy and the OIT
+// accumulation).
+struct render_texture_desc {
+    GLenum InternalFormat;
+    int Width;
+    int Height;
+};
+
+struct render_graph_pass {
+    const char *Name;
+    std::vector<render_resource> Inputs;
+    std::vector<render_resource> Outputs;
+    std::function<void()> Execute;
+    bool Culled;
+};
+
+struct render_graph_texture {
+    render_texture_desc Desc;
+    GLuint ID;
+    // index of the last pass using it in this frame, -1 while free
+    int BusyUntil;
+};
+
+struct render_graph {
+    std::vector<render_graph_pass> Passes;
+
+    bool IsTransient[(int)render_resource::Count];
+    render_texture_desc Descs[(int)render_resource::Count];
+    // index into Pool, -1 if not allocated this frame
+    int Physical[(int)render_resource::Count];
+    std::vector<render_graph_texture> Pool;
+
+    // Stats of the last compile
+    int CulledPassCount;
+    int TransientCount;
+    int PhysicalCount;
+};
+
+render_resource RenderGraph_BloomMip(unsigned int Index);
+GLenum RenderGraph_GetPixelFormat(GLenum InternalFormat);
+GLenum RenderGraph_GetPixelType(GLenum InternalFormat);
+void RenderGraph_Begin(render_graph &Graph);
+void RenderGraph_CreateTransient(render_graph &Graph, render_resource Resource,
+                                 render_texture_desc Desc);
+void RenderGraph_AddPass(render_graph &Graph, const char *Name,
+                         std::vector<render_resource> Inputs,
+                         std::vector<render_resource> Outputs,
+                         std::function<void()> Execute);
+void RenderGraph_Compile(render_graph &Graph);
+void RenderGraph_Execute(render_graph &Graph);
+GLuint RenderGraph_GetTexture(const render_graph &Graph,
+                              render_resource Resource);
+const render_texture_desc &RenderGraph_GetDesc(const render_graph &Graph,
+                                               render_resource Resource);
+void RenderGraph_ReleaseTextures(render_graph &Graph);
+
+#endif
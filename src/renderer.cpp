@@ -3,6 +3,9 @@
 #include <string>
 #include <iostream>
 #include <cerrno>
+#include <algorithm>
+#include <cmath>
+#include <functional>
 
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/ext/matrix_transform.hpp"
@@ -20,6 +23,13 @@
 #include "scene.h"
 #include "shader.h"
 
+// (Re)allocates the currently bound 2D texture as an empty render target
+static void Renderer_AllocateColorTarget(GLenum InternalFormat, int Width,
+                                         int Height) {
+    glTexImage2D(GL_TEXTURE_2D, 0, InternalFormat, Width, Height, 0,
+                 RenderGraph_GetPixelFormat(InternalFormat), GL_FLOAT, NULL);
+}
+
 renderer Renderer_Create(const context &Context) {
     // configure global opengl state
     // -----------------------------
@@ -36,6 +46,25 @@ renderer Renderer_Create(const context &Context) {
 
     renderer Renderer;
 
+    // The scene can only skip the present pass if the backbuffer does the
+    // linear -> sRGB conversion for us
+    GLint BackbufferEncoding = GL_LINEAR;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glGetFramebufferAttachmentParameteriv(
+        GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING,
+        &BackbufferEncoding);
+    Renderer.BackbufferSRGB = BackbufferEncoding == GL_SRGB;
+
+    // ### Render Target Formats ###
+    Renderer.Formats = {
+        .SceneColor = GL_R11F_G11F_B10F,
+        .SceneDepth = GL_DEPTH24_STENCIL8,
+        .Bloom = GL_R11F_G11F_B10F,
+        .OITAccum = GL_RGBA16F,
+        .OITWeight = GL_R16F,
+        .Water = GL_RGB8,
+    };
+
     // ### Screen Quad ###
     // Used for the framebuffer post-processing
     float ScreenQuadVertices[] = {
@@ -67,8 +96,8 @@ renderer Renderer_Create(const context &Context) {
     // create a color attachment texture
     glGenTextures(1, &Renderer.TextureColorBuffer);
     glBindTexture(GL_TEXTURE_2D, Renderer.TextureColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Context.ScreenWidth,
-                 Context.ScreenHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+    Renderer_AllocateColorTarget(Renderer.Formats.SceneColor,
+                                 Context.ScreenWidth, Context.ScreenHeight);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     // we clamp to the edge as the blur filter would otherwise sample repeated
@@ -78,19 +107,6 @@ renderer Renderer_Create(const context &Context) {
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                            Renderer.TextureColorBuffer, 0);
 
-    // create another color attachment texture for only the bright colors
-    glGenTextures(1, &Renderer.BrightColorBuffer);
-    glBindTexture(GL_TEXTURE_2D, Renderer.BrightColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Context.ScreenWidth,
-                 Context.ScreenHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // we clamp to the edge as the blur filter would otherwise sample repeated
-    // texture values!
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
-                           Renderer.BrightColorBuffer, 0);
     // create a renderbuffer object for depth and stencil attachment (we won't
     // be sampling these)
     glGenRenderbuffers(1, &Renderer.RBO);
@@ -98,15 +114,16 @@ renderer Renderer_Create(const context &Context) {
 
     // use a single renderbuffer object for
     // both a depth AND stencil buffer.
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+    glRenderbufferStorage(GL_RENDERBUFFER, Renderer.Formats.SceneDepth,
                           Context.ScreenWidth, Context.ScreenHeight);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
                               GL_RENDERBUFFER, Renderer.RBO);
 
     // tell OpenGL which color attachments we'll use (of this framebuffer) for
     // rendering
+    // the bright colors for bloom are extracted by the bloom pass itself
     unsigned int Attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-    glDrawBuffers(2, Attachments);
+    glDrawBuffers(1, Attachments);
     // now that we actually created the framebuffer and added all attachments we
     // want to check if it is actually complete now
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
@@ -114,30 +131,34 @@ renderer Renderer_Create(const context &Context) {
                   << std::endl;
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    Renderer.SceneFramebuffer = Renderer.FrameBuffer;
+
+    // ### Weighted Blended OIT Configuration ###
+    // The color targets come from the render graph and are attached by the
+    // transparent pass
+    glGenFramebuffers(1, &Renderer.OITFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer.OITFBO);
+    // depth tested against the opaque scene, never written
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, Renderer.RBO);
+    glDrawBuffers(2, Attachments);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // ping-pong-framebuffer for blurring
-    glGenFramebuffers(2, Renderer.PingPongFBO);
-    glGenTextures(2, Renderer.PingPongColorBuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, Renderer.PingPongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, Renderer.PingPongColorBuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Context.ScreenWidth,
-                     Context.ScreenHeight, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // we clamp to the edge as the blur filter would
-        // otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D, Renderer.PingPongColorBuffers[i],
-                               0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
-            GL_FRAMEBUFFER_COMPLETE) {
-            std::cout << "Framebuffer not complete!" << std::endl;
-        }
-    }
+    glGenBuffers(1, &Renderer.TransparentInstanceVBO);
+
+    // ### Bloom Mip Chain Configuration ###
+    // The mips come from the render graph and get attached to the FBO one at
+    // a time by the bloom pass
+    glGenFramebuffers(1, &Renderer.BloomFBO);
+    Renderer.BloomFilterRadius = 0.005f;
+    Renderer.BloomThreshold = 1.0f;
+
+    // ### Render Graph Configuration ###
+    // Nothing is allocated until the first compile
+    RenderGraph_Begin(Renderer.Graph);
+    Renderer.Graph.CulledPassCount = 0;
+    Renderer.Graph.TransientCount = 0;
+    Renderer.Graph.PhysicalCount = 0;
 
     // ### Depth Map Configuration ###
     glGenFramebuffers(1, &Renderer.DepthMapFBO);
@@ -186,6 +207,62 @@ renderer Renderer_Create(const context &Context) {
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // ### Dual Paraboloid Depth Map Configuration ###
+    glGenFramebuffers(1, &Renderer.DepthParaboloidFBO);
+
+    glGenTextures(1, &Renderer.DepthParaboloidBuffer);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, Renderer.DepthParaboloidBuffer);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT,
+                 Context.ShadowbufferWidth, Context.ShadowbufferHeight, 2, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer.DepthParaboloidFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                         Renderer.DepthParaboloidBuffer, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::FRAMEBUFFER:: Paraboloid depth framebuffer is not "
+                     "complete!"
+                  << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // ### Depth Pre-Pass Configuration ###
+    glGenQueries(2, Renderer.DepthPrePassQueries);
+    Renderer.DepthPrePassQueryScene = nullptr;
+    Renderer.DepthPrePassOverdrawThreshold = 1.3f;
+    Renderer.DepthPrePassProbeInterval = 120;
+
+    // ### Dynamic Resolution Configuration ###
+    Renderer.DynamicResolutionEnabled = false;
+    Renderer.RenderScale = 1.0f;
+    Renderer.MinRenderScale = 0.5f;
+    Renderer.TargetFrameTime = 16.0f;
+    Renderer.Sharpness = 0.5f;
+    Renderer.SceneWidth = Context.ScreenWidth;
+    Renderer.SceneHeight = Context.ScreenHeight;
+    Renderer.SceneUVScale = glm::vec2(1.0f);
+
+    glGenQueries(GPU_TIMER_QUERY_COUNT, Renderer.GPUTimerQueries);
+    for (unsigned int i = 0; i < GPU_TIMER_QUERY_COUNT; i++) {
+        Renderer.GPUTimerPending[i] = false;
+    }
+    Renderer.GPUTimerFrame = 0;
+    Renderer.GPUFrameTime = 0.0f;
+    Renderer.GPUFrameTimeSum = 0.0f;
+    Renderer.GPUFrameTimeSamples = 0;
+    Renderer.DynamicResolutionInterval = 8;
+    Renderer.FramesUntilScaleUpdate = Renderer.DynamicResolutionInterval;
+
+    // ### Screen Space Water Configuration ###
+    // The copy targets come from the render graph
+    glGenFramebuffers(1, &Renderer.WaterCopyFBO);
+
     // ### Water Buffers Configuration ###
     // Refraction
     Renderer.RefractionFBOWidth = 1280;
@@ -195,9 +272,9 @@ renderer Renderer_Create(const context &Context) {
     glDrawBuffer(GL_COLOR_ATTACHMENT0);
     glGenTextures(1, &Renderer.RefractionColorBuffer);
     glBindTexture(GL_TEXTURE_2D, Renderer.RefractionColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, Renderer.RefractionFBOWidth,
-                 Renderer.RefractionFBOHeight, 0, GL_RGB, GL_UNSIGNED_BYTE,
-                 NULL);
+    Renderer_AllocateColorTarget(Renderer.Formats.Water,
+                                 Renderer.RefractionFBOWidth,
+                                 Renderer.RefractionFBOHeight);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -231,9 +308,9 @@ renderer Renderer_Create(const context &Context) {
     glDrawBuffer(GL_COLOR_ATTACHMENT0);
     glGenTextures(1, &Renderer.ReflectionColorBuffer);
     glBindTexture(GL_TEXTURE_2D, Renderer.ReflectionColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, Renderer.ReflectionFBOWidth,
-                 Renderer.ReflectionFBOHeight, 0, GL_RGB, GL_UNSIGNED_BYTE,
-                 NULL);
+    Renderer_AllocateColorTarget(Renderer.Formats.Water,
+                                 Renderer.ReflectionFBOWidth,
+                                 Renderer.ReflectionFBOHeight);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -257,6 +334,15 @@ renderer Renderer_Create(const context &Context) {
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // ### Planar Water Configuration ###
+    Renderer.PlanarWaterVisible = false;
+    Renderer.PlanarWaterValid = false;
+    Renderer.PlanarWaterInterval = 1;
+    Renderer.FramesUntilPlanarWaterUpdate = 0;
+    Renderer.PlanarWaterScale = 1.0f;
+    Renderer.PlanarWaterMinScale = 0.25f;
+    Renderer.PlanarWaterMinObjectSize = 0.02f;
+
     return Renderer;
 }
 
@@ -267,6 +353,13 @@ void Renderer_Destroy(renderer &Renderer) {
     glDeleteTextures(1, &Renderer.TextureColorBuffer);
     glDeleteRenderbuffers(1, &Renderer.RBO);
 
+    glDeleteFramebuffers(1, &Renderer.BloomFBO);
+    glDeleteFramebuffers(1, &Renderer.OITFBO);
+    RenderGraph_ReleaseTextures(Renderer.Graph);
+    glDeleteBuffers(1, &Renderer.TransparentInstanceVBO);
+
+    glDeleteFramebuffers(1, &Renderer.WaterCopyFBO);
+
     glDeleteFramebuffers(1, &Renderer.RefractionFBO);
     glDeleteTextures(1, &Renderer.RefractionColorBuffer);
     glDeleteTextures(1, &Renderer.RefractionDepthBuffer);
@@ -274,21 +367,28 @@ void Renderer_Destroy(renderer &Renderer) {
     glDeleteFramebuffers(1, &Renderer.ReflectionFBO);
     glDeleteTextures(1, &Renderer.ReflectionColorBuffer);
     glDeleteRenderbuffers(1, &Renderer.ReflectionRBO);
+
+    glDeleteFramebuffers(1, &Renderer.DepthParaboloidFBO);
+    glDeleteTextures(1, &Renderer.DepthParaboloidBuffer);
+
+    glDeleteQueries(2, Renderer.DepthPrePassQueries);
+    glDeleteQueries(GPU_TIMER_QUERY_COUNT, Renderer.GPUTimerQueries);
 }
 
-void Renderer_ResizeFramebuffer(const renderer &Renderer, int ScreenWidth,
+void Renderer_ResizeFramebuffer(renderer &Renderer, int ScreenWidth,
                                 int ScreenHeight) {
     if (ScreenWidth <= 0 || ScreenHeight <= 0) {
         return;
     }
 
+    // The persistent screen sized targets: scene color and the depth/stencil
+    // shared with the OIT framebuffer
     glBindTexture(GL_TEXTURE_2D, Renderer.TextureColorBuffer);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, ScreenWidth, ScreenHeight, 0,
-                 GL_RGBA, GL_FLOAT, NULL);
-
+    Renderer_AllocateColorTarget(Renderer.Formats.SceneColor, ScreenWidth,
+                                 ScreenHeight);
     glBindRenderbuffer(GL_RENDERBUFFER, Renderer.RBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, ScreenWidth,
-                          ScreenHeight);
+    glRenderbufferStorage(GL_RENDERBUFFER, Renderer.Formats.SceneDepth,
+                          ScreenWidth, ScreenHeight);
 
     glBindFramebuffer(GL_FRAMEBUFFER, Renderer.FrameBuffer);
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
@@ -300,6 +400,10 @@ void Renderer_ResizeFramebuffer(const renderer &Renderer, int ScreenWidth,
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
     glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Every transient (OIT targets, bloom mips) is described from the new
+    // size by the next frame's graph, drop the old textures right away
+    RenderGraph_ReleaseTextures(Renderer.Graph);
 }
 
 void Renderer_ClearBackground(float R, float G, float B, float Alpha) {
@@ -315,28 +419,317 @@ void Renderer_BindFramebuffer(const renderer &Renderer, GLuint FramebufferID,
 }
 
 void Renderer_DrawSceneWater(const renderer &Renderer, const scene &Scene) {
+    const shader *OceanShader =
+        ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Water);
+    Shader_SetInt(*OceanShader, "u_ocean", Scene.OceanEnabled ? 1 : 0);
+    if (Scene.OceanEnabled) {
+        Shader_SetFloat(*OceanShader, "u_ocean_patch_length",
+                        Scene.Ocean.Spectrum.PatchLength);
+        glActiveTexture(GL_TEXTURE8);
+        glBindTexture(GL_TEXTURE_2D, Scene.Ocean.Texture);
+    }
+
     for (entity Entity : Scene.Entities) {
         if (Entity.Mesh.Material.ShaderMaterial != shader_material::Water) {
             continue;
         }
+        // water.vert only takes lod_grid nodes
+        if (Entity.Type != entity_type::LodGrid) {
+            continue;
+        }
 
         const shader *WaterShader = ResourceManager_GetShader(
             Renderer.ResourceManager, shader_type::Water);
-        Renderer_DrawQuadEntity(Renderer, *WaterShader, Entity);
+        Renderer_DrawLodGridEntity(Renderer, *WaterShader, Entity,
+                                   Renderer.CameraView);
+    }
+}
+
+bool Renderer_IsDepthPrePassEntity(const entity &Entity) {
+    // Only opaque lit geometry goes into the pre-pass. Quads are alpha tested
+    // or blended (grass, windows, water) and the depth-only path doesn't
+    // sample their textures.
+    if (Entity.Type != entity_type::CubeMesh &&
+        Entity.Type != entity_type::Model) {
+        return false;
+    }
+    return Entity.Mesh.Material.ShaderMaterial == shader_material::Default;
+}
+
+bool Renderer_IsTransparentEntity(const entity &Entity) {
+    return Entity.Type == entity_type::QuadMesh &&
+           Entity.Mesh.Material.IsTransparent &&
+           Entity.Mesh.Material.ShaderMaterial == shader_material::Default;
+}
+
+static bool Renderer_PassesFilter(const entity &Entity, draw_filter Filter) {
+    switch (Filter) {
+    case draw_filter::All:
+        return true;
+    case draw_filter::Opaque:
+        return !Renderer_IsTransparentEntity(Entity);
+    case draw_filter::DepthPrePass:
+        return Renderer_IsDepthPrePassEntity(Entity);
+    case draw_filter::NoDepthPrePass:
+        return !Renderer_IsDepthPrePassEntity(Entity) &&
+               !Renderer_IsTransparentEntity(Entity);
+    }
+    return true;
+}
+
+static glm::mat4 Renderer_GetModelMatrix(const entity &Entity) {
+    glm::mat4 Model = glm::mat4(1.0f);
+    Model = glm::translate(Model, Entity.Position);
+    Model = glm::scale(Model, Entity.Scale);
+
+    glm::vec3 RotationVec =
+        glm::vec3(Entity.Rotation[1], Entity.Rotation[2], Entity.Rotation[3]);
+    Model = glm::rotate(Model, glm::radians(Entity.Rotation[0]), RotationVec);
+    return Model;
+}
+
+static glm::mat4 Renderer_GetProjectionMatrix(const camera &Camera,
+                                              float ScreenWidth,
+                                              float ScreenHeight) {
+    return glm::perspective(glm::radians(Camera.Zoom),
+                            ScreenWidth / ScreenHeight, 0.1f, 100.0f);
+}
+
+static camera Renderer_GetReflectionCamera(const camera &Camera) {
+    // Invert Camera position and pitch
+    float Distance = 2 * (Camera.Position.y); // - WaterHeight
+    glm::vec3 NewPosition = glm::vec3(
+        Camera.Position.x, Camera.Position.y - Distance, Camera.Position.z);
+    return Camera_Create(NewPosition, Camera.Up, Camera.Yaw, -Camera.Pitch);
+}
+
+// Gribb/Hartmann: the planes are sums of the rows of the view projection,
+// normalized so the sphere tests can use distances
+static void Renderer_ExtractFrustumPlanes(const glm::mat4 &ViewProjection,
+                                          glm::vec4 Planes[6]) {
+    glm::mat4 Rows = glm::transpose(ViewProjection);
+    Planes[0] = Rows[3] + Rows[0]; // left
+    Planes[1] = Rows[3] - Rows[0]; // right
+    Planes[2] = Rows[3] + Rows[1]; // bottom
+    Planes[3] = Rows[3] - Rows[1]; // top
+    Planes[4] = Rows[3] + Rows[2]; // near
+    Planes[5] = Rows[3] - Rows[2]; // far
+    for (unsigned int i = 0; i < 6; i++) {
+        Planes[i] /= glm::length(glm::vec3(Planes[i]));
+    }
+}
+
+static bool Renderer_SphereInFrustum(const glm::vec4 Planes[6],
+                                     glm::vec3 Center, float Radius) {
+    for (unsigned int i = 0; i < 6; i++) {
+        if (glm::dot(glm::vec3(Planes[i]), Center) + Planes[i].w < -Radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Renderer_GetEntityBounds(const entity &Entity, glm::vec3 &Min,
+                                     glm::vec3 &Max) {
+    if (Entity.Type == entity_type::Model && Entity.Model) {
+        Min = Entity.Model->BoundsMin;
+        Max = Entity.Model->BoundsMax;
+    } else if (Entity.Type == entity_type::LodGrid && Entity.Grid) {
+        float HalfSize = Entity.Grid->Size * 0.5f;
+        Min = glm::vec3(-HalfSize, Entity.Grid->MinHeight, -HalfSize);
+        Max = glm::vec3(HalfSize, Entity.Grid->MaxHeight, HalfSize);
+    } else {
+        Min = Entity.Mesh.BoundsMin;
+        Max = Entity.Mesh.BoundsMax;
+    }
+}
+
+// The local box transformed and boxed again, loose for rotated entities
+static void Renderer_GetWorldBounds(const entity &Entity, glm::vec3 &Min,
+                                    glm::vec3 &Max) {
+    glm::vec3 LocalMin, LocalMax;
+    Renderer_GetEntityBounds(Entity, LocalMin, LocalMax);
+
+    glm::mat4 Model = Renderer_GetModelMatrix(Entity);
+    glm::vec3 Center =
+        glm::vec3(Model * glm::vec4((LocalMin + LocalMax) * 0.5f, 1.0f));
+    glm::vec3 HalfSize = (LocalMax - LocalMin) * 0.5f;
+    glm::vec3 Extent(0.0f);
+    for (int Axis = 0; Axis < 3; Axis++) {
+        Extent += glm::abs(glm::vec3(Model[Axis])) * HalfSize[Axis];
+    }
+    Min = Center - Extent;
+    Max = Center + Extent;
+}
+
+// Outside as soon as the corner furthest along a plane's normal is behind it
+static bool Renderer_BoxInPlanes(const glm::vec4 Planes[6], glm::vec3 Min,
+                                 glm::vec3 Max) {
+    for (unsigned int i = 0; i < 6; i++) {
+        glm::vec3 Normal = glm::vec3(Planes[i]);
+        glm::vec3 Corner = glm::vec3(Normal.x >= 0.0f ? Max.x : Min.x,
+                                     Normal.y >= 0.0f ? Max.y : Min.y,
+                                     Normal.z >= 0.0f ? Max.z : Min.z);
+        if (glm::dot(Normal, Corner) + Planes[i].w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Renderer_GetBoundingSphere(const entity &Entity, glm::vec3 &Center,
+                                       float &Radius) {
+    glm::vec3 Min, Max;
+    Renderer_GetEntityBounds(Entity, Min, Max);
+
+    glm::mat4 Model = Renderer_GetModelMatrix(Entity);
+    Center = glm::vec3(Model * glm::vec4((Min + Max) * 0.5f, 1.0f));
+    glm::vec3 Scale = glm::abs(Entity.Scale);
+    Radius = glm::length(Max - Min) * 0.5f *
+             std::max(Scale.x, std::max(Scale.y, Scale.z));
+}
+
+static bool Renderer_IsEntityVisible(const entity &Entity,
+                                     const draw_cull &Cull) {
+    glm::vec3 Center;
+    float Radius;
+    Renderer_GetBoundingSphere(Entity, Center, Radius);
+
+    // entirely on the clipped side of the water plane
+    if (glm::dot(glm::vec3(Cull.ClipPlane), Center) + Cull.ClipPlane.w <
+        -Radius) {
+        return false;
+    }
+    if (!Renderer_SphereInFrustum(Cull.FrustumPlanes, Center, Radius)) {
+        return false;
+    }
+
+    // too small to matter in a low resolution, distorted water texture
+    float Distance = glm::length(Center - Cull.ViewPosition);
+    return Distance <= Radius ||
+           2.0f * Radius / Distance >= Cull.MinAngularSize;
+}
+
+// Pass wide uniforms have to reach every compiled default.frag permutation
+static void
+Renderer_ForEachLitShader(const renderer &Renderer,
+                          const std::function<void(const shader &)> &Apply) {
+    const shader_type Fallbacks[] = {shader_type::Lit, shader_type::Instance,
+                                     shader_type::Terrain};
+    for (shader_type Type : Fallbacks) {
+        Apply(*ResourceManager_GetShader(Renderer.ResourceManager, Type));
+    }
+    for (const auto &Permutation : Renderer.ResourceManager.LitShaders) {
+        // touching a program that is still linking would wait for it
+        if (!Permutation.second.Pending && !Permutation.second.Failed) {
+            Apply(Permutation.second);
+        }
+    }
+}
+
+// Features every lit draw of the scene shares, decided by its lights
+static unsigned int Renderer_GetSceneFeatures(const scene &Scene) {
+    unsigned int Features = 0;
+    for (const light &Light : Scene.Lights) {
+        if (Light.IsEnabled) {
+            Features |= SHADER_FEATURE_LIT;
+            if (Light.CastsShadow) {
+                Features |= SHADER_FEATURE_SHADOWS;
+            }
+        }
+    }
+    return Features;
+}
+
+static unsigned int Renderer_GetEntityFeatures(const entity &Entity) {
+    unsigned int Features = Material_GetShaderFeatures(Entity.Mesh.Material);
+    if (Entity.Type == entity_type::Model && Entity.Model) {
+        // one program for the whole model, so whatever any mesh needs
+        for (const mesh &Mesh : Entity.Model->Meshes) {
+            Features |= Material_GetShaderFeatures(Mesh.Material);
+        }
+    } else if (Entity.Type == entity_type::LodGrid) {
+        Features |= SHADER_FEATURE_TERRAIN;
+    }
+    return Features;
+}
+
+static unsigned int Renderer_GetInstanceFeatures(const scene &Scene) {
+    unsigned int Features =
+        Renderer_GetSceneFeatures(Scene) | SHADER_FEATURE_INSTANCED;
+    if (Scene.Instances.size() > 0 && Scene.Instances[0].Model) {
+        for (const mesh &Mesh : Scene.Instances[0].Model->Meshes) {
+            Features |= Material_GetShaderFeatures(Mesh.Material);
+        }
+    }
+    return Features;
+}
+
+// Submits the permutations this frame's draws will look up. They compile in
+// the background, until then the draws use the uniform driven fallbacks.
+static void Renderer_PrepareLitShaders(renderer &Renderer, const scene &Scene,
+                                       bool Clipped) {
+    // Done before submitting, so without parallel compile the driver had a
+    // frame for the new ones before anything waits on them
+    Renderer.ResourceManager.PendingLitShaders =
+        ResourceManager_UpdateLitShaders(Renderer.ResourceManager);
+
+    unsigned int SceneFeatures = Renderer_GetSceneFeatures(Scene);
+    std::vector<unsigned int> Needed;
+    for (const entity &Entity : Scene.Entities) {
+        if (Entity.Mesh.Material.ShaderMaterial == shader_material::Default ||
+            Entity.Type == entity_type::LodGrid) {
+            Needed.push_back(SceneFeatures |
+                             Renderer_GetEntityFeatures(Entity));
+        }
+    }
+    for (const light &Light : Scene.Lights) {
+        if (Light.ShowDebug &&
+            Light.Entity.Mesh.Material.ShaderMaterial ==
+                shader_material::Default) {
+            Needed.push_back(SceneFeatures |
+                             Renderer_GetEntityFeatures(Light.Entity));
+        }
+    }
+    if (Scene.Instances.size() > 0) {
+        Needed.push_back(Renderer_GetInstanceFeatures(Scene));
+    }
+
+    for (unsigned int Features : Needed) {
+        ResourceManager_GetLitShader(Renderer.ResourceManager, Features);
+        // the planar water passes draw the same entities with the clip plane
+        if (Clipped && !(Features & SHADER_FEATURE_INSTANCED)) {
+            ResourceManager_GetLitShader(Renderer.ResourceManager,
+                                         Features | SHADER_FEATURE_CLIP_PLANE);
+        }
     }
 }
 
 void Renderer_DrawScene(const renderer &Renderer, const shader &Shader,
-                        const scene &Scene, bool useEntityShader) {
+                        const scene &Scene, bool useEntityShader,
+                        draw_filter Filter, const draw_cull *Cull) {
+    // Only the planar water passes cull against a clip plane
+    unsigned int PassFeatures = Renderer_GetSceneFeatures(Scene);
+    if (Cull) {
+        PassFeatures |= SHADER_FEATURE_CLIP_PLANE;
+    }
 
     // Entities
     for (entity Entity : Scene.Entities) {
+        if (!Renderer_PassesFilter(Entity, Filter)) {
+            continue;
+        }
+        if (Cull && !Renderer_IsEntityVisible(Entity, *Cull)) {
+            continue;
+        }
+
         shader _Shader = Shader;
         if (useEntityShader) {
             switch (Entity.Mesh.Material.ShaderMaterial) {
             case shader_material::Default: {
-                const shader *DefaultShader = ResourceManager_GetShader(
-                    Renderer.ResourceManager, shader_type::Lit);
+                const shader *DefaultShader = ResourceManager_FindLitShader(
+                    Renderer.ResourceManager,
+                    PassFeatures | Renderer_GetEntityFeatures(Entity));
                 _Shader = *DefaultShader;
                 break;
             }
@@ -373,18 +766,32 @@ void Renderer_DrawScene(const renderer &Renderer, const shader &Shader,
         case entity_type::QuadMesh:
             Renderer_DrawQuadEntity(Renderer, _Shader, Entity);
             break;
+        case entity_type::LodGrid: {
+            // Heightmap terrain, lit by the default fragment shader
+            const shader *TerrainShader = ResourceManager_FindLitShader(
+                Renderer.ResourceManager,
+                PassFeatures | Renderer_GetEntityFeatures(Entity));
+            Renderer_DrawLodGridEntity(Renderer, *TerrainShader, Entity,
+                                       Cull ? *Cull : Renderer.CameraView);
+            break;
+        }
         }
     }
 
-    if (useEntityShader) {
+    if (useEntityShader && Filter != draw_filter::DepthPrePass) {
         // Lights (Debug)
         for (light Light : Scene.Lights) {
+            if (Cull && !Renderer_IsEntityVisible(Light.Entity, *Cull)) {
+                continue;
+            }
             if (Light.ShowDebug && Light.LightType == light_type::Point) {
                 shader _Shader = Shader;
                 switch (Light.Entity.Mesh.Material.ShaderMaterial) {
                 case shader_material::Default: {
-                    const shader *DefaultShader = ResourceManager_GetShader(
-                        Renderer.ResourceManager, shader_type::Lit);
+                    unsigned int Features =
+                        PassFeatures | Renderer_GetEntityFeatures(Light.Entity);
+                    const shader *DefaultShader = ResourceManager_FindLitShader(
+                        Renderer.ResourceManager, Features);
                     _Shader = *DefaultShader;
                 } break;
                 case shader_material::Unlit: {
@@ -403,15 +810,91 @@ void Renderer_DrawScene(const renderer &Renderer, const shader &Shader,
     }
 }
 
-void Renderer_DirectionalShadowPass(const renderer &Renderer,
-                                    const scene &Scene,
-                                    const context &Context) {
-    Renderer_BindFramebuffer(Renderer, Renderer.DepthMapFBO,
-                             Context.ShadowbufferWidth,
-                             Context.ShadowbufferHeight);
-    glEnable(GL_DEPTH_TEST);
-    glClear(GL_DEPTH_BUFFER_BIT);
+static void Renderer_PushDepthDrawItem(std::vector<depth_draw_item> &Items,
+                                       const mesh &Mesh,
+                                       const glm::mat4 &Model, bool CullFace) {
+    depth_draw_item Item = {
+        .VAO = Mesh.DepthVAO,
+        .IndicesNum = Mesh.IndicesNum,
+        .Model = Model,
+        .CullFace = CullFace,
+    };
+    Items.push_back(Item);
+}
+
+void Renderer_DrawSceneDepth(const renderer &Renderer, const shader &Shader,
+                             const scene &Scene, draw_filter Filter,
+                             const shadow_cull *Cull) {
+    // Collect the same geometry Renderer_DrawScene would draw, but without any
+    // material state: no textures are bound and no u_material.* is set.
+    std::vector<depth_draw_item> Items;
+    Items.reserve(Scene.Entities.size());
+    for (const entity &Entity : Scene.Entities) {
+        if (!Renderer_PassesFilter(Entity, Filter)) {
+            continue;
+        }
+        if (Cull) {
+            glm::vec3 Min, Max;
+            Renderer_GetWorldBounds(Entity, Min, Max);
+            if (!Renderer_BoxInPlanes(Cull->Planes, Min, Max)) {
+                continue;
+            }
+        }
+
+        glm::mat4 Model = Renderer_GetModelMatrix(Entity);
+        switch (Entity.Type) {
+        case entity_type::CubeMesh:
+            Renderer_PushDepthDrawItem(Items, Entity.Mesh, Model,
+                                       Entity.Mesh.Material.CullFace);
+            break;
+        case entity_type::QuadMesh:
+            Renderer_PushDepthDrawItem(Items, Entity.Mesh, Model, false);
+            break;
+        case entity_type::Model:
+            for (const mesh &Mesh : Entity.Model->Meshes) {
+                Renderer_PushDepthDrawItem(Items, Mesh, Model, true);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Sort by VAO so consecutive draws of the same geometry skip the rebind
+    std::sort(Items.begin(), Items.end(),
+              [](const depth_draw_item &A, const depth_draw_item &B) {
+                  return A.VAO < B.VAO;
+              });
+
+    Shader_Use(Shader);
+    GLint ModelLoc = Shader_GetUniform(Shader, "u_model");
+
+    GLuint BoundVAO = 0;
+    bool CullFaceEnabled = true;
+    glEnable(GL_CULL_FACE);
+    for (const depth_draw_item &Item : Items) {
+        if (Item.VAO != BoundVAO) {
+            glBindVertexArray(Item.VAO);
+            BoundVAO = Item.VAO;
+        }
+        if (Item.CullFace != CullFaceEnabled) {
+            if (Item.CullFace) {
+                glEnable(GL_CULL_FACE);
+            } else {
+                glDisable(GL_CULL_FACE);
+            }
+            CullFaceEnabled = Item.CullFace;
+        }
 
+        glUniformMatrix4fv(ModelLoc, 1, GL_FALSE, glm::value_ptr(Item.Model));
+        glDrawElements(GL_TRIANGLES, Item.IndicesNum, GL_UNSIGNED_INT, 0);
+    }
+
+    glEnable(GL_CULL_FACE);
+    glBindVertexArray(0);
+}
+
+static glm::mat4 Renderer_GetLightSpaceMatrix() {
     // Set view & projection for depth shader from the light's perspective
     float NearPlane = 0.1f, FarPlane = 25.0f;
     glm::mat4 LightProjection =
@@ -422,7 +905,37 @@ void Renderer_DirectionalShadowPass(const renderer &Renderer,
     glm::mat4 LightView = glm::lookAt(LightPos, glm::vec3(0.0f, 0.0f, 0.0f),
                                       glm::vec3(0.0f, 1.0f, 0.0f));
 
-    glm::mat4 LightSpaceMatrix = LightProjection * LightView;
+    return LightProjection * LightView;
+}
+
+// Nothing past FarPlane of the light reaches its shadow map, whichever face
+// or hemisphere it lands in
+static shadow_cull Renderer_GetPointShadowCull(glm::vec3 LightPosition,
+                                               float FarPlane) {
+    shadow_cull Cull;
+    for (int Axis = 0; Axis < 3; Axis++) {
+        glm::vec3 Normal(0.0f);
+        Normal[Axis] = 1.0f;
+        Cull.Planes[Axis * 2] =
+            glm::vec4(Normal, FarPlane - LightPosition[Axis]);
+        Cull.Planes[Axis * 2 + 1] =
+            glm::vec4(-Normal, FarPlane + LightPosition[Axis]);
+    }
+    return Cull;
+}
+
+void Renderer_DirectionalShadowPass(const renderer &Renderer,
+                                    const scene &Scene,
+                                    const context &Context) {
+    Renderer_BindFramebuffer(Renderer, Renderer.DepthMapFBO,
+                             Context.ShadowbufferWidth,
+                             Context.ShadowbufferHeight);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    glm::mat4 LightSpaceMatrix = Renderer_GetLightSpaceMatrix();
+    shadow_cull Cull;
+    Renderer_ExtractFrustumPlanes(LightSpaceMatrix, Cull.Planes);
 
     const shader *DepthShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Depth);
@@ -430,7 +943,8 @@ void Renderer_DirectionalShadowPass(const renderer &Renderer,
 
     // Remove peter panning problems
     // glCullFace(GL_FRONT);
-    Renderer_DrawScene(Renderer, *DepthShader, Scene, false);
+    Renderer_DrawSceneDepth(Renderer, *DepthShader, Scene, draw_filter::All,
+                            &Cull);
     glCullFace(GL_BACK);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -438,11 +952,6 @@ void Renderer_DirectionalShadowPass(const renderer &Renderer,
 
 void Renderer_PointShadowPass(const renderer &Renderer, const scene &Scene,
                               const context &Context) {
-    Renderer_BindFramebuffer(Renderer, Renderer.DepthCubemapFBO,
-                             Context.ShadowbufferWidth,
-                             Context.ShadowbufferHeight);
-    glClear(GL_DEPTH_BUFFER_BIT);
-
     // Set view & projection for depth shader from the light's perspective
     float Aspect =
         (float)Context.ShadowbufferWidth / (float)Context.ShadowbufferHeight;
@@ -450,14 +959,47 @@ void Renderer_PointShadowPass(const renderer &Renderer, const scene &Scene,
 
     bool HasPointLight = false;
     glm::vec3 PointLightPosition(0.0f);
+    point_shadow_mode ShadowMode = point_shadow_mode::Cubemap;
     for (const light &Light : Scene.Lights) {
         if (Light.LightType == light_type::Point) {
             HasPointLight = true;
             PointLightPosition = Light.Entity.Position;
+            ShadowMode = Light.ShadowMode;
             break;
         }
     }
 
+    shadow_cull Cull =
+        Renderer_GetPointShadowCull(PointLightPosition, FarPlane);
+
+    if (HasPointLight && ShadowMode == point_shadow_mode::DualParaboloid) {
+        Renderer_BindFramebuffer(Renderer, Renderer.DepthParaboloidFBO,
+                                 Context.ShadowbufferWidth,
+                                 Context.ShadowbufferHeight);
+        glClear(GL_DEPTH_BUFFER_BIT);
+
+        // The geometry shader clips each hemisphere against the other one
+        glEnable(GL_CLIP_DISTANCE0);
+
+        const shader *ParaboloidDepthShader = ResourceManager_GetShader(
+            Renderer.ResourceManager, shader_type::ParaboloidDepth);
+        Shader_SetVec3(*ParaboloidDepthShader, "u_light_pos",
+                       PointLightPosition);
+        Shader_SetFloat(*ParaboloidDepthShader, "u_far_plane", FarPlane);
+
+        Renderer_DrawSceneDepth(Renderer, *ParaboloidDepthShader, Scene,
+                                draw_filter::All, &Cull);
+
+        glDisable(GL_CLIP_DISTANCE0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return;
+    }
+
+    Renderer_BindFramebuffer(Renderer, Renderer.DepthCubemapFBO,
+                             Context.ShadowbufferWidth,
+                             Context.ShadowbufferHeight);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
     if (HasPointLight) {
         glm::mat4 PointLightProjection =
             glm::perspective(glm::radians(90.0f), Aspect, NearPlane, FarPlane);
@@ -505,7 +1047,8 @@ void Renderer_PointShadowPass(const renderer &Renderer, const scene &Scene,
                            PointShadowTransforms[i]);
         }
 
-        Renderer_DrawScene(Renderer, *CubemapDepthShader, Scene, false);
+        Renderer_DrawSceneDepth(Renderer, *CubemapDepthShader, Scene,
+                                draw_filter::All, &Cull);
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -515,9 +1058,10 @@ void Renderer_WaterRefractionPass(const renderer &Renderer, const scene &Scene,
                                   const context &Context) {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CLIP_DISTANCE0);
-    Renderer_BindFramebuffer(Renderer, Renderer.RefractionFBO,
-                             Renderer.RefractionFBOWidth,
-                             Renderer.RefractionFBOHeight);
+    Renderer_BindFramebuffer(
+        Renderer, Renderer.RefractionFBO,
+        (int)(Renderer.RefractionFBOWidth * Renderer.PlanarWaterScale),
+        (int)(Renderer.RefractionFBOHeight * Renderer.PlanarWaterScale));
     glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -525,24 +1069,26 @@ void Renderer_WaterRefractionPass(const renderer &Renderer, const scene &Scene,
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Lit);
     const shader *UnlitShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Unlit);
-    const shader *InstanceShader = ResourceManager_GetShader(
-        Renderer.ResourceManager, shader_type::Instance);
     const shader *WaterShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Water);
 
-    glm::vec4 RefractionClipPlane = glm::vec4(0.0f, -1.0f, 0.0f, 0.01f);
-    Shader_SetVec4(*LitShader, "u_clip_plane", RefractionClipPlane);
+    glm::vec4 RefractionClipPlane = Renderer.RefractionCull.ClipPlane;
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Shader_SetVec4(Shader, "u_clip_plane", RefractionClipPlane);
+    });
     Shader_SetVec4(*UnlitShader, "u_clip_plane", RefractionClipPlane);
-    Shader_SetVec4(*InstanceShader, "u_clip_plane", RefractionClipPlane);
     Shader_SetVec4(*WaterShader, "u_clip_plane", RefractionClipPlane);
 
     Renderer_SetCameraUniforms(Renderer, Context.Camera, Context.ScreenWidth,
                                Context.ScreenHeight);
-    Renderer_SetSceneLightsUniforms(Renderer, *LitShader, Scene,
-                                    Context.Camera);
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Renderer_SetSceneLightsUniforms(Renderer, Shader, Scene,
+                                        Context.Camera);
+    });
     Renderer_SetOtherUniforms(Renderer, Context);
 
-    Renderer_DrawScene(Renderer, *LitShader, Scene);
+    Renderer_DrawScene(Renderer, *LitShader, Scene, true, draw_filter::All,
+                       &Renderer.RefractionCull);
     Renderer_DrawSkybox(Renderer, Scene.Skybox);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -550,9 +1096,10 @@ void Renderer_WaterRefractionPass(const renderer &Renderer, const scene &Scene,
 
 void Renderer_WaterReflectionPass(const renderer &Renderer, const scene &Scene,
                                   const context &Context) {
-    Renderer_BindFramebuffer(Renderer, Renderer.ReflectionFBO,
-                             Renderer.ReflectionFBOWidth,
-                             Renderer.ReflectionFBOHeight);
+    Renderer_BindFramebuffer(
+        Renderer, Renderer.ReflectionFBO,
+        (int)(Renderer.ReflectionFBOWidth * Renderer.PlanarWaterScale),
+        (int)(Renderer.ReflectionFBOHeight * Renderer.PlanarWaterScale));
     glClearColor(0.01f, 0.01f, 0.01f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -560,42 +1107,212 @@ void Renderer_WaterReflectionPass(const renderer &Renderer, const scene &Scene,
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Lit);
     const shader *UnlitShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Unlit);
-    const shader *InstanceShader = ResourceManager_GetShader(
-        Renderer.ResourceManager, shader_type::Instance);
     const shader *WaterShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Water);
 
-    glm::vec4 ReflectionClipPlane = glm::vec4(0.0f, 1.0f, 0.0f, -0.01f);
-    Shader_SetVec4(*LitShader, "u_clip_plane", ReflectionClipPlane);
+    glm::vec4 ReflectionClipPlane = Renderer.ReflectionCull.ClipPlane;
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Shader_SetVec4(Shader, "u_clip_plane", ReflectionClipPlane);
+    });
     Shader_SetVec4(*UnlitShader, "u_clip_plane", ReflectionClipPlane);
-    Shader_SetVec4(*InstanceShader, "u_clip_plane", ReflectionClipPlane);
     Shader_SetVec4(*WaterShader, "u_clip_plane", ReflectionClipPlane);
 
-    // Invert Camera position and pitch
-    float Distance = 2 * (Context.Camera.Position.y); // - WaterHeight
-    glm::vec3 NewPosition = glm::vec3(Context.Camera.Position.x,
-                                      Context.Camera.Position.y - Distance,
-                                      Context.Camera.Position.z);
-    camera OtherCamera =
-        Camera_Create(NewPosition, Context.Camera.Up, Context.Camera.Yaw,
-                      -Context.Camera.Pitch);
+    camera OtherCamera = Renderer_GetReflectionCamera(Context.Camera);
     Renderer_SetCameraUniforms(Renderer, OtherCamera, Context.ScreenWidth,
                                Context.ScreenHeight);
-    Renderer_SetSceneLightsUniforms(Renderer, *LitShader, Scene,
-                                    Context.Camera);
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Renderer_SetSceneLightsUniforms(Renderer, Shader, Scene,
+                                        Context.Camera);
+    });
     Renderer_SetOtherUniforms(Renderer, Context);
 
-    Renderer_DrawScene(Renderer, *LitShader, Scene);
+    Renderer_DrawScene(Renderer, *LitShader, Scene, true, draw_filter::All,
+                       &Renderer.ReflectionCull);
     Renderer_DrawSkybox(Renderer, Scene.Skybox);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void Renderer_MainScenePass(const renderer &Renderer, const scene &Scene,
+bool Renderer_UpdatePlanarWater(renderer &Renderer, const scene &Scene,
+                                const context &Context) {
+    glm::mat4 Projection = Renderer_GetProjectionMatrix(
+        Context.Camera, Context.ScreenWidth, Context.ScreenHeight);
+    glm::mat4 ViewProjection =
+        Projection * Camera_GetViewMatrix(Context.Camera);
+    glm::vec4 Frustum[6];
+    Renderer_ExtractFrustumPlanes(ViewProjection, Frustum);
+
+    // Screen rect of the visible water, from its projected bounds
+    bool Visible = false;
+    glm::vec2 ScreenMin(1.0f);
+    glm::vec2 ScreenMax(-1.0f);
+    for (const entity &Entity : Scene.Entities) {
+        if (Entity.Mesh.Material.ShaderMaterial != shader_material::Water) {
+            continue;
+        }
+
+        glm::vec3 Center;
+        float Radius;
+        Renderer_GetBoundingSphere(Entity, Center, Radius);
+        if (!Renderer_SphereInFrustum(Frustum, Center, Radius)) {
+            continue;
+        }
+        Visible = true;
+
+        glm::vec3 Min, Max;
+        Renderer_GetEntityBounds(Entity, Min, Max);
+        glm::mat4 Model = Renderer_GetModelMatrix(Entity);
+        for (unsigned int i = 0; i < 8; i++) {
+            glm::vec3 Corner = glm::vec3(i & 1 ? Max.x : Min.x,
+                                         i & 2 ? Max.y : Min.y,
+                                         i & 4 ? Max.z : Min.z);
+            glm::vec4 Clip = ViewProjection * Model * glm::vec4(Corner, 1.0f);
+            if (Clip.w <= 0.0f) {
+                // behind the camera, assume it covers the screen
+                ScreenMin = glm::vec2(-1.0f);
+                ScreenMax = glm::vec2(1.0f);
+                continue;
+            }
+            glm::vec2 NDC = glm::vec2(Clip) / Clip.w;
+            ScreenMin = glm::min(ScreenMin, NDC);
+            ScreenMax = glm::max(ScreenMax, NDC);
+        }
+    }
+
+    Renderer.PlanarWaterVisible = Visible;
+    if (!Visible) {
+        // whatever is in the targets is stale once the water comes back
+        Renderer.PlanarWaterValid = false;
+        return false;
+    }
+
+    bool Update = !Renderer.PlanarWaterValid ||
+                  --Renderer.FramesUntilPlanarWaterUpdate <= 0;
+    if (!Update) {
+        return false;
+    }
+    Renderer.FramesUntilPlanarWaterUpdate = Renderer.PlanarWaterInterval;
+    Renderer.PlanarWaterValid = true;
+
+    // The pixel count follows the covered area
+    ScreenMin = glm::clamp(ScreenMin, glm::vec2(-1.0f), glm::vec2(1.0f));
+    ScreenMax = glm::clamp(ScreenMax, glm::vec2(-1.0f), glm::vec2(1.0f));
+    glm::vec2 Extent = glm::max((ScreenMax - ScreenMin) * 0.5f, 0.0f);
+    float Coverage = Extent.x * Extent.y;
+    Renderer.PlanarWaterScale = std::clamp(
+        std::sqrt(Coverage), Renderer.PlanarWaterMinScale, 1.0f);
+
+    camera ReflectionCamera = Renderer_GetReflectionCamera(Context.Camera);
+    Renderer.RefractionViewProjection = ViewProjection;
+    Renderer.ReflectionViewProjection =
+        Projection * Camera_GetViewMatrix(ReflectionCamera);
+
+    Renderer.RefractionCull.ClipPlane = glm::vec4(0.0f, -1.0f, 0.0f, 0.01f);
+    Renderer.RefractionCull.ViewPosition = Context.Camera.Position;
+    Renderer.RefractionCull.MinAngularSize = Renderer.PlanarWaterMinObjectSize;
+    Renderer_ExtractFrustumPlanes(Renderer.RefractionViewProjection,
+                                  Renderer.RefractionCull.FrustumPlanes);
+
+    Renderer.ReflectionCull.ClipPlane = glm::vec4(0.0f, 1.0f, 0.0f, -0.01f);
+    Renderer.ReflectionCull.ViewPosition = ReflectionCamera.Position;
+    Renderer.ReflectionCull.MinAngularSize = Renderer.PlanarWaterMinObjectSize;
+    Renderer_ExtractFrustumPlanes(Renderer.ReflectionViewProjection,
+                                  Renderer.ReflectionCull.FrustumPlanes);
+
+    return true;
+}
+
+bool Renderer_UpdateDepthPrePass(renderer &Renderer, const scene &Scene) {
+    // Collect the last measurement once the GPU is done with it, we never
+    // wait on the queries
+    if (Renderer.DepthPrePassQueryScene) {
+        GLuint Available = 0;
+        glGetQueryObjectuiv(Renderer.DepthPrePassQueries[1],
+                            GL_QUERY_RESULT_AVAILABLE, &Available);
+        if (Available) {
+            GLuint PrePassSamples = 0;
+            GLuint LitSamples = 0;
+            glGetQueryObjectuiv(Renderer.DepthPrePassQueries[0],
+                                GL_QUERY_RESULT, &PrePassSamples);
+            glGetQueryObjectuiv(Renderer.DepthPrePassQueries[1],
+                                GL_QUERY_RESULT, &LitSamples);
+
+            depth_prepass_state &Measured =
+                Renderer.DepthPrePassStates[Renderer.DepthPrePassQueryScene];
+            Measured.Overdraw =
+                LitSamples > 0 ? (float)PrePassSamples / (float)LitSamples
+                               : 1.0f;
+            Measured.Active =
+                Measured.Overdraw > Renderer.DepthPrePassOverdrawThreshold;
+            Renderer.DepthPrePassQueryScene = nullptr;
+        }
+    }
+
+    switch (Scene.DepthPrePassMode) {
+    case depth_prepass_mode::Off:
+        return false;
+    case depth_prepass_mode::On:
+        return true;
+    case depth_prepass_mode::Auto:
+        break;
+    }
+
+    auto [Iter, Inserted] =
+        Renderer.DepthPrePassStates.emplace(&Scene, depth_prepass_state{});
+    depth_prepass_state &State = Iter->second;
+    if (Inserted) {
+        // measure on the first frame of a scene
+        State.Overdraw = 1.0f;
+        State.FramesUntilProbe = 0;
+    }
+
+    // While inactive we still run a pre-pass every so often to find out if
+    // the overdraw changed (camera moved, entities added...)
+    bool Probe = --State.FramesUntilProbe <= 0;
+    if (Probe) {
+        State.FramesUntilProbe = Renderer.DepthPrePassProbeInterval;
+    }
+
+    return State.Active || Probe;
+}
+
+void Renderer_DepthPrePass(const renderer &Renderer, const scene &Scene) {
+    // Depth only: no color and no stencil writes, the stencil outline is
+    // marked by the lit pass
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilMask(0x00);
+    glDepthFunc(GL_LESS);
+
+    const shader *DepthPrePassShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::DepthPrePass);
+    Renderer_DrawSceneDepth(Renderer, *DepthPrePassShader, Scene,
+                            draw_filter::DepthPrePass);
+
+    glStencilMask(0xFF);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+static void Renderer_CopyOpaqueScene(const renderer &Renderer, GLuint Color,
+                                     GLuint Depth) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, Renderer.WaterCopyFBO);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                           GL_TEXTURE_2D, Color, 0);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                           GL_TEXTURE_2D, Depth, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, Renderer.SceneFramebuffer);
+    // depth can only be blitted between matching formats, the copy uses the
+    // scene depth format
+    glBlitFramebuffer(0, 0, Renderer.SceneWidth, Renderer.SceneHeight, 0, 0,
+                      Renderer.SceneWidth, Renderer.SceneHeight,
+                      GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer.SceneFramebuffer);
+}
+
+void Renderer_MainScenePass(renderer &Renderer, const scene &Scene,
                             const context &Context) {
-    Renderer_BindFramebuffer(Renderer, Renderer.FrameBuffer,
-                             Context.FramebufferWidth,
-                             Context.FramebufferHeight);
+    Renderer_BindFramebuffer(Renderer, Renderer.SceneFramebuffer,
+                             Renderer.SceneWidth, Renderer.SceneHeight);
 
     // enable depth testing (is disabled for
     // rendering screen-space quad)
@@ -611,15 +1328,14 @@ void Renderer_MainScenePass(const renderer &Renderer, const scene &Scene,
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Lit);
     const shader *UnlitShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Unlit);
-    const shader *InstanceShader = ResourceManager_GetShader(
-        Renderer.ResourceManager, shader_type::Instance);
 
     glDisable(GL_CLIP_DISTANCE0);
     // INFO: Hack when disabling the clip_distance doesn't work
     glm::vec4 NoClipPlane = glm::vec4(0.0f, 1.0f, 0.0f, 10000.0f);
-    Shader_SetVec4(*LitShader, "u_clip_plane", NoClipPlane);
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Shader_SetVec4(Shader, "u_clip_plane", NoClipPlane);
+    });
     Shader_SetVec4(*UnlitShader, "u_clip_plane", NoClipPlane);
-    Shader_SetVec4(*InstanceShader, "u_clip_plane", NoClipPlane);
     Shader_SetVec4(*WaterShader, "u_clip_plane", NoClipPlane);
 
     Shader_Use(*LitShader);
@@ -628,118 +1344,351 @@ void Renderer_MainScenePass(const renderer &Renderer, const scene &Scene,
     Renderer_SetCameraUniforms(Renderer, Context.Camera, Context.ScreenWidth,
                                Context.ScreenHeight);
 
-    Renderer_SetSceneLightsUniforms(Renderer, *LitShader, Scene,
-                                    Context.Camera);
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Renderer_SetSceneLightsUniforms(Renderer, Shader, Scene,
+                                        Context.Camera);
+    });
 
     Renderer_SetOtherUniforms(Renderer, Context);
 
+    // Shadow maps, the lit shaders sample them from units 3 to 5
+    float FarPlane = 25.0f;
+    glm::mat4 LightSpaceMatrix = Renderer_GetLightSpaceMatrix();
+
     // Directional Shadow Map
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, Renderer.DepthMapBuffer);
-    Shader_SetInt(*LitShader, "u_shadow_map", 3);
 
     // Point Shadow Cubemap
-    // Set view & projection for depth shader from the light's perspective
-    float NearPlane = 0.1f, FarPlane = 25.0f;
-    glm::mat4 LightProjection =
-        glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, NearPlane, FarPlane);
-    glm::vec3 LightDir = glm::normalize(glm::vec3(1.0f, -1.0f, 0.3f));
-    glm::vec3 LightPos = -LightDir * 10.0f;
-    glm::mat4 LightView = glm::lookAt(LightPos, glm::vec3(0.0f, 0.0f, 0.0f),
-                                      glm::vec3(0.0f, 1.0f, 0.0f));
-
-    glm::mat4 LightSpaceMatrix = LightProjection * LightView;
-
     glActiveTexture(GL_TEXTURE4);
     glBindTexture(GL_TEXTURE_CUBE_MAP, Renderer.DepthCubemapBuffer);
-    Shader_SetInt(*LitShader, "u_shadow_cubemap", 4);
 
-    Shader_SetMat4(*LitShader, "u_light_space_matrix", LightSpaceMatrix);
-    Shader_SetFloat(*LitShader, "u_far_plane", FarPlane);
+    // Point Shadow Dual Paraboloid
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, Renderer.DepthParaboloidBuffer);
 
-    Renderer_DrawScene(Renderer, *LitShader, Scene);
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Shader_SetMat4(Shader, "u_light_space_matrix", LightSpaceMatrix);
+        Shader_SetFloat(Shader, "u_far_plane", FarPlane);
+    });
+
+    bool UseDepthPrePass = Renderer_UpdateDepthPrePass(Renderer, Scene);
+    if (UseDepthPrePass) {
+        // Only measure in Auto mode and when no older result is in flight
+        bool Measure = Scene.DepthPrePassMode == depth_prepass_mode::Auto &&
+                       !Renderer.DepthPrePassQueryScene;
+
+        if (Measure) {
+            glBeginQuery(GL_SAMPLES_PASSED, Renderer.DepthPrePassQueries[0]);
+        }
+        Renderer_DepthPrePass(Renderer, Scene);
+        if (Measure) {
+            glEndQuery(GL_SAMPLES_PASSED);
+        }
+
+        // Opaque geometry is shaded once per pixel against the pre-pass depth
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+        if (Measure) {
+            glBeginQuery(GL_SAMPLES_PASSED, Renderer.DepthPrePassQueries[1]);
+        }
+        Renderer_DrawScene(Renderer, *LitShader, Scene, true,
+                           draw_filter::DepthPrePass);
+        if (Measure) {
+            glEndQuery(GL_SAMPLES_PASSED);
+            Renderer.DepthPrePassQueryScene = &Scene;
+        }
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+
+        // Everything that didn't go through the pre-pass
+        Renderer_DrawScene(Renderer, *LitShader, Scene, true,
+                           draw_filter::NoDepthPrePass);
+    } else {
+        Renderer_DrawScene(Renderer, *LitShader, Scene, true,
+                           draw_filter::Opaque);
+    }
+
+    // TODO: Keeping the instances out of the shadow pass for now.
+    if (Scene.Instances.size() > 0) {
+        // the shadow maps are still bound from above
+        model *Model = Scene.Instances[0].Model;
+        const shader *InstanceShader = ResourceManager_FindLitShader(
+            Renderer.ResourceManager, Renderer_GetInstanceFeatures(Scene));
+        Model_DrawInstances(*Model, *InstanceShader, Scene.Instances.size());
+    }
 
     // TODO: Refactor the Water Renderer
+    // Water goes after all the opaque geometry, the screen space mode
+    // refracts and reflects a copy of it
     Shader_Use(*WaterShader);
+    GLuint RefractionColor = Renderer.RefractionColorBuffer;
+    GLuint RefractionDepth = Renderer.RefractionDepthBuffer;
+    bool ScreenSpaceWater = Scene.WaterMode == water_mode::ScreenSpace;
+    if (ScreenSpaceWater) {
+        // only allocated by the graph when the scene has water
+        RefractionColor = RenderGraph_GetTexture(
+            Renderer.Graph, render_resource::WaterColorCopy);
+        RefractionDepth = RenderGraph_GetTexture(
+            Renderer.Graph, render_resource::WaterDepthCopy);
+        if (RefractionColor && RefractionDepth) {
+            Renderer_CopyOpaqueScene(Renderer, RefractionColor,
+                                     RefractionDepth);
+        }
+
+        const std::vector<texture *> &SkyboxTextures =
+            Scene.Skybox.Mesh.Material.Textures;
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_CUBE_MAP,
+                      SkyboxTextures.empty() ? 0 : SkyboxTextures[0]->ID);
+    }
+    Shader_SetInt(*WaterShader, "u_screen_space", ScreenSpaceWater ? 1 : 0);
+    if (ScreenSpaceWater) {
+        Shader_SetVec2(*WaterShader, "u_uv_scale", Renderer.SceneUVScale);
+    } else {
+        // The planar targets may be a few frames old, the shader projects
+        // with the cameras they were rendered from
+        Shader_SetVec2(*WaterShader, "u_uv_scale",
+                       glm::vec2(Renderer.PlanarWaterScale));
+        Shader_SetMat4(*WaterShader, "u_refraction_view_projection",
+                       Renderer.RefractionViewProjection);
+        Shader_SetMat4(*WaterShader, "u_reflection_view_projection",
+                       Renderer.ReflectionViewProjection);
+    }
+
     glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, Renderer.RefractionColorBuffer);
+    glBindTexture(GL_TEXTURE_2D, RefractionColor);
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, Renderer.ReflectionColorBuffer);
     glActiveTexture(GL_TEXTURE4);
-    glBindTexture(GL_TEXTURE_2D, Renderer.RefractionDepthBuffer);
+    glBindTexture(GL_TEXTURE_2D, RefractionDepth);
 
-    NearPlane = 0.1f;
-    FarPlane = 1000.0f;
-    Shader_SetFloat(*WaterShader, "u_near_plane", NearPlane);
-    Shader_SetFloat(*WaterShader, "u_far_plane", FarPlane);
     Renderer_SetSceneLightsUniforms(Renderer, *WaterShader, Scene,
                                     Context.Camera);
     glUseProgram(LitShader->ID);
     Renderer_DrawSceneWater(Renderer, Scene);
 
-    // TODO: Keeping the instances out of the shadow pass for now.
-    if (Scene.Instances.size() > 0) {
-        glUseProgram(InstanceShader->ID);
+    // Skybox
+    Renderer_DrawSkybox(Renderer, Scene.Skybox);
+}
 
-        Renderer_SetSceneLightsUniforms(Renderer, *InstanceShader, Scene,
-                                        Context.Camera);
+static void Renderer_BindShadowMaps(const renderer &Renderer,
+                                    const shader &Shader) {
+    // The water pass rebinds units 3 and 4, so bind them again here
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, Renderer.DepthMapBuffer);
+    Shader_SetInt(Shader, "u_shadow_map", 3);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, Renderer.DepthCubemapBuffer);
+    Shader_SetInt(Shader, "u_shadow_cubemap", 4);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, Renderer.DepthParaboloidBuffer);
+    glActiveTexture(GL_TEXTURE0);
 
-        // Directional Shadow Map
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, Renderer.DepthMapBuffer);
-        Shader_SetInt(*InstanceShader, "u_shadow_map", 3);
+    Shader_SetMat4(Shader, "u_light_space_matrix",
+                   Renderer_GetLightSpaceMatrix());
+    Shader_SetFloat(Shader, "u_far_plane", 25.0f);
+}
 
-        // Point Shadow Cubemap
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, Renderer.DepthCubemapBuffer);
-        Shader_SetInt(*InstanceShader, "u_shadow_cubemap", 4);
-        Shader_SetMat4(*InstanceShader, "u_light_space_matrix",
-                       LightSpaceMatrix);
-        Shader_SetFloat(*InstanceShader, "u_far_plane", FarPlane);
+void Renderer_TransparentPass(const renderer &Renderer, const scene &Scene,
+                              const context &Context) {
+    std::vector<const entity *> Transparent;
+    for (const entity &Entity : Scene.Entities) {
+        if (Renderer_IsTransparentEntity(Entity)) {
+            Transparent.push_back(&Entity);
+        }
+    }
 
-        model *Model = Scene.Instances[0].Model;
-        Model_DrawInstances(*Model, *InstanceShader, Scene.Instances.size());
+    if (Transparent.empty()) {
+        return;
     }
 
-    // Skybox
-    Renderer_DrawSkybox(Renderer, Scene.Skybox);
+    // The OIT targets share the depth of the HDR framebuffer, so drawing
+    // straight into the backbuffer falls back to sorting
+    if (Scene.TransparencyMode == transparency_mode::Sorted ||
+        Renderer.SceneFramebuffer != Renderer.FrameBuffer) {
+        // Back to front from where the camera is this frame
+        glm::vec3 CameraPosition = Context.Camera.Position;
+        std::sort(Transparent.begin(), Transparent.end(),
+                  [&CameraPosition](const entity *A, const entity *B) {
+                      glm::vec3 ToA = A->Position - CameraPosition;
+                      glm::vec3 ToB = B->Position - CameraPosition;
+                      return glm::dot(ToA, ToA) > glm::dot(ToB, ToB);
+                  });
+
+        const shader *LitShader = ResourceManager_GetShader(
+            Renderer.ResourceManager, shader_type::Lit);
+        Renderer_BindShadowMaps(Renderer, *LitShader);
+        Shader_SetInt(*LitShader, "u_transparency", 1);
+        for (const entity *Entity : Transparent) {
+            Renderer_DrawQuadEntity(Renderer, *LitShader, *Entity);
+        }
+        Shader_SetInt(*LitShader, "u_transparency", 0);
+        return;
+    }
+
+    // ### Weighted Blended OIT ###
+    // Group the unsorted quads by mesh so every shared mesh is one instanced
+    // draw
+    std::map<GLuint, std::vector<const entity *>> Batches;
+    for (const entity *Entity : Transparent) {
+        Batches[Entity->Mesh.VAO].push_back(Entity);
+    }
+
+    std::vector<glm::mat4> InstanceMatrices;
+    InstanceMatrices.reserve(Transparent.size());
+    for (const auto &[VAO, Entities] : Batches) {
+        for (const entity *Entity : Entities) {
+            InstanceMatrices.push_back(Renderer_GetModelMatrix(*Entity));
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, Renderer.TransparentInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, InstanceMatrices.size() * sizeof(glm::mat4),
+                 InstanceMatrices.data(), GL_STREAM_DRAW);
+
+    GLuint AccumBuffer =
+        RenderGraph_GetTexture(Renderer.Graph, render_resource::OITAccum);
+    GLuint WeightBuffer =
+        RenderGraph_GetTexture(Renderer.Graph, render_resource::OITWeight);
+
+    Renderer_BindFramebuffer(Renderer, Renderer.OITFBO, Renderer.SceneWidth,
+                             Renderer.SceneHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           AccumBuffer, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                           WeightBuffer, 0);
+    GLfloat AccumClear[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    GLfloat WeightClear[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearBufferfv(GL_COLOR, 0, AccumClear);
+    glClearBufferfv(GL_COLOR, 1, WeightClear);
+
+    // GL 3.3 has no per attachment blending: rgb adds up on both targets
+    // while alpha multiplies the revealage in the accumulation target
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glStencilMask(0x00);
+    glDisable(GL_CULL_FACE);
+
+    const shader *InstanceShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::Instance);
+    Renderer_SetSceneLightsUniforms(Renderer, *InstanceShader, Scene,
+                                    Context.Camera);
+    Renderer_BindShadowMaps(Renderer, *InstanceShader);
+    Shader_SetInt(*InstanceShader, "u_transparency", 2);
+
+    size_t FirstInstance = 0;
+    for (const auto &[VAO, Entities] : Batches) {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, Renderer.TransparentInstanceVBO);
+        for (unsigned int i = 0; i < 4; ++i) {
+            glEnableVertexAttribArray(3 + i);
+            glVertexAttribPointer(
+                3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                (void *)(FirstInstance * sizeof(glm::mat4) +
+                         i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(3 + i, 1);
+        }
+
+        Mesh_DrawInstance(Entities[0]->Mesh, *InstanceShader,
+                          Entities.size());
+        FirstInstance += Entities.size();
+    }
+
+    Shader_SetInt(*InstanceShader, "u_transparency", 0);
+    glEnable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Composite the resolved transparent color over the opaque HDR scene
+    Renderer_BindFramebuffer(Renderer, Renderer.SceneFramebuffer,
+                             Renderer.SceneWidth, Renderer.SceneHeight);
+    glDisable(GL_DEPTH_TEST);
+
+    const shader *CompositeShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::OITComposite);
+    Shader_SetVec2(*CompositeShader, "u_uv_scale", Renderer.SceneUVScale);
+    glBindVertexArray(Renderer.FrameBufferVAO);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, AccumBuffer);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, WeightBuffer);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(0);
+    glStencilMask(0xFF);
+    glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer_BloomPass(renderer &Renderer, const scene &Scene,
                         const context &Context) {
-    bool Horizontal = true, FirstIteration = true;
-    unsigned int Amount = 10;
-    const shader *BlurShader =
-        ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Blur);
-    glUseProgram(BlurShader->ID);
+    const shader *DownsampleShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::BloomDownsample);
+    const shader *UpsampleShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::BloomUpsample);
+
+    GLuint MipTextures[BLOOM_MIP_COUNT];
+    for (unsigned int i = 0; i < BLOOM_MIP_COUNT; i++) {
+        MipTextures[i] =
+            RenderGraph_GetTexture(Renderer.Graph, RenderGraph_BloomMip(i));
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, Renderer.BloomFBO);
     glBindVertexArray(Renderer.FrameBufferVAO);
     glActiveTexture(GL_TEXTURE0);
-    for (unsigned int i = 0; i < Amount; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, Renderer.PingPongFBO[Horizontal]);
-        Shader_SetInt(*BlurShader, "u_horizontal", Horizontal);
-        // bind texture of other framebuffer (or scene if first iteration)
-        glBindTexture(GL_TEXTURE_2D,
-                      FirstIteration
-                          ? Renderer.BrightColorBuffer
-                          : Renderer.PingPongColorBuffers[!Horizontal]);
+    glDisable(GL_DEPTH_TEST);
 
+    // Downsample: scene color -> bright colors in mip 0 -> mip 1 -> ...
+    glDisable(GL_BLEND);
+    glUseProgram(DownsampleShader->ID);
+    Shader_SetInt(*DownsampleShader, "u_prefilter", 1);
+    Shader_SetFloat(*DownsampleShader, "u_threshold", Renderer.BloomThreshold);
+    Shader_SetVec2(*DownsampleShader, "u_uv_scale", Renderer.SceneUVScale);
+    glBindTexture(GL_TEXTURE_2D, Renderer.TextureColorBuffer);
+    for (unsigned int i = 0; i < BLOOM_MIP_COUNT; i++) {
+        const render_texture_desc &Mip =
+            RenderGraph_GetDesc(Renderer.Graph, RenderGraph_BloomMip(i));
+        glViewport(0, 0, Mip.Width, Mip.Height);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, MipTextures[i], 0);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        Horizontal = !Horizontal;
-        if (FirstIteration) {
-            FirstIteration = false;
+
+        if (i == 0) {
+            Shader_SetInt(*DownsampleShader, "u_prefilter", 0);
+            Shader_SetVec2(*DownsampleShader, "u_uv_scale", glm::vec2(1.0f));
         }
+        glBindTexture(GL_TEXTURE_2D, MipTextures[i]);
+    }
+
+    // Upsample: add every mip on top of the next bigger one, back to mip 0
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glUseProgram(UpsampleShader->ID);
+    Shader_SetFloat(*UpsampleShader, "u_filter_radius",
+                    Renderer.BloomFilterRadius);
+    for (unsigned int i = BLOOM_MIP_COUNT - 1; i > 0; i--) {
+        const render_texture_desc &Mip =
+            RenderGraph_GetDesc(Renderer.Graph, RenderGraph_BloomMip(i - 1));
+        glBindTexture(GL_TEXTURE_2D, MipTextures[i]);
+        glViewport(0, 0, Mip.Width, Mip.Height);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, MipTextures[i - 1], 0);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
     }
 
-    Renderer.CurrentPingPongBuffer = Horizontal;
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_DEPTH_TEST);
+    glBindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 void Renderer_GuiPass(const renderer &Renderer, const scene &Scene,
                       const context &Context) {
-    Renderer_BindFramebuffer(Renderer, Renderer.FrameBuffer,
-                             Context.FramebufferWidth,
+    // Draw all GuiTextures on top of the presented frame, always at the
+    // native resolution
+    Renderer_BindFramebuffer(Renderer, 0, Context.FramebufferWidth,
                              Context.FramebufferHeight);
-    // Draw all GuiTextures into the scene framebuffer before it is
-    // presented.
     const shader *GuiShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Gui);
     glUseProgram(GuiShader->ID);
@@ -751,7 +1700,7 @@ void Renderer_GuiPass(const renderer &Renderer, const scene &Scene,
     }
 }
 
-void Renderer_PresentPass(const renderer &Renderer, const scene &Scene,
+void Renderer_PresentPass(renderer &Renderer, const postprocess_chain &Chain,
                           const context &Context) {
     // Draw whatever is in the Framebuffer to the screen quad
     // now bind back to default framebuffer and draw a quad plane with the
@@ -767,37 +1716,301 @@ void Renderer_PresentPass(const renderer &Renderer, const scene &Scene,
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    const shader *ScreenShader = ResourceManager_GetShader(
-        Renderer.ResourceManager, shader_type::Screen);
+    // One fused pass with only the effects of this chain compiled in
+    const shader *ScreenShader = ResourceManager_GetPostProcessShader(
+        Renderer.ResourceManager, Chain.Effects);
     glUseProgram(ScreenShader->ID);
     glBindVertexArray(Renderer.FrameBufferVAO);
 
-    Shader_SetInt(*ScreenShader, "u_effect", Scene.Effect);
-    Shader_SetInt(*ScreenShader, "u_hdr_enabled", Scene.HDREnabled ? 1 : 0);
-    Shader_SetFloat(*ScreenShader, "u_exposure", Scene.HDRExposure);
-    Shader_SetInt(*ScreenShader, "u_bloom_enabled", Scene.BloomEnabled ? 1 : 0);
+    if (Chain.Effects & POSTPROCESS_TONEMAP) {
+        Shader_SetFloat(*ScreenShader, "u_exposure", Chain.Exposure);
+    }
+    if (Chain.Effects & POSTPROCESS_GRADING) {
+        Shader_SetFloat(*ScreenShader, "u_contrast", Chain.Contrast);
+        Shader_SetFloat(*ScreenShader, "u_saturation", Chain.Saturation);
+    }
+    if (Chain.Effects & POSTPROCESS_UPSCALE) {
+        Shader_SetVec2(*ScreenShader, "u_uv_scale", Chain.UVScale);
+        Shader_SetFloat(*ScreenShader, "u_sharpness", Chain.Sharpness);
+    }
 
     // use the color attachment texture as
     // the texture of the quad plane
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, Renderer.TextureColorBuffer);
+    // 0 when bloom is off and the graph didn't allocate the mips
     glActiveTexture(GL_TEXTURE1);
-    glBindTexture(
-        GL_TEXTURE_2D,
-        Renderer.PingPongColorBuffers[!Renderer.CurrentPingPongBuffer]);
+    glBindTexture(GL_TEXTURE_2D,
+                  RenderGraph_GetTexture(Renderer.Graph,
+                                         render_resource::BloomMip0));
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
+void Renderer_UpdateDynamicResolution(renderer &Renderer) {
+    // Collect the finished measurements, never waiting on the GPU
+    for (unsigned int i = 0; i < GPU_TIMER_QUERY_COUNT; i++) {
+        if (!Renderer.GPUTimerPending[i]) {
+            continue;
+        }
+
+        GLuint Available = 0;
+        glGetQueryObjectuiv(Renderer.GPUTimerQueries[i],
+                            GL_QUERY_RESULT_AVAILABLE, &Available);
+        if (!Available) {
+            continue;
+        }
+
+        GLuint64 Elapsed = 0;
+        glGetQueryObjectui64v(Renderer.GPUTimerQueries[i], GL_QUERY_RESULT,
+                              &Elapsed);
+        Renderer.GPUTimerPending[i] = false;
+        Renderer.GPUFrameTimeSum += (float)Elapsed / 1000000.0f;
+        Renderer.GPUFrameTimeSamples++;
+    }
+
+    if (--Renderer.FramesUntilScaleUpdate > 0 ||
+        Renderer.GPUFrameTimeSamples == 0) {
+        return;
+    }
+    Renderer.FramesUntilScaleUpdate = Renderer.DynamicResolutionInterval;
+    Renderer.GPUFrameTime =
+        Renderer.GPUFrameTimeSum / (float)Renderer.GPUFrameTimeSamples;
+    Renderer.GPUFrameTimeSum = 0.0f;
+    Renderer.GPUFrameTimeSamples = 0;
+
+    if (!Renderer.DynamicResolutionEnabled) {
+        return;
+    }
+
+    // The fill heavy passes cost about the pixel count, so the square of
+    // the render scale
+    float Ratio = Renderer.TargetFrameTime / Renderer.GPUFrameTime;
+    // dead zone so the scale doesn't oscillate around the target
+    if (Ratio > 0.95f && Ratio < 1.05f) {
+        return;
+    }
+
+    // drop quickly when over budget, climb back slowly
+    float Scale = Renderer.RenderScale * std::sqrt(Ratio);
+    Scale = std::clamp(Scale, Renderer.RenderScale - 0.1f,
+                       Renderer.RenderScale + 0.05f);
+    Renderer.RenderScale = std::clamp(Scale, Renderer.MinRenderScale, 1.0f);
+}
+
 void Renderer_Draw(renderer &Renderer, const scene &Scene,
                    const context &Context) {
-    Renderer_DirectionalShadowPass(Renderer, Scene, Context);
-    Renderer_PointShadowPass(Renderer, Scene, Context);
-    Renderer_WaterRefractionPass(Renderer, Scene, Context);
-    Renderer_WaterReflectionPass(Renderer, Scene, Context);
-    Renderer_MainScenePass(Renderer, Scene, Context);
-    Renderer_BloomPass(Renderer, Scene, Context);
-    Renderer_GuiPass(Renderer, Scene, Context);
-    Renderer_PresentPass(Renderer, Scene, Context);
+    Renderer_UpdateDynamicResolution(Renderer);
+
+    // A slot whose result hasn't come back yet is left alone, that frame
+    // just isn't measured
+    unsigned int TimerIndex = Renderer.GPUTimerFrame % GPU_TIMER_QUERY_COUNT;
+    bool MeasureFrame = !Renderer.GPUTimerPending[TimerIndex];
+    if (MeasureFrame) {
+        glBeginQuery(GL_TIME_ELAPSED, Renderer.GPUTimerQueries[TimerIndex]);
+    }
+
+    postprocess_chain Chain = PostProcess_BuildChain(Scene);
+
+    Renderer.SceneWidth = std::max(
+        (int)(Context.FramebufferWidth * Renderer.RenderScale), 1);
+    Renderer.SceneHeight = std::max(
+        (int)(Context.FramebufferHeight * Renderer.RenderScale), 1);
+    Renderer.SceneUVScale =
+        glm::vec2((float)Renderer.SceneWidth / Context.FramebufferWidth,
+                  (float)Renderer.SceneHeight / Context.FramebufferHeight);
+    if (Renderer.SceneWidth < Context.FramebufferWidth ||
+        Renderer.SceneHeight < Context.FramebufferHeight) {
+        Chain.Effects |= POSTPROCESS_UPSCALE;
+        Chain.UVScale = Renderer.SceneUVScale;
+        Chain.Sharpness = Renderer.Sharpness;
+    }
+
+    glm::mat4 CameraViewProjection =
+        Renderer_GetProjectionMatrix(Context.Camera, Context.ScreenWidth,
+                                     Context.ScreenHeight) *
+        Camera_GetViewMatrix(Context.Camera);
+    Renderer_ExtractFrustumPlanes(CameraViewProjection,
+                                  Renderer.CameraView.FrustumPlanes);
+    Renderer.CameraView.ViewPosition = Context.Camera.Position;
+
+    bool HasWater = false;
+    for (const entity &Entity : Scene.Entities) {
+        if (Entity.Mesh.Material.ShaderMaterial == shader_material::Water) {
+            HasWater = true;
+            break;
+        }
+    }
+    bool ScreenSpaceWater =
+        HasWater && Scene.WaterMode == water_mode::ScreenSpace;
+    Renderer_PrepareLitShaders(Renderer, Scene, HasWater && !ScreenSpaceWater);
+    // Planar water only re-renders its targets when it is on screen and due
+    bool UpdatePlanarWater = false;
+    if (HasWater && !ScreenSpaceWater) {
+        UpdatePlanarWater =
+            Renderer_UpdatePlanarWater(Renderer, Scene, Context);
+    } else {
+        Renderer.PlanarWaterVisible = false;
+        Renderer.PlanarWaterValid = false;
+    }
+
+    // With nothing to post-process the scene goes straight into the sRGB
+    // backbuffer and the present pass is skipped. Screen space water needs
+    // to copy the scene depth, which the backbuffer can't guarantee.
+    bool DrawToBackbuffer = Chain.Effects == 0 && Renderer.BackbufferSRGB &&
+                            !ScreenSpaceWater;
+    Renderer.SceneFramebuffer = DrawToBackbuffer ? 0 : Renderer.FrameBuffer;
+    render_resource SceneTarget = DrawToBackbuffer
+                                      ? render_resource::Backbuffer
+                                      : render_resource::SceneColor;
+
+    // What the lit passes actually sample this frame. The shaders skip the
+    // shadow maps of lights that don't cast shadows, so their passes have
+    // no reader and get culled.
+    bool HasDirectionalShadow = false;
+    bool HasPointShadow = false;
+    for (const light &Light : Scene.Lights) {
+        if (!Light.IsEnabled || !Light.CastsShadow) {
+            continue;
+        }
+        HasDirectionalShadow |= Light.LightType == light_type::Directional;
+        HasPointShadow |= Light.LightType == light_type::Point;
+    }
+
+    std::vector<render_resource> LitInputs;
+    if (HasDirectionalShadow) {
+        LitInputs.push_back(render_resource::ShadowMap);
+    }
+    if (HasPointShadow) {
+        LitInputs.push_back(render_resource::PointShadowMap);
+    }
+    std::vector<render_resource> SceneInputs = LitInputs;
+    std::vector<render_resource> SceneOutputs = {SceneTarget};
+    if (ScreenSpaceWater) {
+        SceneOutputs.push_back(render_resource::WaterColorCopy);
+        SceneOutputs.push_back(render_resource::WaterDepthCopy);
+    } else if (HasWater && Renderer.PlanarWaterVisible) {
+        SceneInputs.push_back(render_resource::Refraction);
+        SceneInputs.push_back(render_resource::Reflection);
+    }
+
+    // ### Render Graph ###
+    render_graph &Graph = Renderer.Graph;
+    RenderGraph_Begin(Graph);
+
+    RenderGraph_CreateTransient(
+        Graph, render_resource::OITAccum,
+        {Renderer.Formats.OITAccum, Context.FramebufferWidth,
+         Context.FramebufferHeight});
+    RenderGraph_CreateTransient(
+        Graph, render_resource::OITWeight,
+        {Renderer.Formats.OITWeight, Context.FramebufferWidth,
+         Context.FramebufferHeight});
+    // RGBA16F holds the scene color exactly and lets the copy share its
+    // texture with the OIT accumulation, the two never live at once
+    RenderGraph_CreateTransient(
+        Graph, render_resource::WaterColorCopy,
+        {Renderer.Formats.OITAccum, Context.FramebufferWidth,
+         Context.FramebufferHeight});
+    RenderGraph_CreateTransient(
+        Graph, render_resource::WaterDepthCopy,
+        {Renderer.Formats.SceneDepth, Context.FramebufferWidth,
+         Context.FramebufferHeight});
+    int MipWidth = Context.FramebufferWidth;
+    int MipHeight = Context.FramebufferHeight;
+    std::vector<render_resource> BloomMips;
+    for (unsigned int i = 0; i < BLOOM_MIP_COUNT; i++) {
+        MipWidth = std::max(MipWidth / 2, 1);
+        MipHeight = std::max(MipHeight / 2, 1);
+        RenderGraph_CreateTransient(Graph, RenderGraph_BloomMip(i),
+                                    {Renderer.Formats.Bloom, MipWidth,
+                                     MipHeight});
+        BloomMips.push_back(RenderGraph_BloomMip(i));
+    }
+
+    RenderGraph_AddPass(Graph, "Directional Shadow", {},
+                        {render_resource::ShadowMap}, [&]() {
+                            Renderer_DirectionalShadowPass(Renderer, Scene,
+                                                           Context);
+                        });
+    RenderGraph_AddPass(Graph, "Point Shadow", {},
+                        {render_resource::PointShadowMap}, [&]() {
+                            Renderer_PointShadowPass(Renderer, Scene, Context);
+                        });
+    // Between updates the main pass reads what the last update left in the
+    // planar targets
+    if (UpdatePlanarWater) {
+        RenderGraph_AddPass(Graph, "Water Refraction", LitInputs,
+                            {render_resource::Refraction}, [&]() {
+                                Renderer_WaterRefractionPass(Renderer, Scene,
+                                                             Context);
+                            });
+        RenderGraph_AddPass(Graph, "Water Reflection", LitInputs,
+                            {render_resource::Reflection}, [&]() {
+                                Renderer_WaterReflectionPass(Renderer, Scene,
+                                                             Context);
+                            });
+    }
+    RenderGraph_AddPass(Graph, "Main Scene", SceneInputs, SceneOutputs,
+                        [&]() {
+                            if (DrawToBackbuffer) {
+                                glEnable(GL_FRAMEBUFFER_SRGB);
+                            }
+                            Renderer_MainScenePass(Renderer, Scene, Context);
+                        });
+
+    // Transparent quads go last so they blend over the skybox too. The OIT
+    // targets only live inside this pass.
+    std::vector<render_resource> TransparentOutputs = {SceneTarget};
+    bool HasTransparent =
+        std::any_of(Scene.Entities.begin(), Scene.Entities.end(),
+                    Renderer_IsTransparentEntity);
+    if (Scene.TransparencyMode == transparency_mode::WeightedBlended &&
+        HasTransparent && !DrawToBackbuffer) {
+        TransparentOutputs.push_back(render_resource::OITAccum);
+        TransparentOutputs.push_back(render_resource::OITWeight);
+    }
+    std::vector<render_resource> TransparentInputs = LitInputs;
+    TransparentInputs.push_back(SceneTarget);
+    RenderGraph_AddPass(Graph, "Transparent", TransparentInputs,
+                        TransparentOutputs, [&]() {
+                            Renderer_TransparentPass(Renderer, Scene, Context);
+                            if (DrawToBackbuffer) {
+                                // the gui drawn after this expects a linear
+                                // backbuffer
+                                glDisable(GL_FRAMEBUFFER_SRGB);
+                            }
+                        });
+
+    RenderGraph_AddPass(Graph, "Bloom", {render_resource::SceneColor},
+                        BloomMips, [&]() {
+                            Renderer_BloomPass(Renderer, Scene, Context);
+                        });
+
+    if (!DrawToBackbuffer) {
+        std::vector<render_resource> PresentInputs = {
+            render_resource::SceneColor};
+        if (Chain.Effects & POSTPROCESS_BLOOM) {
+            PresentInputs.push_back(render_resource::BloomMip0);
+        }
+        RenderGraph_AddPass(Graph, "Present", PresentInputs,
+                            {render_resource::Backbuffer}, [&]() {
+                                Renderer_PresentPass(Renderer, Chain, Context);
+                            });
+    }
+
+    RenderGraph_AddPass(Graph, "Gui", {render_resource::Backbuffer},
+                        {render_resource::Backbuffer}, [&]() {
+                            Renderer_GuiPass(Renderer, Scene, Context);
+                        });
+
+    RenderGraph_Compile(Graph);
+    RenderGraph_Execute(Graph);
+
+    if (MeasureFrame) {
+        glEndQuery(GL_TIME_ELAPSED);
+        Renderer.GPUTimerPending[TimerIndex] = true;
+    }
+    Renderer.GPUTimerFrame++;
 }
 
 void Renderer_DrawQuadEntity(const renderer &Renderer, const shader &Shader,
@@ -822,6 +2035,33 @@ void Renderer_DrawQuadEntity(const renderer &Renderer, const shader &Shader,
     glEnable(GL_CULL_FACE);
 }
 
+void Renderer_DrawLodGridEntity(const renderer &Renderer, const shader &Shader,
+                                const entity &Entity, const draw_cull &View) {
+    // The quadtree lives in the local space of the entity, bring the view
+    // there. Planes transform with the transpose of the model matrix.
+    glm::mat4 Model = Renderer_GetModelMatrix(Entity);
+    glm::vec3 LocalViewPosition =
+        glm::vec3(glm::inverse(Model) * glm::vec4(View.ViewPosition, 1.0f));
+    glm::mat4 PlaneTransform = glm::transpose(Model);
+    glm::vec4 LocalPlanes[6];
+    for (unsigned int i = 0; i < 6; i++) {
+        LocalPlanes[i] = PlaneTransform * View.FrustumPlanes[i];
+    }
+    LodGrid_Select(*Entity.Grid, LocalViewPosition, LocalPlanes);
+
+    if (!Entity.Mesh.Material.CullFace) {
+        glDisable(GL_CULL_FACE);
+    }
+    Shader_Use(Shader);
+
+    glm::vec4 Color = Entity.Mesh.Material.Color;
+    Shader_SetVec3(Shader, "u_entity_color", glm::vec3(Color));
+    Shader_SetMat4(Shader, "u_model", Model);
+
+    LodGrid_Draw(*Entity.Grid, Shader, Entity.Mesh.Material);
+    glEnable(GL_CULL_FACE);
+}
+
 void Renderer_DrawGuiEntity(const renderer &Renderer, const shader &Shader,
                             const entity &Entity) {
     glDisable(GL_CULL_FACE);
@@ -1022,6 +2262,14 @@ void Renderer_SetSceneLightsUniforms(const renderer &Renderer,
                      I);
             Shader_SetInt(Shader, Buffer, Scene.Lights[i].CastsShadow ? 1 : 0);
 
+            snprintf(Buffer, sizeof(Buffer),
+                     "u_point_lights[%d].paraboloid_shadow", I);
+            Shader_SetInt(Shader, Buffer,
+                          Scene.Lights[i].ShadowMode ==
+                                  point_shadow_mode::DualParaboloid
+                              ? 1
+                              : 0);
+
             float Constant = 0.0f;
             float Linear = 0.0f;
             float Quadratic = 1.0f;
@@ -1078,19 +2326,25 @@ void Renderer_SetOtherUniforms(const renderer &Renderer,
 }
 
 void Renderer_SetTextureUniforms(const renderer &Renderer) {
-    const shader *BlurShader =
-        ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Blur);
+    const shader *BloomDownsampleShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::BloomDownsample);
+    const shader *BloomUpsampleShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::BloomUpsample);
     const shader *WaterShader =
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Water);
-    const shader *ScreenShader = ResourceManager_GetShader(
-        Renderer.ResourceManager, shader_type::Screen);
 
-    Shader_SetInt(*BlurShader, "u_screen_texture", 0);
+    Shader_SetInt(*BloomDownsampleShader, "u_source", 0);
+    Shader_SetInt(*BloomUpsampleShader, "u_source", 0);
     Shader_SetInt(*WaterShader, "u_refraction_texture", 2);
     Shader_SetInt(*WaterShader, "u_reflection_texture", 3);
     Shader_SetInt(*WaterShader, "u_depth_map", 4);
-    Shader_SetInt(*ScreenShader, "u_screen_texture", 0);
-    Shader_SetInt(*ScreenShader, "u_bloom_texture", 1);
+    Shader_SetInt(*WaterShader, "u_skybox", 6);
+    Shader_SetInt(*WaterShader, "u_ocean_displacement", 8);
+
+    const shader *OITCompositeShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::OITComposite);
+    Shader_SetInt(*OITCompositeShader, "u_accumulation", 0);
+    Shader_SetInt(*OITCompositeShader, "u_weights", 1);
 }
 
 void Renderer_SetShaderCameraUniforms(const renderer &Renderer,
@@ -1105,11 +2359,9 @@ void Renderer_SetShaderCameraUniforms(const renderer &Renderer,
 void Renderer_SetCameraUniforms(const renderer &Renderer, const camera &Camera,
                                 float ScreenWidth, float ScreenHeight) {
     glm::mat4 View = Camera_GetViewMatrix(Camera);
-    glm::mat4 Projection = glm::perspective(
-        glm::radians(Camera.Zoom), ScreenWidth / ScreenHeight, 0.1f, 100.0f);
+    glm::mat4 Projection =
+        Renderer_GetProjectionMatrix(Camera, ScreenWidth, ScreenHeight);
 
-    const shader *LitShader =
-        ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Lit);
     const shader *OutlineShader = ResourceManager_GetShader(
         Renderer.ResourceManager, shader_type::Outline);
     const shader *QuadShader =
@@ -1120,17 +2372,19 @@ void Renderer_SetCameraUniforms(const renderer &Renderer, const camera &Camera,
         ResourceManager_GetShader(Renderer.ResourceManager, shader_type::Water);
     const shader *SkyboxShader = ResourceManager_GetShader(
         Renderer.ResourceManager, shader_type::Skybox);
-    const shader *InstanceShader = ResourceManager_GetShader(
-        Renderer.ResourceManager, shader_type::Instance);
-
-    Renderer_SetShaderCameraUniforms(Renderer, *LitShader, View,
+    const shader *DepthPrePassShader = ResourceManager_GetShader(
+        Renderer.ResourceManager, shader_type::DepthPrePass);
+
+    Renderer_ForEachLitShader(Renderer, [&](const shader &Shader) {
+        Renderer_SetShaderCameraUniforms(Renderer, Shader, View,
+                                         Camera.Position, Projection);
+    });
+    Renderer_SetShaderCameraUniforms(Renderer, *DepthPrePassShader, View,
                                      Camera.Position, Projection);
     Renderer_SetShaderCameraUniforms(Renderer, *OutlineShader, View,
                                      Camera.Position, Projection);
     Renderer_SetShaderCameraUniforms(Renderer, *QuadShader, View,
                                      Camera.Position, Projection);
-    Renderer_SetShaderCameraUniforms(Renderer, *InstanceShader, View,
-                                     Camera.Position, Projection);
     Renderer_SetShaderCameraUniforms(Renderer, *UnlitShader, View,
                                      Camera.Position, Projection);
     Renderer_SetShaderCameraUniforms(Renderer, *WaterShader, View,
@@ -3,6 +3,8 @@
 
 #include "camera.h"
 #include "context.h"
+#include "postprocess.h"
+#include "render_graph.h"
 #include "resource_manager.h"
 #include "scene.h"
 #include "shader.h"
@@ -12,21 +14,93 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <map>
+
+#define GPU_TIMER_QUERY_COUNT 3
+
+// A single draw of the depth-only path: no material, just geometry and a
+// transform. Sorted by VAO before submission.
+struct depth_draw_item {
+    GLuint VAO;
+    GLsizei IndicesNum;
+    glm::mat4 Model;
+    bool CullFace;
+};
+
+// Selects which entities a scene draw submits. The depth pre-pass only lays
+// down depth for opaque lit geometry; everything else is drawn normally.
+// Transparent entities are left out of Opaque and NoDepthPrePass, they are
+// drawn by Renderer_TransparentPass.
+enum class draw_filter { All, Opaque, DepthPrePass, NoDepthPrePass };
+
+// CPU culling of the scene draws of the planar water passes. Entities are
+// tested with their bounding sphere against the water clip plane and the
+// frustum of the pass camera, and dropped below a minimum angular size.
+struct draw_cull {
+    glm::vec4 ClipPlane;
+    glm::vec4 FrustumPlanes[6];
+    glm::vec3 ViewPosition;
+    float MinAngularSize; // radians
+};
+
+// CPU culling of shadow casters. Entities are tested with their world space
+// bounding box against the planes of the shadow view: the light's
+// orthographic box for the directional light, the FarPlane box around a
+// point light, which holds all six cube faces or both paraboloids.
+struct shadow_cull {
+    glm::vec4 Planes[6];
+};
+
+// Internal formats of the render targets, all set in Renderer_Create.
+// R11F_G11F_B10F is half the size of RGBA16F but has no alpha, which only
+// the OIT accumulation needs.
+struct render_target_formats {
+    GLenum SceneColor;
+    GLenum SceneDepth;
+    GLenum Bloom;
+    GLenum OITAccum;
+    GLenum OITWeight;
+    GLenum Water;
+};
+
+// Per-scene result of the overdraw measurement driving the Auto pre-pass
+struct depth_prepass_state {
+    bool Active;
+    float Overdraw;
+    int FramesUntilProbe;
+};
 
 struct renderer {
     resource_manager ResourceManager;
 
+    render_target_formats Formats;
+
     // Framebuffer stuff
     GLuint FrameBufferVAO, FrameBufferVBO;
     GLuint FrameBuffer;
     GLuint TextureColorBuffer;
-    GLuint BrightColorBuffer;
     GLuint RBO; // render buffer object
+    // Where the scene passes draw this frame: FrameBuffer, or the backbuffer
+    // (0) when there is nothing to post-process
+    GLuint SceneFramebuffer;
+    bool BackbufferSRGB;
+
+    // Main camera of the frame. Picks the lod_grid nodes of the passes that
+    // draw without a draw_cull of their own, nothing is culled with it.
+    draw_cull CameraView;
+
+    // Passes of the frame and the pool behind its transient targets (OIT
+    // targets, bloom mips), rebuilt every frame by Renderer_Draw
+    render_graph Graph;
 
-    // PingPong Framebuffers stuff (for bloom filter)
-    GLuint PingPongFBO[2];
-    GLuint PingPongColorBuffers[2];
-    bool CurrentPingPongBuffer;
+    // Bloom mip chain stuff
+    // Mip 0 is half the framebuffer resolution, every other mip halves the
+    // previous one. The first downsample extracts the colors brighter than
+    // BloomThreshold, the upsampled result ends up in mip 0. The mips are
+    // transients of the graph.
+    GLuint BloomFBO;
+    float BloomFilterRadius;
+    float BloomThreshold;
 
     // Depth Map stuff
     GLuint DepthMapFBO;
@@ -36,6 +110,57 @@ struct renderer {
     GLuint DepthCubemapFBO;
     GLuint DepthCubemapBuffer;
 
+    // Dual Paraboloid Depth Map stuff (2 layers, one per hemisphere)
+    GLuint DepthParaboloidFBO;
+    GLuint DepthParaboloidBuffer;
+
+    // Depth Pre-Pass stuff
+    // [0] counts samples passing the pre-pass (what the lit pass would shade
+    // without it), [1] counts samples shaded by the lit pass after it.
+    GLuint DepthPrePassQueries[2];
+    const scene *DepthPrePassQueryScene;
+    float DepthPrePassOverdrawThreshold;
+    int DepthPrePassProbeInterval;
+    std::map<const scene *, depth_prepass_state> DepthPrePassStates;
+
+    // Weighted Blended OIT stuff
+    // Accumulation holds the weighted premultiplied color in rgb and the
+    // revealage in alpha, Weights holds the sum of the weights. Both are
+    // transients of the graph, attached when the pass runs. Shares the
+    // depth/stencil RBO of the main framebuffer.
+    GLuint OITFBO;
+    // Per-frame model matrices of the instanced transparent draws
+    GLuint TransparentInstanceVBO;
+
+    // Dynamic Resolution stuff
+    // The scene passes render into the bottom left SceneWidth x SceneHeight
+    // part of the screen sized targets, the present pass upscales it. When
+    // enabled, RenderScale follows the measured GPU frame time.
+    bool DynamicResolutionEnabled;
+    float RenderScale;
+    float MinRenderScale;
+    float TargetFrameTime; // ms
+    float Sharpness;
+    int SceneWidth;
+    int SceneHeight;
+    glm::vec2 SceneUVScale;
+
+    // GPU frame time, measured over a ring of queries so we never wait on
+    // the GPU
+    GLuint GPUTimerQueries[GPU_TIMER_QUERY_COUNT];
+    bool GPUTimerPending[GPU_TIMER_QUERY_COUNT];
+    unsigned int GPUTimerFrame;
+    float GPUFrameTime; // ms, averaged over the last controller interval
+    float GPUFrameTimeSum;
+    int GPUFrameTimeSamples;
+    int DynamicResolutionInterval;
+    int FramesUntilScaleUpdate;
+
+    // Screen Space Water stuff
+    // Copies the opaque scene color and depth into graph transients right
+    // before the water is drawn
+    GLuint WaterCopyFBO;
+
     // Water Framebuffers stuff
     GLuint RefractionFBO;
     GLuint RefractionDepthBuffer;
@@ -50,11 +175,29 @@ struct renderer {
     GLuint ReflectionRBO;
     int ReflectionFBOWidth;
     int ReflectionFBOHeight;
+
+    // Planar Water stuff
+    // The planar passes only run while water is on screen and only every
+    // PlanarWaterInterval frames. They draw into the bottom left
+    // PlanarWaterScale part of their targets, scaled with the screen area of
+    // the water. The water shader reprojects with the matrices of the last
+    // update.
+    bool PlanarWaterVisible;
+    bool PlanarWaterValid;
+    int PlanarWaterInterval;
+    int FramesUntilPlanarWaterUpdate;
+    float PlanarWaterScale;
+    float PlanarWaterMinScale;
+    float PlanarWaterMinObjectSize; // radians
+    glm::mat4 RefractionViewProjection;
+    glm::mat4 ReflectionViewProjection;
+    draw_cull RefractionCull;
+    draw_cull ReflectionCull;
 };
 
 renderer Renderer_Create(const context &Context);
 void Renderer_Destroy(renderer &Renderer);
-void Renderer_ResizeFramebuffer(const renderer &Renderer, int ScreenWidth,
+void Renderer_ResizeFramebuffer(renderer &Renderer, int ScreenWidth,
                                 int ScreenHeight);
 void Renderer_BindFramebuffer(const renderer &Renderer, GLuint FramebufferID,
                               int Width, int Height);
@@ -66,19 +209,34 @@ void Renderer_WaterRefractionPass(const renderer &Renderer, const scene &Scene,
                                   const context &Context);
 void Renderer_WaterReflectionPass(const renderer &Renderer, const scene &Scene,
                                   const context &Context);
+bool Renderer_UpdatePlanarWater(renderer &Renderer, const scene &Scene,
+                                const context &Context);
 void Renderer_BloomPass(renderer &Renderer, const scene &Scene,
                         const context &Context);
-void Renderer_MainScenePass(const renderer &Renderer, const scene &Scene,
+void Renderer_MainScenePass(renderer &Renderer, const scene &Scene,
                             const context &Context);
+bool Renderer_UpdateDepthPrePass(renderer &Renderer, const scene &Scene);
+void Renderer_DepthPrePass(const renderer &Renderer, const scene &Scene);
+void Renderer_TransparentPass(const renderer &Renderer, const scene &Scene,
+                              const context &Context);
 void Renderer_GuiPass(const renderer &Renderer, const scene &Scene,
                       const context &Context);
-void Renderer_PresentPass(const renderer &Renderer, const scene &Scene,
-                          bool PingPongBuffer, const context &Context);
+void Renderer_UpdateDynamicResolution(renderer &Renderer);
+void Renderer_PresentPass(renderer &Renderer, const postprocess_chain &Chain,
+                          const context &Context);
 void Renderer_Draw(renderer &Renderer, const scene &Scene,
                    const context &Context);
 void Renderer_DrawScene(const renderer &Renderer, const shader &ShaderProgram,
-                        const scene &Scene, bool useEntityShader = true);
+                        const scene &Scene, bool useEntityShader = true,
+                        draw_filter Filter = draw_filter::All,
+                        const draw_cull *Cull = nullptr);
+bool Renderer_IsDepthPrePassEntity(const entity &Entity);
+bool Renderer_IsTransparentEntity(const entity &Entity);
 void Renderer_DrawSceneWater(const renderer &Renderer, const scene &Scene);
+void Renderer_DrawSceneDepth(const renderer &Renderer, const shader &Shader,
+                             const scene &Scene,
+                             draw_filter Filter = draw_filter::All,
+                             const shadow_cull *Cull = nullptr);
 void Renderer_DrawQuadEntity(const renderer &Renderer,
                              const shader &ShaderProgram, const entity &Entity);
 void Renderer_DrawCubeEntity(const renderer &Renderer,
@@ -86,6 +244,9 @@ void Renderer_DrawCubeEntity(const renderer &Renderer,
 void Renderer_DrawModelEntity(const renderer &Renderer,
                               const shader &ShaderProgram,
                               const entity &Entity);
+void Renderer_DrawLodGridEntity(const renderer &Renderer,
+                                const shader &ShaderProgram,
+                                const entity &Entity, const draw_cull &View);
 void Renderer_DrawGuiEntity(const renderer &Renderer,
                             const shader &ShaderProgram, const entity &Entity);
 void Renderer_DrawSkybox(const renderer &Renderer, const skybox &Skybox);
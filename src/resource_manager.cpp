@@ -1,29 +1,72 @@
 #include "resource_manager.h"
+#include "mesh_cache.h"
 #include "model.h"
+#include "postprocess.h"
 #include "shader.h"
 #include "texture.h"
+#include <atomic>
 #include <iostream>
+#include <memory>
+
+// default.frag with the vertex stage and defines of Features
+static void ResourceManager_SubmitLitShader(resource_manager &ResourceManager,
+                                            shader &Shader,
+                                            unsigned int Features) {
+    const char *VertexFile = "./resources/shaders/default.vert";
+    if (Features & SHADER_FEATURE_INSTANCED) {
+        VertexFile = "./resources/shaders/instance.vert";
+    } else if (Features & SHADER_FEATURE_TERRAIN) {
+        VertexFile = "./resources/shaders/terrain.vert";
+    }
+    Shader_Submit(Shader, VertexFile, "./resources/shaders/default.frag",
+                  nullptr, Shader_GetFeatureDefines(Features),
+                  &ResourceManager.ShaderCache);
+}
+
+// Once linked. The shadow samplers always sit on units 3 to 5, see
+// Renderer_MainScenePass.
+static void ResourceManager_SetLitSamplers(const shader &Shader) {
+    Shader_SetInt(Shader, "u_shadow_map", 3);
+    Shader_SetInt(Shader, "u_shadow_cubemap", 4);
+    Shader_SetInt(Shader, "u_shadow_paraboloid", 5);
+}
 
 void ResourceManager_LoadShaders(resource_manager &ResourceManager) {
+    double StartTime = glfwGetTime();
+    ShaderCache_Create(ResourceManager.ShaderCache, "./cache/shaders");
+    ResourceManager.ParallelShaderCompile = Shader_EnableParallelCompile();
 
-    ResourceManager_LoadShader(ResourceManager, shader_type::Lit,
-                               "./resources/shaders/default.vert",
-                               "./resources/shaders/default.frag");
+    // Everything is submitted before the first status query, the driver
+    // compiles the lot while we keep issuing
+
+    const shader_type LitShaderTypes[] = {shader_type::Lit,
+                                          shader_type::Instance,
+                                          shader_type::Terrain};
+    const unsigned int LitShaderFeatures[] = {
+        SHADER_FEATURES_ALL,
+        SHADER_FEATURES_ALL | SHADER_FEATURE_INSTANCED,
+        SHADER_FEATURES_ALL | SHADER_FEATURE_TERRAIN,
+    };
+    for (int i = 0; i < 3; i++) {
+        shader Shader;
+        ResourceManager_SubmitLitShader(ResourceManager, Shader,
+                                        LitShaderFeatures[i]);
+        ResourceManager.Shaders.emplace(LitShaderTypes[i], Shader);
+    }
+
+    // default.vert only writes the clip distance with CLIP_PLANE
+    std::string ClipPlane = Shader_GetFeatureDefines(SHADER_FEATURE_CLIP_PLANE);
     ResourceManager_LoadShader(ResourceManager, shader_type::Outline,
                                "./resources/shaders/default.vert",
-                               "./resources/shaders/outline.frag");
+                               "./resources/shaders/outline.frag", nullptr,
+                               ClipPlane);
     ResourceManager_LoadShader(ResourceManager, shader_type::Quad,
                                "./resources/shaders/default.vert",
-                               "./resources/shaders/quad.frag");
-    ResourceManager_LoadShader(ResourceManager, shader_type::Screen,
-                               "./resources/shaders/framebuffer.vert",
-                               "./resources/shaders/framebuffer.frag");
+                               "./resources/shaders/quad.frag", nullptr,
+                               ClipPlane);
     ResourceManager_LoadShader(ResourceManager, shader_type::Skybox,
                                "./resources/shaders/cubemap.vert",
                                "./resources/shaders/cubemap.frag");
-    ResourceManager_LoadShader(ResourceManager, shader_type::Instance,
-                               "./resources/shaders/instance.vert",
-                               "./resources/shaders/default.frag");
     ResourceManager_LoadShader(ResourceManager, shader_type::Unlit,
                                "./resources/shaders/unlit.vert",
                                "./resources/shaders/unlit.frag");
@@ -34,60 +77,119 @@ void ResourceManager_LoadShaders(resource_manager &ResourceManager) {
                                "./resources/shaders/cube_depth.vert",
                                "./resources/shaders/cube_depth.frag",
                                "./resources/shaders/cube_depth.gs");
-    ResourceManager_LoadShader(ResourceManager, shader_type::Blur,
-                               "./resources/shaders/blur.vert",
-                               "./resources/shaders/blur.frag");
+    ResourceManager_LoadShader(ResourceManager, shader_type::ParaboloidDepth,
+                               "./resources/shaders/cube_depth.vert",
+                               "./resources/shaders/cube_depth.frag",
+                               "./resources/shaders/paraboloid_depth.gs");
+    ResourceManager_LoadShader(ResourceManager, shader_type::DepthPrePass,
+                               "./resources/shaders/depth_prepass.vert",
+                               "./resources/shaders/simple_depth.frag");
+    ResourceManager_LoadShader(ResourceManager, shader_type::BloomDownsample,
+                               "./resources/shaders/framebuffer.vert",
+                               "./resources/shaders/bloom_downsample.frag");
+    ResourceManager_LoadShader(ResourceManager, shader_type::BloomUpsample,
+                               "./resources/shaders/framebuffer.vert",
+                               "./resources/shaders/bloom_upsample.frag");
+    ResourceManager_LoadShader(ResourceManager, shader_type::OITComposite,
+                               "./resources/shaders/framebuffer.vert",
+                               "./resources/shaders/oit_composite.frag");
     ResourceManager_LoadShader(ResourceManager, shader_type::Water,
                                "./resources/shaders/water.vert",
                                "./resources/shaders/water.frag");
     ResourceManager_LoadShader(ResourceManager, shader_type::Gui,
                                "./resources/shaders/gui.vert",
                                "./resources/shaders/gui.frag");
+
+    // The first frame needs all of them
+    for (auto &Iter : ResourceManager.Shaders) {
+        Shader_Poll(Iter.second, true);
+    }
+    for (shader_type Type : LitShaderTypes) {
+        ResourceManager_SetLitSamplers(ResourceManager.Shaders[Type]);
+    }
+
+    // Every program's link status was queried, so the links are done
+    shader_cache &Cache = ResourceManager.ShaderCache;
+    Cache.StartupTime = (float)((glfwGetTime() - StartTime) * 1000.0);
 }
 
-void ResourceManager_LoadTextures(resource_manager &ResourceManager) {
+void ResourceManager_LoadAssets(resource_manager &ResourceManager,
+                                thread_pool *Pool) {
+    double StartTime = glfwGetTime();
+    upload_queue Uploads;
+    UploadQueue_Create(Uploads);
+
+    // The imports are the longest jobs, they go in first
+    ResourceManager_LoadModels(ResourceManager, Pool, Uploads);
+    ResourceManager_LoadTextures(ResourceManager, Pool, Uploads);
+    // Shaders only need the GL thread, they compile while the workers decode
+    ResourceManager_LoadShaders(ResourceManager);
+    UploadQueue_Run(Uploads, true);
+
+    ResourceManager.LoadTime = (float)((glfwGetTime() - StartTime) * 1000.0);
+}
+
+// Runs the CPU half of a load on the pool, or right here without one
+static void ResourceManager_RunJob(thread_pool *Pool,
+                                   std::function<void()> Job) {
+    if (Pool) {
+        ThreadPool_Submit(*Pool, std::move(Job));
+    } else {
+        Job();
+    }
+}
+
+void ResourceManager_LoadTextures(resource_manager &ResourceManager,
+                                  thread_pool *Pool, upload_queue &Uploads) {
     // Crate(Container)
-    ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/container.png", GL_TEXTURE_2D,
-        GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse", "container_diffuse");
-    ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/container_specular.png",
-        GL_TEXTURE_2D, GL_TEXTURE1, GL_RGBA, GL_UNSIGNED_BYTE, "specular",
-        "container_specular");
+    ResourceManager_LoadTexture(ResourceManager, Pool, Uploads,
+                                "./resources/textures/container.png",
+                                GL_TEXTURE_2D, GL_TEXTURE0, GL_RGBA,
+                                GL_UNSIGNED_BYTE, "diffuse",
+                                "container_diffuse");
+    ResourceManager_LoadTexture(ResourceManager, Pool, Uploads,
+                                "./resources/textures/container_specular.png",
+                                GL_TEXTURE_2D, GL_TEXTURE1, GL_RGBA,
+                                GL_UNSIGNED_BYTE, "specular",
+                                "container_specular");
 
     // Rock
     ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/dry_riverbed_rock_diff.png",
-        GL_TEXTURE_2D, GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse",
-        "rock_diffuse");
+        ResourceManager, Pool, Uploads,
+        "./resources/textures/dry_riverbed_rock_diff.png", GL_TEXTURE_2D,
+        GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse", "rock_diffuse");
     ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/dry_riverbed_rock_normal.png",
-        GL_TEXTURE_2D, GL_TEXTURE2, GL_RGBA, GL_UNSIGNED_BYTE, "normal",
-        "rock_normal");
+        ResourceManager, Pool, Uploads,
+        "./resources/textures/dry_riverbed_rock_normal.png", GL_TEXTURE_2D,
+        GL_TEXTURE2, GL_RGBA, GL_UNSIGNED_BYTE, "normal", "rock_normal");
 
     // Grass
-    ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/grass.png", GL_TEXTURE_2D,
-        GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse", "grass_diffuse");
+    ResourceManager_LoadTexture(ResourceManager, Pool, Uploads,
+                                "./resources/textures/grass.png",
+                                GL_TEXTURE_2D, GL_TEXTURE0, GL_RGBA,
+                                GL_UNSIGNED_BYTE, "diffuse", "grass_diffuse");
 
     // Window
     ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/blending_transparent_window.png",
-        GL_TEXTURE_2D, GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse",
-        "window_diffuse");
+        ResourceManager, Pool, Uploads,
+        "./resources/textures/blending_transparent_window.png", GL_TEXTURE_2D,
+        GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse", "window_diffuse");
 
     // Wood
-    ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/wood.png", GL_TEXTURE_2D,
-        GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "diffuse", "wood_diffuse");
+    ResourceManager_LoadTexture(ResourceManager, Pool, Uploads,
+                                "./resources/textures/wood.png", GL_TEXTURE_2D,
+                                GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE,
+                                "diffuse", "wood_diffuse");
 
     // Water
-    ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/water_dudv.png", GL_TEXTURE_2D,
-        GL_TEXTURE0, GL_RGBA, GL_UNSIGNED_BYTE, "dudv", "water_dudv");
-    ResourceManager_LoadTexture(
-        ResourceManager, "./resources/textures/water_normal.png", GL_TEXTURE_2D,
-        GL_TEXTURE1, GL_RGBA, GL_UNSIGNED_BYTE, "normal", "water_normal");
+    ResourceManager_LoadTexture(ResourceManager, Pool, Uploads,
+                                "./resources/textures/water_dudv.png",
+                                GL_TEXTURE_2D, GL_TEXTURE0, GL_RGBA,
+                                GL_UNSIGNED_BYTE, "dudv", "water_dudv");
+    ResourceManager_LoadTexture(ResourceManager, Pool, Uploads,
+                                "./resources/textures/water_normal.png",
+                                GL_TEXTURE_2D, GL_TEXTURE1, GL_RGBA,
+                                GL_UNSIGNED_BYTE, "normal", "water_normal");
 
     // Skyboxes
     // Default
@@ -99,8 +201,8 @@ void ResourceManager_LoadTextures(resource_manager &ResourceManager) {
         "./resources/textures/skybox/front.jpg",
         "./resources/textures/skybox/back.jpg",
     };
-    ResourceManager_LoadCubemap(ResourceManager, DefaultSkyboxFaces,
-                                "default_skybox");
+    ResourceManager_LoadCubemap(ResourceManager, Pool, Uploads,
+                                DefaultSkyboxFaces, "default_skybox");
 
     // Night
     std::vector<std::string> NightSkyboxFaces{
@@ -111,50 +213,185 @@ void ResourceManager_LoadTextures(resource_manager &ResourceManager) {
         "./resources/textures/night_skybox/front.png",
         "./resources/textures/night_skybox/back.png",
     };
-    ResourceManager_LoadCubemap(ResourceManager, NightSkyboxFaces,
-                                "night_skybox");
+    ResourceManager_LoadCubemap(ResourceManager, Pool, Uploads,
+                                NightSkyboxFaces, "night_skybox");
+}
+
+// Loaded at startup, and what the offline cook step cooks
+static const char *const StartupModels[][2] = {
+    {"./resources/models/backpack/backpack.obj", "backpack_model"},
+    {"./resources/models/rock/rock.obj", "rock_model"},
+};
+
+void ResourceManager_LoadModels(resource_manager &ResourceManager,
+                                thread_pool *Pool, upload_queue &Uploads) {
+    for (const auto &Model : StartupModels) {
+        ResourceManager_LoadModel(ResourceManager, Pool, Uploads, Model[0],
+                                  Model[1]);
+    }
 }
 
-void ResourceManager_LoadModels(resource_manager &ResourceManager) {
-    ResourceManager_LoadModel(ResourceManager,
-                              "./resources/models/backpack/backpack.obj",
-                              "backpack_model");
-    ResourceManager_LoadModel(ResourceManager,
-                              "./resources/models/rock/rock.obj", "rock_model");
+bool ResourceManager_CookModels(thread_pool *Pool) {
+    // the streamed ones too, they load mid-session where it hurts most
+    std::vector<const char *> Files = {
+        "./resources/models/cyborg/cyborg.obj",
+        "./resources/models/nanosuit/nanosuit.obj",
+    };
+    for (const auto &Model : StartupModels) {
+        Files.push_back(Model[0]);
+    }
+
+    bool Cooked = true;
+    for (const char *File : Files) {
+        model_import Import = {};
+        Cooked = Model_ImportSource(Import, File, Pool) &&
+                 MeshCache_Store(Import, File,
+                                 MeshCache_HashSource(File)) &&
+                 Cooked;
+    }
+    return Cooked;
 }
 
 void ResourceManager_LoadTexture(resource_manager &ResourceManager,
+                                 thread_pool *Pool, upload_queue &Uploads,
                                  const char *File, GLenum TexType, GLenum Slot,
                                  GLenum Format, GLenum PixelType,
                                  std::string Name, std::string Key) {
-    texture Texture;
-    Texture_Create(&Texture, File, TexType, Slot, Format, PixelType);
-    Texture.Name = Name;
+    std::string Path = File;
+    UploadQueue_Expect(Uploads);
+    // A cache miss doesn't hold the worker while the source is read
+    ResourceManager_RunJob(Pool, [&ResourceManager, &Uploads, Pool, Path,
+                                  TexType, Slot, PixelType, Name, Key] {
+        Texture_LoadImageAsync(
+            Path, true, Pool,
+            [&ResourceManager, &Uploads, TexType, Slot, PixelType, Name,
+             Key](texture_image &Image, bool) {
+                UploadQueue_Push(Uploads, [&ResourceManager, Image, TexType,
+                                           Slot, PixelType, Name,
+                                           Key]() mutable {
+                    texture Texture;
+                    Texture_Upload(&Texture, Image, TexType, Slot, PixelType);
+                    Texture_FreeImage(Image);
+                    Texture.Name = Name;
 
-    ResourceManager.Textures.emplace(Key, Texture);
+                    ResourceManager.Textures.emplace(Key, Texture);
+                });
+            });
+    });
 }
 
+// Faces decode in parallel, the last one to finish queues the upload
+struct cubemap_load {
+    std::vector<std::string> Files;
+    std::vector<texture_image> Faces;
+    std::atomic<int> Remaining;
+};
+
 void ResourceManager_LoadCubemap(resource_manager &ResourceManager,
+                                 thread_pool *Pool, upload_queue &Uploads,
                                  std::vector<std::string> Faces,
                                  std::string Key) {
-    texture Texture;
-    Texture_CreateCubemap(&Texture, Faces);
+    auto Load = std::make_shared<cubemap_load>();
+    Load->Files = Faces;
+    Load->Faces.resize(Faces.size());
+    Load->Remaining = (int)Faces.size();
+
+    UploadQueue_Expect(Uploads);
+    for (size_t i = 0; i < Faces.size(); i++) {
+        auto Done = [&ResourceManager, &Uploads, Load, i,
+                     Key](texture_image &Image, bool Loaded) {
+            Load->Faces[i] = Image;
+            if (!Loaded) {
+                std::cout << "Cubemap tex failed to load at path: "
+                          << Load->Files[i] << std::endl;
+            }
+            if (Load->Remaining.fetch_sub(1) != 1) {
+                return;
+            }
+
+            UploadQueue_Push(Uploads, [&ResourceManager, Load, Key] {
+                texture Texture;
+                Texture_UploadCubemap(&Texture, Load->Faces);
+                for (texture_image &Face : Load->Faces) {
+                    Texture_FreeImage(Face);
+                }
 
-    ResourceManager.Textures.emplace(Key, Texture);
+                ResourceManager.Textures.emplace(Key, Texture);
+            });
+        };
+        ResourceManager_RunJob(Pool, [Pool, Load, i, Done] {
+            Texture_LoadImageAsync(Load->Files[i], false, Pool, Done);
+        });
+    }
 }
 
 void ResourceManager_LoadModel(resource_manager &ResourceManager,
+                               thread_pool *Pool, upload_queue &Uploads,
                                const char *File, std::string Key) {
+    // Inserted now so the job has a stable model to fill in
     auto [Iter, Inserted] = ResourceManager.Models.emplace(Key, model{});
-    Model_Create(&Iter->second, File, false);
+    model *Model = &Iter->second;
+    Model->GammaCorrection = false;
+
+    std::string Path = File;
+    UploadQueue_Expect(Uploads);
+    ResourceManager_RunJob(Pool, [&Uploads, Pool, Model, Path] {
+        auto Import = std::make_shared<model_import>();
+        bool Imported = Model_Import(*Import, Path, Pool);
+        if (Imported) {
+            // the job's own thread helps with these
+            Model_LoadImages(*Import, Pool);
+        }
+
+        UploadQueue_Push(Uploads, [Model, Import, Imported] {
+            if (Imported) {
+                Model_Upload(Model, *Import);
+            }
+        });
+    });
+}
+
+model *ResourceManager_LoadModelAsync(resource_manager &ResourceManager,
+                                      const char *File, std::string Key) {
+    auto [Iter, Inserted] = ResourceManager.Models.emplace(Key, model{});
+    if (Inserted) {
+        AssetStream_RequestModel(*ResourceManager.Stream, &Iter->second,
+                                 File);
+    }
+    return &Iter->second;
+}
+
+texture *ResourceManager_LoadTextureAsync(resource_manager &ResourceManager,
+                                          const char *File, std::string Name,
+                                          std::string Key) {
+    auto [Iter, Inserted] = ResourceManager.Textures.emplace(Key, texture{});
+    if (Inserted) {
+        Iter->second.Name = Name;
+        AssetStream_RequestTexture(*ResourceManager.Stream, &Iter->second,
+                                   File);
+    }
+    return &Iter->second;
+}
+
+void ResourceManager_BenchmarkImports(resource_manager &ResourceManager,
+                                      thread_pool *Pool) {
+    const char *Files[] = {"./resources/models/nanosuit/nanosuit.obj",
+                           "./resources/models/cyborg/cyborg.obj"};
+    ResourceManager.ImportBenchmarks.clear();
+    for (const char *File : Files) {
+        model_import_benchmark Benchmark = Model_BenchmarkImport(File, Pool);
+        ResourceManager.ImportBenchmarks.push_back(Benchmark);
+    }
 }
 
 void ResourceManager_LoadShader(resource_manager &ResourceManager,
                                 shader_type ShaderType, const char *VertexFile,
                                 const char *FragmentFile,
-                                const char *GeometryFile) {
+                                const char *GeometryFile,
+                                const std::string &Defines) {
     shader Shader;
-    Shader_Create(Shader, VertexFile, FragmentFile, GeometryFile);
+    Shader_Submit(Shader, VertexFile, FragmentFile, GeometryFile, Defines,
+                  &ResourceManager.ShaderCache);
 
     ResourceManager.Shaders.emplace(ShaderType, Shader);
 }
@@ -195,14 +432,110 @@ const shader *ResourceManager_GetShader(const resource_manager &ResourceManager,
     return &Existing->second;
 }
 
+const shader *
+ResourceManager_GetPostProcessShader(resource_manager &ResourceManager,
+                                     unsigned int Effects) {
+    auto Existing = ResourceManager.PostProcessShaders.find(Effects);
+    if (Existing != ResourceManager.PostProcessShaders.end()) {
+        return &Existing->second;
+    }
+
+    shader Shader;
+    Shader_Create(Shader, "./resources/shaders/framebuffer.vert",
+                  "./resources/shaders/framebuffer.frag", nullptr,
+                  PostProcess_GetDefines(Effects),
+                  &ResourceManager.ShaderCache);
+    Shader_SetInt(Shader, "u_screen_texture", 0);
+    Shader_SetInt(Shader, "u_bloom_texture", 1);
+
+    auto Inserted = ResourceManager.PostProcessShaders.emplace(Effects, Shader);
+    return &Inserted.first->second;
+}
+
+const shader *ResourceManager_GetLitShader(resource_manager &ResourceManager,
+                                          unsigned int Features) {
+    auto Existing = ResourceManager.LitShaders.find(Features);
+    if (Existing != ResourceManager.LitShaders.end()) {
+        return &Existing->second;
+    }
+
+    shader Shader;
+    ResourceManager_SubmitLitShader(ResourceManager, Shader, Features);
+    auto Inserted = ResourceManager.LitShaders.emplace(Features, Shader);
+    if (!Inserted.first->second.Pending) {
+        // came straight from the binary cache
+        ResourceManager_SetLitSamplers(Inserted.first->second);
+    }
+    return &Inserted.first->second;
+}
+
+int ResourceManager_UpdateLitShaders(resource_manager &ResourceManager) {
+    int PendingCount = 0;
+    // without the extension a poll blocks on the link, so only take one hit
+    // per frame and let the fallback shaders draw the rest meanwhile
+    bool Polled = false;
+    for (auto &Iter : ResourceManager.LitShaders) {
+        shader &Shader = Iter.second;
+        if (!Shader.Pending) {
+            continue;
+        }
+        if (!ResourceManager.ParallelShaderCompile && Polled) {
+            PendingCount++;
+            continue;
+        }
+        Polled = true;
+        if (Shader_Poll(Shader, false)) {
+            if (!Shader.Failed) {
+                ResourceManager_SetLitSamplers(Shader);
+            }
+        } else {
+            PendingCount++;
+        }
+    }
+    return PendingCount;
+}
+
+const shader *
+ResourceManager_FindLitShader(const resource_manager &ResourceManager,
+                              unsigned int Features) {
+    auto Existing = ResourceManager.LitShaders.find(Features);
+    if (Existing != ResourceManager.LitShaders.end() &&
+        !Existing->second.Pending && !Existing->second.Failed) {
+        return &Existing->second;
+    }
+
+    // not compiled yet or failed to link, the uniform driven shader draws it
+    // all the same
+    shader_type Fallback = shader_type::Lit;
+    if (Features & SHADER_FEATURE_INSTANCED) {
+        Fallback = shader_type::Instance;
+    } else if (Features & SHADER_FEATURE_TERRAIN) {
+        Fallback = shader_type::Terrain;
+    }
+    return ResourceManager_GetShader(ResourceManager, Fallback);
+}
+
 void ResourceManager_ClearResources(resource_manager &ResourceManager) {
     for (auto Iter : ResourceManager.Textures) {
-        glDeleteTextures(1, &Iter.second.ID);
+        // still streaming, the stream owns the placeholder
+        if (!AssetStream_IsPlaceholder(*ResourceManager.Stream,
+                                       Iter.second.ID)) {
+            glDeleteTextures(1, &Iter.second.ID);
+        }
     }
 
     for (auto Iter : ResourceManager.Shaders) {
         Shader_Delete(Iter.second);
     }
 
+    for (auto Iter : ResourceManager.PostProcessShaders) {
+        Shader_Delete(Iter.second);
+    }
+
+    for (auto Iter : ResourceManager.LitShaders) {
+        Shader_Delete(Iter.second);
+    }
+    ShaderCache_Destroy(ResourceManager.ShaderCache);
+
     // TODO: Clean up the model textures
 }
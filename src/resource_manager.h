@@ -3,35 +3,93 @@
 
 #include <map>
 #include <string>
+#include "asset_stream.h"
 #include "model.h"
 #include "texture.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
 
 struct resource_manager {
     std::map<std::string, texture> Textures;
     std::map<std::string, model> Models;
 
     std::map<shader_type, shader> Shaders;
+    // framebuffer.frag permutations keyed by postprocess_effect mask,
+    // compiled the first time a combination is used
+    std::map<unsigned int, shader> PostProcessShaders;
+    // default.frag permutations keyed by shader_feature mask, compiled the
+    // first time a scene needs them (see Renderer_PrepareLitShaders)
+    std::map<unsigned int, shader> LitShaders;
+    // LitShaders still compiling, as of the last update
+    int PendingLitShaders;
+    shader_cache ShaderCache;
+    bool ParallelShaderCompile;
+    // milliseconds ResourceManager_LoadAssets took
+    float LoadTime;
+    // Owned by main, does the *Async loads
+    asset_stream *Stream;
+    std::vector<model_import_benchmark> ImportBenchmarks;
 };
 
+// Everything the scenes need at startup. File reads, decoding and model
+// imports run on Pool, the uploads on the calling GL thread as the jobs
+// finish. A null Pool loads everything on the calling thread.
+void ResourceManager_LoadAssets(resource_manager &ResourceManager,
+                                thread_pool *Pool);
 void ResourceManager_LoadShaders(resource_manager &ResourceManager);
 void ResourceManager_LoadShader(resource_manager &ResourceManager,
                                 shader_type Key, const char *VertexFile,
                                 const char *FragmentFile,
-                                const char *GeometryFile = nullptr);
-void ResourceManager_LoadTextures(resource_manager &ResourceManager);
-void ResourceManager_LoadModels(resource_manager &ResourceManager);
+                                const char *GeometryFile = nullptr,
+                                const std::string &Defines = "");
+void ResourceManager_LoadTextures(resource_manager &ResourceManager,
+                                  thread_pool *Pool, upload_queue &Uploads);
+void ResourceManager_LoadModels(resource_manager &ResourceManager,
+                                thread_pool *Pool, upload_queue &Uploads);
+// Offline cook step, writes the mesh cache entry of every model the app
+// loads. No GL needed.
+bool ResourceManager_CookModels(thread_pool *Pool);
 void ResourceManager_LoadModel(resource_manager &ResourceManager,
+                               thread_pool *Pool, upload_queue &Uploads,
                                const char *File, std::string Key);
 void ResourceManager_LoadTexture(resource_manager &ResourceManager,
+                                 thread_pool *Pool, upload_queue &Uploads,
                                  const char *File, GLenum TexType, GLenum Slot,
                                  GLenum Format, GLenum PixelType,
                                  std::string Name, std::string Key);
 void ResourceManager_LoadCubemap(resource_manager &ResourceManager,
+                                 thread_pool *Pool, upload_queue &Uploads,
                                  std::vector<std::string> Faces,
                                  std::string Key);
+// Return the resource right away, drawn as a placeholder until the stream
+// uploaded it (see AssetStream_GetState). An existing Key is returned as is.
+model *ResourceManager_LoadModelAsync(resource_manager &ResourceManager,
+                                      const char *File, std::string Key);
+texture *ResourceManager_LoadTextureAsync(resource_manager &ResourceManager,
+                                          const char *File, std::string Name,
+                                          std::string Key);
+// Times the mesh conversion of the larger models, serial and on Pool.
+// Blocks until done.
+void ResourceManager_BenchmarkImports(resource_manager &ResourceManager,
+                                      thread_pool *Pool);
 
 const shader *ResourceManager_GetShader(const resource_manager &ResourceManager,
                                   shader_type ShaderType);
+const shader *
+ResourceManager_GetPostProcessShader(resource_manager &ResourceManager,
+                                     unsigned int Effects);
+// Submits the permutation the first time, it may still be Pending
+const shader *ResourceManager_GetLitShader(resource_manager &ResourceManager,
+                                          unsigned int Features);
+// Finishes the permutations the driver is done with, never waits. Without
+// parallel compile that can't be asked, so it finishes one per call. Returns
+// how many are still compiling.
+int ResourceManager_UpdateLitShaders(resource_manager &ResourceManager);
+// Never compiles: falls back to the Lit, Instance or Terrain shader when the
+// permutation doesn't exist or isn't linked yet
+const shader *
+ResourceManager_FindLitShader(const resource_manager &ResourceManager,
+                              unsigned int Features);
 texture *ResourceManager_GetTexture(resource_manager &ResourceManager,
                                     std::string Name);
 model *ResourceManager_GetModel(resource_manager &ResourceManager,
@@ -5,18 +5,81 @@
 #include "material.h"
 #include "resource_manager.h"
 
+#include <cmath>
+#include <set>
+
 scene Scene_Create() {
     scene Scene = {};
 
     Scene.HDREnabled = false;
     Scene.HDRExposure = 1.0f;
     Scene.BloomEnabled = false;
+    Scene.ColorGradingEnabled = false;
+    Scene.Contrast = 1.0f;
+    Scene.Saturation = 1.0f;
+    Scene.DepthPrePassMode = depth_prepass_mode::Auto;
+    Scene.TransparencyMode = transparency_mode::WeightedBlended;
+    Scene.WaterMode = water_mode::ScreenSpace;
+    Scene.OceanEnabled = false;
 
     return Scene;
 }
 
 void Scene_Destroy(scene &Scene) {
     // TODO: Destroy any allocations
+    for (lod_grid &Grid : Scene.Grids) {
+        LodGrid_Destroy(Grid);
+    }
+    Scene.Grids.clear();
+    if (Scene.OceanEnabled) {
+        Ocean_Destroy(Scene.Ocean);
+        Scene.OceanEnabled = false;
+    }
+}
+
+void Scene_Update(scene &Scene, thread_pool &ThreadPool, float Time) {
+    if (Scene.OceanEnabled) {
+        Ocean_Update(Scene.Ocean, ThreadPool, Time);
+    }
+}
+
+// Textures the entity's materials point at
+static void Scene_CollectTextures(const entity &Entity,
+                                  std::set<const texture *> &Textures) {
+    for (const texture *Texture : Entity.Mesh.Material.Textures) {
+        Textures.insert(Texture);
+    }
+    if (Entity.Type == entity_type::Model && Entity.Model) {
+        for (const mesh &Mesh : Entity.Model->Meshes) {
+            for (const texture *Texture : Mesh.Material.Textures) {
+                Textures.insert(Texture);
+            }
+        }
+    }
+}
+
+void Scene_GetTextureMemory(const scene &Scene, size_t &Size,
+                            size_t &UncompressedSize) {
+    std::set<const texture *> Textures;
+    for (const entity &Entity : Scene.Entities) {
+        Scene_CollectTextures(Entity, Textures);
+    }
+    for (const entity &Entity : Scene.Instances) {
+        Scene_CollectTextures(Entity, Textures);
+    }
+    for (const light &Light : Scene.Lights) {
+        Scene_CollectTextures(Light.Entity, Textures);
+    }
+    for (const texture *Texture : Scene.Skybox.Mesh.Material.Textures) {
+        Textures.insert(Texture);
+    }
+
+    Size = 0;
+    UncompressedSize = 0;
+    for (const texture *Texture : Textures) {
+        Size += Texture->Size;
+        UncompressedSize += Texture->UncompressedSize;
+    }
 }
 
 void Scene_AddEntity(scene &Scene, entity &Entity) {
@@ -31,6 +94,13 @@ void Scene_AddGuiTexture(scene &Scene, entity &Entity) {
     Scene.GuiTextures.push_back(Entity);
 }
 
+lod_grid *Scene_AddGrid(scene &Scene, float Size, int LevelCount,
+                        int PatchResolution) {
+    lod_grid &Grid = Scene.Grids.emplace_back();
+    LodGrid_Create(Grid, Size, LevelCount, PatchResolution);
+    return &Grid;
+}
+
 void Scene_AddLight(scene &Scene, light &Light) {
     Scene.Lights.push_back(Light);
 }
@@ -62,6 +132,7 @@ void Scene_AddPointLight(scene &Scene, glm::vec3 Position, glm::vec4 Color,
         .UseBlinn = false,
         .CastsShadow = false,
         .ShowDebug = ShowDebug,
+        .ShadowMode = point_shadow_mode::Cubemap,
     };
     Scene_AddLight(Scene, PointLight);
 }
@@ -306,6 +377,7 @@ void Scene_BuildScene1(scene &Scene, resource_manager &ResourceManager,
     material GrassMaterial = {};
     Material_Create(GrassMaterial);
     GrassMaterial.Textures = GrassTextures;
+    GrassMaterial.IsTransparent = true;
 
     mesh GrassMesh;
     Mesh_CreateQuad(&GrassMesh, GrassMaterial);
@@ -334,15 +406,10 @@ void Scene_BuildScene1(scene &Scene, resource_manager &ResourceManager,
     Windows.push_back(glm::vec3(-0.3f, 0.0f, -2.3f));
     Windows.push_back(glm::vec3(0.5f, 0.0f, -0.6f));
 
-    glm::vec3 CameraPosition = Camera.Position;
-    sort(Windows.begin(), Windows.end(),
-         [&CameraPosition](const glm::vec3 &A, const glm::vec3 &B) {
-             return length(CameraPosition - A) >= length(CameraPosition - B);
-         });
-
     material WindowMaterial = {};
     Material_Create(WindowMaterial);
     WindowMaterial.Textures = WindowTextures;
+    WindowMaterial.IsTransparent = true;
 
     mesh WindowMesh;
     Mesh_CreateQuad(&WindowMesh, WindowMaterial);
@@ -707,6 +774,55 @@ void Scene_BuildScene5(scene &Scene, resource_manager &ResourceManager,
     Scene_AddDirectionalLight(Scene, false);
 }
 
+static float Scene_Hash(glm::vec2 Cell) {
+    float Hash = std::sin(glm::dot(Cell, glm::vec2(127.1f, 311.7f))) *
+                 43758.5453f;
+    return Hash - std::floor(Hash);
+}
+
+// Smooth value noise in [-1, 1]
+static float Scene_ValueNoise(glm::vec2 Position) {
+    glm::vec2 Cell = glm::floor(Position);
+    glm::vec2 F = Position - Cell;
+    glm::vec2 U = F * F * (3.0f - 2.0f * F);
+
+    float A = Scene_Hash(Cell);
+    float B = Scene_Hash(Cell + glm::vec2(1.0f, 0.0f));
+    float C = Scene_Hash(Cell + glm::vec2(0.0f, 1.0f));
+    float D = Scene_Hash(Cell + glm::vec2(1.0f, 1.0f));
+    float Value = glm::mix(glm::mix(A, B, U.x), glm::mix(C, D, U.x), U.y);
+    return Value * 2.0f - 1.0f;
+}
+
+// A lake bed around the origin rising into hills, heights at the texel
+// centers of a Resolution x Resolution heightmap spanning Size
+static std::vector<float> Scene_CreateTerrainHeights(int Resolution,
+                                                     float Size) {
+    std::vector<float> Heights(Resolution * Resolution);
+    for (int z = 0; z < Resolution; z++) {
+        for (int x = 0; x < Resolution; x++) {
+            glm::vec2 Position =
+                ((glm::vec2((float)x, (float)z) + 0.5f) / (float)Resolution -
+                 0.5f) *
+                Size;
+
+            float Noise = 0.0f;
+            float Amplitude = 1.0f;
+            float Frequency = 0.05f;
+            for (int Octave = 0; Octave < 5; Octave++) {
+                Noise += Amplitude * Scene_ValueNoise(Position * Frequency);
+                Amplitude *= 0.5f;
+                Frequency *= 2.0f;
+            }
+
+            float Shore = glm::smoothstep(12.0f, 45.0f, glm::length(Position));
+            Heights[z * Resolution + x] =
+                -3.0f + Shore * 8.0f + Noise * (0.5f + 2.0f * Shore);
+        }
+    }
+    return Heights;
+}
+
 void Scene_BuildScene6(scene &Scene, resource_manager &ResourceManager,
                        camera &Camera) {
     Scene.HDREnabled = true;
@@ -794,21 +910,62 @@ void Scene_BuildScene6(scene &Scene, resource_manager &ResourceManager,
     WaterMaterial.Shininess = 16.0f;
     WaterMaterial.ShaderMaterial = shader_material::Water;
     WaterMaterial.Color = glm::vec4(1.0f, 0.5f, 0.31f, 1.0f);
+    // seen from below as well
+    WaterMaterial.CullFace = false;
 
-    mesh WaterMesh;
-    Mesh_CreateGrid(&WaterMesh, WaterMaterial, 100, 10.0f);
+    // Only holds the material, the geometry comes from the grid
+    mesh WaterMesh = {};
+    WaterMesh.Material = WaterMaterial;
+
+    // the node bounds leave room for the ocean waves
+    lod_grid *WaterGrid = Scene_AddGrid(Scene, 160.0f, 7, 16);
+    WaterGrid->MinHeight = -2.0f;
+    WaterGrid->MaxHeight = 2.0f;
 
     entity Water = {
-        .Type = entity_type::QuadMesh,
+        .Type = entity_type::LodGrid,
         .Position = glm::vec3(0.0f, 0.0f, 0.0f),
         .Scale = glm::vec3(1.0f),
-        .Rotation = glm::vec4(-90.0f, 1.0f, 0.0f, 0.0f),
+        .Rotation = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
         .IsSelected = false,
         .Mesh = WaterMesh,
+        .Grid = WaterGrid,
     };
 
     Scene_AddEntity(Scene, Water);
 
+    // 20 unit patches of open sea, tiled over the whole grid
+    Ocean_Create(Scene.Ocean, 128, 20.0f, 8.0f, glm::vec2(1.0f, 0.3f),
+                 0.0002f);
+    Scene.OceanEnabled = true;
+
+    // Terrain
+    texture *RockDiffuseMap =
+        ResourceManager_GetTexture(ResourceManager, "rock_diffuse");
+
+    material TerrainMaterial = {};
+    Material_Create(TerrainMaterial);
+    TerrainMaterial.Textures = {RockDiffuseMap};
+
+    mesh TerrainMesh = {};
+    TerrainMesh.Material = TerrainMaterial;
+
+    lod_grid *TerrainGrid = Scene_AddGrid(Scene, 160.0f, 7, 16);
+    LodGrid_SetHeightmap(*TerrainGrid, Scene_CreateTerrainHeights(256, 160.0f),
+                         256);
+
+    entity Terrain = {
+        .Type = entity_type::LodGrid,
+        .Position = glm::vec3(0.0f, 0.0f, 0.0f),
+        .Scale = glm::vec3(1.0f),
+        .Rotation = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f),
+        .IsSelected = false,
+        .Mesh = TerrainMesh,
+        .Grid = TerrainGrid,
+    };
+
+    Scene_AddEntity(Scene, Terrain);
+
     glm::vec3 PointLightPositions[] = {
         glm::vec3(0.0f, 0.0f, 0.9f),
         glm::vec3(-0.2f, 0.6f, 0.0f),
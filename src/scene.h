@@ -1,10 +1,26 @@
 #ifndef SCENE_H_
 #define SCENE_H_
 
+#include <deque>
 #include <vector>
 #include "camera.h"
 #include "entity.h"
+#include "lod_grid.h"
+#include "ocean.h"
 #include "resource_manager.h"
+#include "thread_pool.h"
+
+// Off/On force the depth pre-pass, Auto enables it from measured overdraw
+enum class depth_prepass_mode { Off, On, Auto };
+
+// Sorted blends back to front every frame, WeightedBlended is order
+// independent and doesn't need sorting
+enum class transparency_mode { Sorted, WeightedBlended };
+
+// Planar renders the scene again for refraction and reflection, ScreenSpace
+// reuses the opaque scene: refraction samples a copy of it and reflection
+// ray marches its depth, falling back to the skybox
+enum class water_mode { Planar, ScreenSpace };
 
 struct skybox {
     mesh Mesh;
@@ -15,6 +31,11 @@ struct scene {
     std::vector<light> Lights;
     std::vector<entity> Instances;
     std::vector<entity> GuiTextures;
+    // LodGrid entities point in here, deque so the pointers stay valid
+    std::deque<lod_grid> Grids;
+    // Displaces every water surface, off while OceanEnabled is false
+    ocean Ocean;
+    bool OceanEnabled;
 
     int Effect;
 
@@ -24,13 +45,29 @@ struct scene {
     float HDRExposure;
 
     bool BloomEnabled;
+
+    bool ColorGradingEnabled;
+    float Contrast;
+    float Saturation;
+
+    depth_prepass_mode DepthPrePassMode;
+    transparency_mode TransparencyMode;
+    water_mode WaterMode;
 };
 
 scene Scene_Create();
 void Scene_Destroy(scene &Scene);
+// Per frame simulation, runs before the scene is drawn
+void Scene_Update(scene &Scene, thread_pool &ThreadPool, float Time);
+// Video memory of the textures the scene draws with, shared ones once, and
+// what it would be without block compression
+void Scene_GetTextureMemory(const scene &Scene, size_t &Size,
+                            size_t &UncompressedSize);
 void Scene_AddEntity(scene &Scene, entity &Entity);
 void Scene_AddInstance(scene &Scene, entity &Entity);
 void Scene_AddGuiTexture(scene &Scene, entity &Entity);
+lod_grid *Scene_AddGrid(scene &Scene, float Size, int LevelCount,
+                        int PatchResolution);
 void Scene_AddLight(scene &Scene, light &Light);
 void Scene_AddPointLight(scene &Scene, glm::vec3 Position, glm::vec4 Color,
                          bool IsEnabled, bool ShowDebug);
@@ -1,100 +1,231 @@
-#include <fstream>
+#include <cstring>
 #include <iostream>
 #include <glm/gtc/type_ptr.hpp>
+#include "asset_pack.h"
 #include "shader.h"
 
 std::string GetFileContents(const char *Filename) {
-    std::ifstream in(Filename, std::ios::binary);
-    if (in) {
-        std::string Contents;
-        in.seekg(0, std::ios::end);
-        Contents.resize(in.tellg());
-        in.seekg(0, std::ios::beg);
-        in.read(&Contents[0], Contents.size());
-        in.close();
-        return Contents;
+    asset_file File;
+    if (AssetPack_Read(File, Filename)) {
+        return std::string((const char *)File.Data, File.Size);
     }
     throw errno;
 }
 
-void Shader_Create(shader &Shader, const char *VertexFile,
-                   const char *FragmentFile, const char *GeometryFile) {
+static void Shader_InsertDefines(std::string &Code,
+                                 const std::string &Defines) {
+    if (Defines.empty()) {
+        return;
+    }
+    // #version has to stay the first statement
+    size_t VersionEnd = Code.find('\n', Code.find("#version"));
+    if (VersionEnd == std::string::npos) {
+        Code = Defines + Code;
+        return;
+    }
+    Code.insert(VersionEnd + 1, Defines);
+}
+
+// glad is generated for 3.3 core, the extension is loaded by hand
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void(APIENTRYP max_shader_compiler_threads_proc)(GLuint Count);
+
+// Set by Shader_EnableParallelCompile, GL_COMPLETION_STATUS_KHR can be
+// queried without waiting on the compiler
+static bool ParallelCompile = false;
+
+bool Shader_HasExtension(const char *Name) {
+    GLint Count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &Count);
+    for (GLint i = 0; i < Count; i++) {
+        const char *Extension =
+            (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (Extension && strcmp(Extension, Name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Shader_EnableParallelCompile() {
+    // The ARB version has the same token and an ARB suffixed entry point
+    const char *Entry = nullptr;
+    if (Shader_HasExtension("GL_KHR_parallel_shader_compile")) {
+        Entry = "glMaxShaderCompilerThreadsKHR";
+    } else if (Shader_HasExtension("GL_ARB_parallel_shader_compile")) {
+        Entry = "glMaxShaderCompilerThreadsARB";
+    }
+    ParallelCompile = false;
+    if (Entry) {
+        auto MaxShaderCompilerThreads =
+            (max_shader_compiler_threads_proc)glfwGetProcAddress(Entry);
+        if (MaxShaderCompilerThreads) {
+            // as many compiler threads as the driver wants to use
+            MaxShaderCompilerThreads(0xFFFFFFFF);
+            ParallelCompile = true;
+        }
+    }
+    return ParallelCompile;
+}
+
+// Only issues the compile, the status is read once the program is linked
+static GLuint Shader_CompileStage(GLenum Type, const std::string &Code) {
+    const char *Source = Code.c_str();
+    GLuint Stage = glCreateShader(Type);
+    glShaderSource(Stage, 1, &Source, NULL);
+    glCompileShader(Stage);
+    return Stage;
+}
+
+// With a cache, a stage another program already compiled is reused
+static GLuint Shader_GetStage(shader_cache *Cache, GLenum Type,
+                              const std::string &Code) {
+    if (!Cache) {
+        return Shader_CompileStage(Type, Code);
+    }
+    GLuint Stage = ShaderCache_FindStage(*Cache, Type, Code);
+    if (!Stage) {
+        Stage = Shader_CompileStage(Type, Code);
+        ShaderCache_AddStage(*Cache, Type, Code, Stage);
+    }
+    return Stage;
+}
+
+void Shader_Submit(shader &Shader, const char *VertexFile,
+                   const char *FragmentFile, const char *GeometryFile,
+                   const std::string &Defines, shader_cache *Cache) {
     std::string VertexCode;
     std::string FragmentCode;
+    std::string GeometryCode;
 
     VertexCode = GetFileContents(VertexFile);
     FragmentCode = GetFileContents(FragmentFile);
+    Shader_InsertDefines(VertexCode, Defines);
+    Shader_InsertDefines(FragmentCode, Defines);
+    if (GeometryFile) {
+        GeometryCode = GetFileContents(GeometryFile);
+        Shader_InsertDefines(GeometryCode, Defines);
+    }
+
+    Shader.Pending = false;
+    Shader.Failed = false;
+    Shader.Build = {.StageCount = 0, .Cache = Cache};
 
-    const char *VertexShaderSource = VertexCode.c_str();
-    const char *FragmentShaderSource = FragmentCode.c_str();
+    // The entry is named after the files and defines, and goes stale as
+    // soon as a source or the driver changes
+    if (Cache) {
+        Shader.Build.CacheName = ShaderCache_Hash(
+            std::string(VertexFile) + "|" + FragmentFile + "|" +
+            (GeometryFile ? GeometryFile : "") + "|" + Defines);
+        Shader.Build.CacheHash =
+            ShaderCache_Hash(VertexCode, Cache->DriverHash);
+        Shader.Build.CacheHash =
+            ShaderCache_Hash(FragmentCode, Shader.Build.CacheHash);
+        Shader.Build.CacheHash =
+            ShaderCache_Hash(GeometryCode, Shader.Build.CacheHash);
+
+        // Loading a binary doesn't involve the compiler, it's done here
+        Shader.ID = glCreateProgram();
+        if (ShaderCache_LoadProgram(*Cache, Shader.Build.CacheName,
+                                    Shader.Build.CacheHash, Shader.ID)) {
+            return;
+        }
+        // a refused binary can leave the program in an odd state
+        glDeleteProgram(Shader.ID);
+    }
 
     // build and compile our shader program
     // ------------------------------------
-    // vertex shader
-    GLuint VertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(VertexShader, 1, &VertexShaderSource, NULL);
-    glCompileShader(VertexShader);
-
-    // check for shader compile errors
-    int Success;
-    char InfoLog[512];
-    glGetShaderiv(VertexShader, GL_COMPILE_STATUS, &Success);
-    if (!Success) {
-        glGetShaderInfoLog(VertexShader, 512, NULL, InfoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
-                  << InfoLog << std::endl;
+    shader_build &Build = Shader.Build;
+    Build.Stages[Build.StageCount++] =
+        Shader_GetStage(Cache, GL_VERTEX_SHADER, VertexCode);
+    Build.Stages[Build.StageCount++] =
+        Shader_GetStage(Cache, GL_FRAGMENT_SHADER, FragmentCode);
+    if (GeometryFile) {
+        Build.Stages[Build.StageCount++] =
+            Shader_GetStage(Cache, GL_GEOMETRY_SHADER, GeometryCode);
     }
 
-    // fragment shader
-    GLuint FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(FragmentShader, 1, &FragmentShaderSource, NULL);
-    glCompileShader(FragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(FragmentShader, GL_COMPILE_STATUS, &Success);
-    if (!Success) {
-        glGetShaderInfoLog(FragmentShader, 512, NULL, InfoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-                  << InfoLog << std::endl;
+    // link shaders
+    Shader.ID = glCreateProgram();
+    for (int i = 0; i < Build.StageCount; i++) {
+        glAttachShader(Shader.ID, Build.Stages[i]);
     }
+    if (Cache) {
+        ShaderCache_PrepareProgram(*Cache, Shader.ID);
+    }
+    glLinkProgram(Shader.ID);
+    Shader.Pending = true;
+}
 
-    GLuint GeometryShader;
-    if (GeometryFile) {
-        std::string GeometryCode = GetFileContents(GeometryFile);
-        const char *GeometryShaderSource = GeometryCode.c_str();
-
-        GeometryShader = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(GeometryShader, 1, &GeometryShaderSource, NULL);
-        glCompileShader(GeometryShader);
-        // check for shader compile errors
-        glGetShaderiv(GeometryShader, GL_COMPILE_STATUS, &Success);
+// Reports what failed, only called once the link did
+static void Shader_PrintErrors(const shader &Shader) {
+    const char *Labels[] = {"VERTEX", "FRAGMENT", "GEOMETRY"};
+    int Success;
+    char InfoLog[512];
+    for (int i = 0; i < Shader.Build.StageCount; i++) {
+        glGetShaderiv(Shader.Build.Stages[i], GL_COMPILE_STATUS, &Success);
         if (!Success) {
-            glGetShaderInfoLog(GeometryShader, 512, NULL, InfoLog);
-            std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
+            glGetShaderInfoLog(Shader.Build.Stages[i], 512, NULL, InfoLog);
+            std::cout << "ERROR::SHADER::" << Labels[i]
+                      << "::COMPILATION_FAILED\n"
                       << InfoLog << std::endl;
         }
     }
+    glGetProgramInfoLog(Shader.ID, 512, NULL, InfoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
+              << InfoLog << std::endl;
+}
 
-    // link shaders
-    Shader.ID = glCreateProgram();
-    glAttachShader(Shader.ID, VertexShader);
-    glAttachShader(Shader.ID, FragmentShader);
-    if (GeometryFile) {
-        glAttachShader(Shader.ID, GeometryShader);
+bool Shader_Poll(shader &Shader, bool Wait) {
+    if (!Shader.Pending) {
+        return true;
+    }
+    if (!Wait && ParallelCompile) {
+        GLint Completed = 0;
+        glGetProgramiv(Shader.ID, GL_COMPLETION_STATUS_KHR, &Completed);
+        if (!Completed) {
+            return false;
+        }
     }
 
-    glLinkProgram(Shader.ID);
-    // check for linking errors
+    // Without the extension this is where the compiler is waited on
+    int Success;
     glGetProgramiv(Shader.ID, GL_LINK_STATUS, &Success);
     if (!Success) {
-        glGetProgramInfoLog(Shader.ID, 512, NULL, InfoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
-                  << InfoLog << std::endl;
+        Shader_PrintErrors(Shader);
     }
-    glDeleteShader(VertexShader);
-    glDeleteShader(FragmentShader);
-    if (GeometryFile) {
-        glDeleteShader(GeometryShader);
+
+    shader_build &Build = Shader.Build;
+    for (int i = 0; i < Build.StageCount; i++) {
+        glDetachShader(Shader.ID, Build.Stages[i]);
+        // the cache keeps its stages for the next program that needs them
+        if (!Build.Cache) {
+            glDeleteShader(Build.Stages[i]);
+        }
+    }
+    if (Build.Cache) {
+        Build.Cache->ProgramsCompiled++;
+        if (Success) {
+            ShaderCache_StoreProgram(*Build.Cache, Build.CacheName,
+                                     Build.CacheHash, Shader.ID);
+        }
     }
+    Build.StageCount = 0;
+    Shader.Pending = false;
+    Shader.Failed = !Success;
+    return true;
+}
+
+void Shader_Create(shader &Shader, const char *VertexFile,
+                   const char *FragmentFile, const char *GeometryFile,
+                   const std::string &Defines, shader_cache *Cache) {
+    Shader_Submit(Shader, VertexFile, FragmentFile, GeometryFile, Defines,
+                  Cache);
+    Shader_Poll(Shader, true);
 }
 
 void Shader_Use(const shader &Shader) {
@@ -102,6 +233,11 @@ void Shader_Use(const shader &Shader) {
 }
 
 void Shader_Delete(shader &Shader) {
+    if (Shader.Pending && !Shader.Build.Cache) {
+        for (int i = 0; i < Shader.Build.StageCount; i++) {
+            glDeleteShader(Shader.Build.Stages[i]);
+        }
+    }
     glDeleteProgram(Shader.ID);
 }
 
@@ -144,6 +280,26 @@ void Shader_SetVec4(const shader &Shader, const char *Name,
     glUniform4fv(Shader_GetUniform(Shader, Name), 1, glm::value_ptr(Value));
 }
 
+std::string Shader_GetFeatureDefines(unsigned int Features) {
+    std::string Defines;
+    if (Features & SHADER_FEATURE_LIT) {
+        Defines += "#define LIT\n";
+    }
+    if (Features & SHADER_FEATURE_SHADOWS) {
+        Defines += "#define SHADOWS\n";
+    }
+    if (Features & SHADER_FEATURE_NORMAL_MAP) {
+        Defines += "#define NORMAL_MAP\n";
+    }
+    if (Features & SHADER_FEATURE_SPECULAR_MAP) {
+        Defines += "#define SPECULAR_MAP\n";
+    }
+    if (Features & SHADER_FEATURE_CLIP_PLANE) {
+        Defines += "#define CLIP_PLANE\n";
+    }
+    return Defines;
+}
+
 const char *ToString(shader_type ShaderType) {
     switch (ShaderType) {
     case shader_type::Lit:
@@ -152,18 +308,26 @@ const char *ToString(shader_type ShaderType) {
         return "Unlit";
     case shader_type::Water:
         return "Water";
+    case shader_type::Terrain:
+        return "Terrain";
     case shader_type::Outline:
         return "Outline";
     case shader_type::Skybox:
         return "Skybox";
-    case shader_type::Screen:
-        return "Screen";
-    case shader_type::Blur:
-        return "Blur";
+    case shader_type::BloomDownsample:
+        return "BloomDownsample";
+    case shader_type::BloomUpsample:
+        return "BloomUpsample";
     case shader_type::Depth:
         return "Depth";
     case shader_type::CubemapDepth:
         return "CubemapDepth";
+    case shader_type::ParaboloidDepth:
+        return "ParaboloidDepth";
+    case shader_type::DepthPrePass:
+        return "DepthPrePass";
+    case shader_type::OITComposite:
+        return "OITComposite";
     case shader_type::Gui:
         return "Gui";
     case shader_type::Quad:
@@ -6,30 +6,89 @@
 #include <string>
 #include <unordered_map>
 #include <glm/glm.hpp>
+#include "shader_cache.h"
 
 enum class shader_type {
     Lit,
     Unlit,
     Water,
+    Terrain,
     Outline,
     Skybox,
-    Screen,
-    Blur,
+    BloomDownsample,
+    BloomUpsample,
+    OITComposite,
     Depth,
     CubemapDepth,
+    ParaboloidDepth,
+    DepthPrePass,
     Gui,
     Instance,
     Quad
 };
 
+// Features of the default.frag permutations, every bit is one #define.
+// Instanced and Terrain pick the vertex stage.
+enum shader_feature : unsigned int {
+    SHADER_FEATURE_LIT = 1 << 0,
+    SHADER_FEATURE_SHADOWS = 1 << 1,
+    SHADER_FEATURE_NORMAL_MAP = 1 << 2,
+    SHADER_FEATURE_SPECULAR_MAP = 1 << 3,
+    SHADER_FEATURE_INSTANCED = 1 << 4,
+    SHADER_FEATURE_TERRAIN = 1 << 5,
+    SHADER_FEATURE_CLIP_PLANE = 1 << 6,
+    // What the Lit, Instance and Terrain shaders are built with: every
+    // branch compiled in and decided by uniforms, so they work for any
+    // material in any pass
+    SHADER_FEATURES_ALL = SHADER_FEATURE_LIT | SHADER_FEATURE_SHADOWS |
+                          SHADER_FEATURE_NORMAL_MAP |
+                          SHADER_FEATURE_SPECULAR_MAP |
+                          SHADER_FEATURE_CLIP_PLANE,
+};
+
+// What Shader_Poll needs to finish a submitted program
+struct shader_build {
+    GLuint Stages[3];
+    int StageCount;
+    // Owns the stages when set
+    shader_cache *Cache;
+    uint64_t CacheName;
+    uint64_t CacheHash;
+};
+
 struct shader {
     GLuint ID;
     std::unordered_map<std::string, GLuint> Uniforms;
+    // Submitted but the link wasn't checked yet, don't use or set uniforms
+    bool Pending;
+    // The link failed, ID is no program anybody can draw with
+    bool Failed;
+    shader_build Build;
 };
 
+// Lets the driver compile on its own threads when it has
+// KHR_parallel_shader_compile (or the ARB version)
+bool Shader_EnableParallelCompile();
+bool Shader_HasExtension(const char *Name);
+// Issues the compiles and the link without waiting for either. Defines are
+// inserted after the #version line of every stage. With a Cache the
+// program comes from its binary when one is still valid, and is ready
+// right away.
+void Shader_Submit(shader &Shader, const char *VertexFile,
+                   const char *FragmentFile,
+                   const char *GeometryFile = nullptr,
+                   const std::string &Defines = "",
+                   shader_cache *Cache = nullptr);
+// Finishes a submitted program once the driver is done with it and returns
+// whether it is ready. Wait blocks, so does any poll without parallel
+// compile support.
+bool Shader_Poll(shader &Shader, bool Wait);
+// Shader_Submit and waits
 void Shader_Create(shader &Shader, const char *VertexFile,
                    const char *FragmentFile,
-                   const char *GeometryFile = nullptr);
+                   const char *GeometryFile = nullptr,
+                   const std::string &Defines = "",
+                   shader_cache *Cache = nullptr);
 void Shader_Delete(shader &Shader);
 void Shader_Use(const shader &Shader);
 GLuint Shader_GetUniform(const shader &Shader, const char *Name);
@@ -45,6 +104,8 @@ void Shader_SetVec4(const shader &Shader, const char *Name,
 void Shader_SetFloat(const shader &Shader, const char *Name, float Value);
 void Shader_SetInt(const shader &Shader, const char *Name, int Value);
 
+std::string Shader_GetFeatureDefines(unsigned int Features);
+
 const char *ToString(shader_type ShaderType);
 
 #endif
@@ -0,0 +1,262 @@
+#include "shader_cache.h"
+#include "shader.h"
+
+#include <GLFW/glfw3.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// glad is generated for 3.3 core, ARB_get_program_binary is loaded here
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void(APIENTRYP get_program_binary_proc)(GLuint Program,
+                                                 GLsizei BufSize,
+                                                 GLsizei *Length,
+                                                 GLenum *Format,
+                                                 void *Binary);
+typedef void(APIENTRYP program_binary_proc)(GLuint Program, GLenum Format,
+                                             const void *Binary,
+                                             GLsizei Length);
+typedef void(APIENTRYP program_parameteri_proc)(GLuint Program,
+                                                 GLenum Name, GLint Value);
+
+static get_program_binary_proc GetProgramBinary;
+static program_binary_proc ProgramBinary;
+static program_parameteri_proc ProgramParameteri;
+
+#define SHADER_CACHE_MAGIC 0x4e494250 // "PBIN"
+#define SHADER_CACHE_VERSION 1
+
+struct shader_cache_header {
+    uint32_t Magic;
+    uint32_t Version;
+    uint64_t Hash;
+    uint32_t Format;
+    uint32_t Length;
+};
+
+// FNV-1a, only has to tell sources apart, not resist anyone
+uint64_t ShaderCache_Hash(const std::string &Data, uint64_t Seed) {
+    return ShaderCache_Hash(Data.data(), Data.size(), Seed);
+}
+
+uint64_t ShaderCache_Hash(const void *Data, size_t Size, uint64_t Seed) {
+    const unsigned char *Bytes = (const unsigned char *)Data;
+    uint64_t Hash = Seed;
+    for (size_t i = 0; i < Size; i++) {
+        Hash ^= Bytes[i];
+        Hash *= 1099511628211ull;
+    }
+    return Hash;
+}
+
+std::string ShaderCache_GetTempPath(const std::string &Path) {
+    char Suffix[48];
+    snprintf(Suffix, sizeof(Suffix), ".%d.%zx.tmp", (int)getpid(),
+             std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return Path + Suffix;
+}
+
+static std::string ShaderCache_GetPath(const shader_cache &Cache,
+                                       uint64_t Name) {
+    char File[32];
+    snprintf(File, sizeof(File), "%016llx.bin", (unsigned long long)Name);
+    return Cache.Directory + "/" + File;
+}
+
+void ShaderCache_Create(shader_cache &Cache, const char *Directory) {
+    Cache.Directory = Directory;
+    Cache.Stages.clear();
+    Cache.ProgramsLoaded = 0;
+    Cache.ProgramsCompiled = 0;
+    Cache.ProgramsStale = 0;
+    Cache.StagesCompiled = 0;
+    Cache.StagesReused = 0;
+    Cache.StartupTime = 0.0f;
+
+    // A binary is only good for the driver that produced it
+    std::string Driver;
+    const GLenum DriverStrings[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum Name : DriverStrings) {
+        const char *Value = (const char *)glGetString(Name);
+        Driver += Value ? Value : "";
+        Driver += '\n';
+    }
+    Cache.DriverHash = ShaderCache_Hash(Driver);
+
+    GLint Major = 0, Minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &Major);
+    glGetIntegerv(GL_MINOR_VERSION, &Minor);
+    bool Supported = Major > 4 || (Major == 4 && Minor >= 1) ||
+                     Shader_HasExtension("GL_ARB_get_program_binary");
+    if (Supported) {
+        GetProgramBinary = (get_program_binary_proc)glfwGetProcAddress(
+            "glGetProgramBinary");
+        ProgramBinary =
+            (program_binary_proc)glfwGetProcAddress("glProgramBinary");
+        ProgramParameteri = (program_parameteri_proc)glfwGetProcAddress(
+            "glProgramParameteri");
+        Supported = GetProgramBinary && ProgramBinary && ProgramParameteri;
+    }
+    if (Supported) {
+        // Some drivers expose the entry points without any format
+        GLint FormatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &FormatCount);
+        Supported = FormatCount > 0;
+    }
+    Cache.BinarySupported = Supported;
+
+    if (Cache.BinarySupported) {
+        std::error_code Error;
+        std::filesystem::create_directories(Cache.Directory, Error);
+        if (Error) {
+            std::cout << "ERROR::SHADER_CACHE::CREATE_DIRECTORY_FAILED "
+                      << Cache.Directory << ": " << Error.message()
+                      << std::endl;
+            Cache.BinarySupported = false;
+        }
+    }
+}
+
+void ShaderCache_Destroy(shader_cache &Cache) {
+    for (const auto &Iter : Cache.Stages) {
+        glDeleteShader(Iter.second.ID);
+    }
+    Cache.Stages.clear();
+}
+
+GLuint ShaderCache_FindStage(shader_cache &Cache, GLenum Type,
+                             const std::string &Code) {
+    auto Range = Cache.Stages.equal_range(ShaderCache_Hash(Code, Type));
+    for (auto Iter = Range.first; Iter != Range.second; ++Iter) {
+        if (Iter->second.Type == Type && Iter->second.Code == Code) {
+            Cache.StagesReused++;
+            return Iter->second.ID;
+        }
+    }
+    return 0;
+}
+
+void ShaderCache_AddStage(shader_cache &Cache, GLenum Type,
+                          const std::string &Code, GLuint Stage) {
+    shader_cache_stage Entry = {.Type = Type, .Code = Code, .ID = Stage};
+    Cache.Stages.insert({ShaderCache_Hash(Code, Type), std::move(Entry)});
+    Cache.StagesCompiled++;
+}
+
+bool ShaderCache_LoadProgram(shader_cache &Cache, uint64_t Name,
+                             uint64_t Hash, GLuint Program) {
+    if (!Cache.BinarySupported) {
+        return false;
+    }
+
+    std::string Path = ShaderCache_GetPath(Cache, Name);
+    std::ifstream File(Path, std::ios::binary);
+    if (!File) {
+        return false;
+    }
+    std::error_code Error;
+    uintmax_t FileSize = std::filesystem::file_size(Path, Error);
+
+    shader_cache_header Header;
+    File.read((char *)&Header, sizeof(Header));
+    if (!File || Header.Magic != SHADER_CACHE_MAGIC ||
+        Header.Version != SHADER_CACHE_VERSION || Header.Hash != Hash) {
+        Cache.ProgramsStale++;
+        return false;
+    }
+    // A damaged header mustn't make us allocate whatever Length says
+    if (Error || Header.Length != FileSize - sizeof(Header)) {
+        Cache.ProgramsStale++;
+        return false;
+    }
+
+    std::vector<char> Binary(Header.Length);
+    File.read(Binary.data(), Binary.size());
+    if (!File) {
+        Cache.ProgramsStale++;
+        return false;
+    }
+
+    // Drivers may still refuse a binary, after an update that didn't
+    // change the version string for example
+    ProgramBinary(Program, Header.Format, Binary.data(),
+                  (GLsizei)Binary.size());
+    GLint Success = 0;
+    glGetProgramiv(Program, GL_LINK_STATUS, &Success);
+    if (!Success) {
+        Cache.ProgramsStale++;
+        return false;
+    }
+
+    Cache.ProgramsLoaded++;
+    return true;
+}
+
+void ShaderCache_PrepareProgram(const shader_cache &Cache, GLuint Program) {
+    if (Cache.BinarySupported) {
+        ProgramParameteri(Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                          GL_TRUE);
+    }
+}
+
+void ShaderCache_StoreProgram(shader_cache &Cache, uint64_t Name,
+                              uint64_t Hash, GLuint Program) {
+    if (!Cache.BinarySupported) {
+        return;
+    }
+
+    GLint Length = 0;
+    glGetProgramiv(Program, GL_PROGRAM_BINARY_LENGTH, &Length);
+    if (Length <= 0) {
+        return;
+    }
+
+    std::vector<char> Binary(Length);
+    GLenum Format = 0;
+    GetProgramBinary(Program, Length, &Length, &Format, Binary.data());
+
+    shader_cache_header Header = {
+        .Magic = SHADER_CACHE_MAGIC,
+        .Version = SHADER_CACHE_VERSION,
+        .Hash = Hash,
+        .Format = Format,
+        .Length = (uint32_t)Length,
+    };
+
+    // Written next to the entry and renamed over it, a crash halfway
+    // through never leaves a truncated binary behind
+    std::string Path = ShaderCache_GetPath(Cache, Name);
+    std::string TempPath = ShaderCache_GetTempPath(Path);
+    std::error_code Error;
+    {
+        std::ofstream File(TempPath, std::ios::binary | std::ios::trunc);
+        File.write((const char *)&Header, sizeof(Header));
+        File.write(Binary.data(), Length);
+        if (!File) {
+            std::cout << "ERROR::SHADER_CACHE::WRITE_FAILED " << TempPath
+                      << std::endl;
+            File.close();
+            std::filesystem::remove(TempPath, Error);
+            return;
+        }
+    }
+    std::filesystem::rename(TempPath, Path, Error);
+    if (Error) {
+        std::cout << "ERROR::SHADER_CACHE::WRITE_FAILED " << Path << ": "
+                  << Error.message() << std::endl;
+        std::filesystem::remove(TempPath, Error);
+    }
+}
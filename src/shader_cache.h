@@ -0,0 +1,65 @@
+#ifndef SHADER_CACHE_H_
+#define SHADER_CACHE_H_
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <map>
+#include <string>
+
+struct shader_cache_stage {
+    GLenum Type;
+    // compared on a hit, the hash alone could hand out the wrong stage
+    std::string Code;
+    GLuint ID;
+};
+
+// Linked programs saved with glGetProgramBinary, one file per program.
+// The header of a file holds a hash of the final stage sources and the
+// driver strings, anything that doesn't match is recompiled and rewritten.
+struct shader_cache {
+    std::string Directory;
+    // GL 4.1 or ARB_get_program_binary, with at least one binary format
+    bool BinarySupported;
+    uint64_t DriverHash;
+    // Compiled stage objects by the hash of type and source, so identical
+    // stages are compiled once per run. Owned by the cache.
+    std::multimap<uint64_t, shader_cache_stage> Stages;
+
+    int ProgramsLoaded;
+    int ProgramsCompiled;
+    // had a file, but the hash didn't match or the driver refused it
+    int ProgramsStale;
+    int StagesCompiled;
+    int StagesReused;
+    // milliseconds ResourceManager_LoadShaders took
+    float StartupTime;
+};
+
+// FNV-1a, Seed chains hashes of several buffers
+#define SHADER_CACHE_HASH_SEED 14695981039346656037ull
+uint64_t ShaderCache_Hash(const std::string &Data,
+                          uint64_t Seed = SHADER_CACHE_HASH_SEED);
+uint64_t ShaderCache_Hash(const void *Data, size_t Size,
+                          uint64_t Seed = SHADER_CACHE_HASH_SEED);
+// Where to write Path before renaming it into place. Unique per process
+// and thread, two writers of the same entry never share a file.
+std::string ShaderCache_GetTempPath(const std::string &Path);
+
+// Needs a current context, queries the driver for binary support
+void ShaderCache_Create(shader_cache &Cache, const char *Directory);
+void ShaderCache_Destroy(shader_cache &Cache);
+// The stage object compiled from Code, 0 when it wasn't compiled yet
+GLuint ShaderCache_FindStage(shader_cache &Cache, GLenum Type,
+                             const std::string &Code);
+void ShaderCache_AddStage(shader_cache &Cache, GLenum Type,
+                          const std::string &Code, GLuint Stage);
+// Name identifies the program, Hash what it was built from. Returns false
+// when there's no usable binary, Program is then left unlinked.
+bool ShaderCache_LoadProgram(shader_cache &Cache, uint64_t Name,
+                             uint64_t Hash, GLuint Program);
+// Before glLinkProgram, asks the driver to keep the binary around
+void ShaderCache_PrepareProgram(const shader_cache &Cache, GLuint Program);
+void ShaderCache_StoreProgram(shader_cache &Cache, uint64_t Name,
+                              uint64_t Hash, GLuint Program);
+
+#endif
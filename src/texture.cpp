@@ -1,8 +1,32 @@
 #include "texture.h"
+#include "async_io.h"
+#include "texture_cache.h"
+#include "texture_mips.h"
 
+#include <GLFW/glfw3.h>
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <string>
+#include <vector>
+
+// EXT_texture_compression_s3tc and its sRGB forms, not in the core loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Set once by Texture_InitCompression, read by the loading threads
+static unsigned int CompressionSupport;
+static bool SRGBCompressionSupported;
 
 static bool Texture_IsColorData(const char *File) {
     std::string Path = File ? File : "";
@@ -19,114 +43,480 @@ static bool Texture_IsColorData(const char *File) {
            Path.find("disp") == std::string::npos;
 }
 
-void Texture_Create(texture *Tex, const char *File, GLenum TexType, GLenum Slot,
-                    GLenum Format, GLenum PixelType) {
+static bool Texture_IsNormalMap(const char *File) {
+    std::string Path = File ? File : "";
+    std::transform(Path.begin(), Path.end(), Path.begin(),
+                   [](unsigned char C) { return std::tolower(C); });
+    return Path.find("normal") != std::string::npos ||
+           Path.find("_ddn") != std::string::npos ||
+           Path.find("_nrm") != std::string::npos;
+}
+
+void Texture_InitCompression(bool Enabled) {
+    CompressionSupport = 0;
+    SRGBCompressionSupported = false;
+    if (!Enabled) {
+        return;
+    }
+    // RGTC is core since 3.0
+    CompressionSupport |= 1 << (int)texture_compression::BC4;
+    CompressionSupport |= 1 << (int)texture_compression::BC5;
+    if (glfwExtensionSupported("GL_EXT_texture_compression_s3tc")) {
+        CompressionSupport |= 1 << (int)texture_compression::BC1;
+        CompressionSupport |= 1 << (int)texture_compression::BC3;
+        SRGBCompressionSupported =
+            glfwExtensionSupported("GL_EXT_texture_sRGB") ||
+            glfwExtensionSupported("GL_EXT_texture_compression_s3tc_srgb");
+    }
+}
+
+bool Texture_IsCompressionSupported(texture_compression Compression,
+                                    bool IsColorData) {
+    if (Compression == texture_compression::None) {
+        return true;
+    }
+    if (IsColorData && (Compression == texture_compression::BC1 ||
+                        Compression == texture_compression::BC3)) {
+        if (!SRGBCompressionSupported) {
+            return false;
+        }
+    }
+    return (CompressionSupport & (1 << (int)Compression)) != 0;
+}
+
+unsigned int Texture_GetCompressionSupport() {
+    // the None bit stands for sRGB BC1/BC3
+    return CompressionSupport | (SRGBCompressionSupported ? 1 : 0);
+}
+
+// Source is the file's bytes, Start when the load was asked for
+static bool Texture_DecodeImage(texture_image &Image, const std::string &File,
+                                bool Flip, const asset_file &Source,
+                                thread_pool *Pool,
+                                std::chrono::steady_clock::time_point Start) {
+    // Grey and alpha is expanded to RGBA, there is no sRGB format with two
+    // channels and BC5 would store it as RG. Only normal maps stay RG.
+    Image.IsNormalMap = Texture_IsNormalMap(File.c_str());
+    int Channels = 0;
+    stbi_info_from_memory(Source.Data, (int)Source.Size, &Image.Width,
+                          &Image.Height, &Channels);
+    int WantedChannels = Channels == 2 && !Image.IsNormalMap ? 4 : 0;
+
+    // per thread, images decode on the workers in parallel
+    stbi_set_flip_vertically_on_load_thread(Flip);
+    unsigned char *Decoded = stbi_load_from_memory(
+        Source.Data, (int)Source.Size, &Image.Width, &Image.Height,
+        &Image.Channels, WantedChannels);
+    if (!Decoded) {
+        TextureCache_CountLoad(false, Start);
+        return false;
+    }
+    if (WantedChannels) {
+        Image.Channels = WantedChannels;
+    }
+    Image.Data = Decoded;
+    Image.IsColorData =
+        Texture_IsColorData(File.c_str()) && !Image.IsNormalMap;
+    Image.Compression = texture_compression::None;
+    TextureMips_Generate(Image, Pool);
+    stbi_image_free(Decoded);
+
+    // Uploaded from the cooked file right away, compressed when the driver
+    // can sample it
+    texture_image Cooked = {};
+    if (TextureCache_Store(Image, File.c_str(), Flip, Pool) &&
+        TextureCache_Load(Cooked, File.c_str(), Flip)) {
+        Texture_FreeImage(Image);
+        Image = Cooked;
+    }
+    TextureCache_CountLoad(false, Start);
+    return true;
+}
+
+bool Texture_LoadImage(texture_image &Image, const char *File, bool Flip,
+                       thread_pool *Pool) {
+    auto Start = std::chrono::steady_clock::now();
+    Image = {};
+    if (TextureCache_Load(Image, File, Flip)) {
+        TextureCache_CountLoad(true, Start);
+        return true;
+    }
+
+    asset_file Source;
+    if (!AssetPack_Read(Source, File)) {
+        TextureCache_CountLoad(false, Start);
+        return false;
+    }
+    return Texture_DecodeImage(Image, File, Flip, Source, Pool, Start);
+}
+
+void Texture_LoadImageAsync(
+    const std::string &File, bool Flip, thread_pool *Pool,
+    std::function<void(texture_image &Image, bool Loaded)> Done) {
+    auto Start = std::chrono::steady_clock::now();
+    texture_image Image = {};
+    if (TextureCache_Load(Image, File.c_str(), Flip)) {
+        TextureCache_CountLoad(true, Start);
+        Done(Image, true);
+        return;
+    }
+
+    AsyncIO_Read(File, [File, Flip, Pool, Start,
+                        Done](asset_file &Source, bool Read) {
+        texture_image Image = {};
+        bool Loaded = false;
+        if (Read) {
+            Loaded =
+                Texture_DecodeImage(Image, File, Flip, Source, Pool, Start);
+        } else {
+            TextureCache_CountLoad(false, Start);
+        }
+        Done(Image, Loaded);
+    });
+}
+
+void Texture_FreeImage(texture_image &Image) {
+    if (Image.Mapping.Data) {
+        MappedFile_Close(Image.Mapping);
+    } else {
+        // the block TextureMips_Generate allocated
+        delete[] Image.Data;
+    }
+    Image.Data = nullptr;
+}
+
+int Texture_GetLevelWidth(const texture_image &Image, int Level) {
+    return std::max(1, Image.Width >> Level);
+}
+
+int Texture_GetLevelHeight(const texture_image &Image, int Level) {
+    return std::max(1, Image.Height >> Level);
+}
+
+int Texture_GetLevelRows(const texture_image &Image, int Level) {
+    int Height = Texture_GetLevelHeight(Image, Level);
+    return Image.Compression == texture_compression::None ? Height
+                                                          : (Height + 3) / 4;
+}
+
+size_t Texture_GetRowSize(const texture_image &Image, int Level) {
+    int Width = Texture_GetLevelWidth(Image, Level);
+    switch (Image.Compression) {
+    case texture_compression::BC1:
+    case texture_compression::BC4:
+        return (size_t)(Width + 3) / 4 * 8;
+    case texture_compression::BC3:
+    case texture_compression::BC5:
+        return (size_t)(Width + 3) / 4 * 16;
+    default:
+        return (size_t)Width * Image.Channels;
+    }
+}
+
+size_t Texture_GetLevelSize(const texture_image &Image, int Level) {
+    return Texture_GetRowSize(Image, Level) *
+           Texture_GetLevelRows(Image, Level);
+}
+
+const unsigned char *Texture_GetLevelData(const texture_image &Image,
+                                          int Level) {
+    return Image.Data + (Level > 0 ? Image.LevelOffsets[Level] : 0);
+}
+
+// GL formats for the image's channel count, sRGB for color data
+void Texture_GetFormats(const texture_image &Image, GLenum &Format,
+                        GLenum &InternalFormat) {
+    switch (Image.Channels) {
+    case 1:
+        Format = GL_RED;
+        InternalFormat = GL_R8;
+        break;
+    case 2:
+        // normal maps, other two channel images are loaded as RGBA
+        Format = GL_RG;
+        InternalFormat = GL_RG8;
+        break;
+    case 3:
+        Format = GL_RGB;
+        InternalFormat = Image.IsColorData ? GL_SRGB8 : GL_RGB8;
+        break;
+    case 4:
+        Format = GL_RGBA;
+        InternalFormat = Image.IsColorData ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        break;
+    default:
+        Format = GL_RGB;
+        InternalFormat = Image.IsColorData ? GL_SRGB8 : GL_RGB8;
+        break;
+    }
+
+    switch (Image.Compression) {
+    case texture_compression::BC1:
+        InternalFormat = Image.IsColorData ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                                           : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        break;
+    case texture_compression::BC3:
+        InternalFormat = Image.IsColorData
+                             ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                             : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        break;
+    case texture_compression::BC4:
+        InternalFormat = GL_COMPRESSED_RED_RGTC1;
+        break;
+    case texture_compression::BC5:
+        InternalFormat = GL_COMPRESSED_RG_RGTC2;
+        break;
+    default:
+        break;
+    }
+}
+
+// Video memory of every level, the driver's mips included. Uncompressed
+// counts the image as if it weren't.
+static size_t Texture_GetMemorySize(const texture_image &Image,
+                                    bool Uncompressed) {
+    if (!Image.Data) {
+        return 0;
+    }
+    texture_image Levels = Image;
+    if (Uncompressed) {
+        Levels.Compression = texture_compression::None;
+    }
+    int LevelCount = Image.LevelCount;
+    if (LevelCount == 0) {
+        LevelCount = 1;
+        while ((Image.Width >> LevelCount) > 0 ||
+               (Image.Height >> LevelCount) > 0) {
+            LevelCount++;
+        }
+    }
+    size_t Size = 0;
+    for (int Level = 0; Level < LevelCount; Level++) {
+        Size += Texture_GetLevelSize(Levels, Level);
+    }
+    return Size;
+}
+
+// On the bound texture
+static void Texture_SetParameters(GLenum TexType, GLenum Format) {
+    glTexParameteri(TexType, GL_TEXTURE_WRAP_S,
+                    Format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(TexType, GL_TEXTURE_WRAP_T,
+                    Format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+    glTexParameteri(TexType, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(TexType, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void Texture_Upload(texture *Tex, const texture_image &Image, GLenum TexType,
+                    GLenum Slot, GLenum PixelType) {
+    auto Start = std::chrono::steady_clock::now();
     Tex->Type = TexType;
     Tex->Repeat = glm::vec2(1.0);
 
-    // tell stb_image.h to flip loaded texture's on the y-axis.
-    stbi_set_flip_vertically_on_load(true);
-
     glGenTextures(1, &Tex->ID);
     glActiveTexture(Slot);
     glBindTexture(Tex->Type, Tex->ID);
 
-    // load and generate the texture
-    int Width, Height, NrChannels;
-    unsigned char *Data = stbi_load(File, &Width, &Height, &NrChannels, 0);
-    if (Data) {
+    Tex->Size = Texture_GetMemorySize(Image, false);
+    Tex->UncompressedSize = Texture_GetMemorySize(Image, true);
+    if (Image.Data && Image.LevelCount > 0) {
+        // loaded images come with every level, generated or cooked
+        GLenum Format;
         GLenum InternalFormat;
-        bool IsColorData = Texture_IsColorData(File);
-        switch (NrChannels) {
-        case 1:
-            Format = GL_RED;
-            InternalFormat = GL_R8;
-            break;
-        case 3:
-            Format = GL_RGB;
-            InternalFormat = IsColorData ? GL_SRGB8 : GL_RGB8;
-            break;
-        case 4:
-            Format = GL_RGBA;
-            InternalFormat = IsColorData ? GL_SRGB8_ALPHA8 : GL_RGBA8;
-            break;
-        default:
-            Format = GL_RGB;
-            InternalFormat = IsColorData ? GL_SRGB8 : GL_RGB8;
-            break;
+        Texture_GetFormats(Image, Format, InternalFormat);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int Level = 0; Level < Image.LevelCount; Level++) {
+            int Width = Texture_GetLevelWidth(Image, Level);
+            int Height = Texture_GetLevelHeight(Image, Level);
+            const unsigned char *Data = Texture_GetLevelData(Image, Level);
+            if (Image.Compression != texture_compression::None) {
+                glCompressedTexImage2D(Tex->Type, Level, InternalFormat,
+                                       Width, Height, 0,
+                                       Texture_GetLevelSize(Image, Level),
+                                       Data);
+            } else {
+                glTexImage2D(Tex->Type, Level, InternalFormat, Width, Height,
+                             0, Format, PixelType, Data);
+            }
         }
-        glTexImage2D(Tex->Type, 0, InternalFormat, Width, Height, 0, Format,
-                     PixelType, Data);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(Tex->Type, GL_TEXTURE_MAX_LEVEL,
+                        Image.LevelCount - 1);
+        Texture_SetParameters(Tex->Type, Format);
+    } else if (Image.Data) {
+        GLenum Format;
+        GLenum InternalFormat;
+        Texture_GetFormats(Image, Format, InternalFormat);
+        glTexImage2D(Tex->Type, 0, InternalFormat, Image.Width, Image.Height,
+                     0, Format, PixelType, Image.Data);
+        // built by hand, not loaded
         glGenerateMipmap(Tex->Type);
 
         // set the texture wrapping/filtering options (on the currently bound
         // texture object)
-        glTexParameteri(Tex->Type, GL_TEXTURE_WRAP_S,
-                        Format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(Tex->Type, GL_TEXTURE_WRAP_T,
-                        Format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(Tex->Type, GL_TEXTURE_MIN_FILTER,
-                        GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(Tex->Type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        Texture_SetParameters(Tex->Type, Format);
     } else {
         std::cout << "Failed to load texture" << std::endl;
     }
-    stbi_image_free(Data);
 
     // Unbinds the OpenGL Texture object so that it can't accidentally be
     // modified
     glBindTexture(Tex->Type, 0);
+
+    std::chrono::duration<float, std::milli> Elapsed =
+        std::chrono::steady_clock::now() - Start;
+    TextureCache_CountUpload(Elapsed.count());
 }
 
-void Texture_CreateCubemap(texture *Tex, std::vector<std::string> Faces) {
+void Texture_Allocate(texture *Tex, const texture_image &Image) {
+    Tex->Type = GL_TEXTURE_2D;
+    Tex->Repeat = glm::vec2(1.0);
+
+    GLenum Format;
+    GLenum InternalFormat;
+    Texture_GetFormats(Image, Format, InternalFormat);
+
+    Tex->Size = Texture_GetMemorySize(Image, false);
+    Tex->UncompressedSize = Texture_GetMemorySize(Image, true);
+
+    int LevelCount = std::max(1, Image.LevelCount);
+    glGenTextures(1, &Tex->ID);
+    glBindTexture(Tex->Type, Tex->ID);
+    for (int Level = 0; Level < LevelCount; Level++) {
+        int Width = Texture_GetLevelWidth(Image, Level);
+        int Height = Texture_GetLevelHeight(Image, Level);
+        if (Image.Compression != texture_compression::None) {
+            // compressed levels can't be allocated without data
+            std::vector<unsigned char> Zeros(
+                Texture_GetLevelSize(Image, Level));
+            glCompressedTexImage2D(Tex->Type, Level, InternalFormat, Width,
+                                   Height, 0, Zeros.size(), Zeros.data());
+        } else {
+            glTexImage2D(Tex->Type, Level, InternalFormat, Width, Height, 0,
+                         Format, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    if (LevelCount > 1) {
+        glTexParameteri(Tex->Type, GL_TEXTURE_MAX_LEVEL, LevelCount - 1);
+    }
+    Texture_SetParameters(Tex->Type, Format);
+    glBindTexture(Tex->Type, 0);
+}
+
+void Texture_UploadRows(texture *Tex, const texture_image &Image, int Level,
+                        int FirstRow, int RowCount, const void *Pixels) {
+    GLenum Format;
+    GLenum InternalFormat;
+    Texture_GetFormats(Image, Format, InternalFormat);
+
+    glBindTexture(Tex->Type, Tex->ID);
+    int Width = Texture_GetLevelWidth(Image, Level);
+    if (Image.Compression != texture_compression::None) {
+        // block rows, the last one may cover less than 4 pixel rows
+        int Height = Texture_GetLevelHeight(Image, Level);
+        int Y = FirstRow * 4;
+        glCompressedTexSubImage2D(
+            Tex->Type, Level, 0, Y, Width, std::min(RowCount * 4, Height - Y),
+            InternalFormat, Texture_GetRowSize(Image, Level) * RowCount,
+            Pixels);
+    } else {
+        // rows are tightly packed, RGB widths aren't always a multiple of 4
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(Tex->Type, Level, 0, FirstRow, Width, RowCount,
+                        Format, GL_UNSIGNED_BYTE, Pixels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    glBindTexture(Tex->Type, 0);
+}
+
+void Texture_FinishUpload(texture *Tex, const texture_image &Image) {
+    if (Image.LevelCount > 0) {
+        return;
+    }
+    glBindTexture(Tex->Type, Tex->ID);
+    glGenerateMipmap(Tex->Type);
+    glBindTexture(Tex->Type, 0);
+}
+
+void Texture_Create(texture *Tex, const char *File, GLenum TexType, GLenum Slot,
+                    GLenum Format, GLenum PixelType, thread_pool *Pool) {
+    // tell stb_image.h to flip loaded texture's on the y-axis.
+    texture_image Image;
+    Texture_LoadImage(Image, File, true, Pool);
+    Texture_Upload(Tex, Image, TexType, Slot, PixelType);
+    Texture_FreeImage(Image);
+}
+
+void Texture_UploadCubemap(texture *Tex,
+                           const std::vector<texture_image> &Faces) {
     Tex->Type = GL_TEXTURE_CUBE_MAP;
+    Tex->Size = 0;
+    Tex->UncompressedSize = 0;
 
     glGenTextures(1, &Tex->ID);
     glBindTexture(GL_TEXTURE_CUBE_MAP, Tex->ID);
 
-    stbi_set_flip_vertically_on_load(false);
-
-    int Width, Height, NrChannels;
-    GLenum Format;
+    // every face brings its mip chain, the shortest one decides
+    int LevelCount = TEXTURE_MAX_LEVELS;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     for (unsigned int i = 0; i < Faces.size(); i++) {
-        unsigned char *data =
-            stbi_load(Faces[i].c_str(), &Width, &Height, &NrChannels, 0);
-        if (data) {
-            GLenum InternalFormat;
-            switch (NrChannels) {
-            case 1:
-                Format = GL_RED;
-                InternalFormat = GL_R8;
-                break;
-            case 3:
-                Format = GL_RGB;
-                InternalFormat = GL_SRGB8;
-                break;
-            case 4:
-                Format = GL_RGBA;
-                InternalFormat = GL_SRGB8_ALPHA8;
-                break;
-            default:
-                Format = GL_RGB;
-                InternalFormat = GL_SRGB8;
-                break;
+        const texture_image &Face = Faces[i];
+        if (!Face.Data) {
+            continue;
+        }
+        GLenum Format;
+        GLenum InternalFormat;
+        Texture_GetFormats(Face, Format, InternalFormat);
+        LevelCount = std::min(LevelCount, std::max(1, Face.LevelCount));
+        for (int Level = 0; Level < std::max(1, Face.LevelCount); Level++) {
+            int Width = Texture_GetLevelWidth(Face, Level);
+            int Height = Texture_GetLevelHeight(Face, Level);
+            const unsigned char *Data = Texture_GetLevelData(Face, Level);
+            if (Face.Compression != texture_compression::None) {
+                glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                                       Level, InternalFormat, Width, Height,
+                                       0, Texture_GetLevelSize(Face, Level),
+                                       Data);
+            } else {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, Level,
+                             InternalFormat, Width, Height, 0, Format,
+                             GL_UNSIGNED_BYTE, Data);
             }
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, InternalFormat,
-                         Width, Height, 0, Format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap tex failed to load at path: " << Faces[i]
-                      << std::endl;
-            stbi_image_free(data);
         }
+        Tex->Size += Texture_GetMemorySize(Face, false);
+        Tex->UncompressedSize += Texture_GetMemorySize(Face, true);
     }
-    glTexParameteri(Tex->Type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(Tex->Type, GL_TEXTURE_MAX_LEVEL, LevelCount - 1);
+    glTexParameteri(Tex->Type, GL_TEXTURE_MIN_FILTER,
+                    LevelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(Tex->Type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(Tex->Type, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(Tex->Type, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(Tex->Type, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 }
 
+void Texture_CreateCubemap(texture *Tex, std::vector<std::string> Faces,
+                           thread_pool *Pool) {
+    // a face per job, each one spreads its levels over the pool too
+    std::vector<texture_image> Images(Faces.size());
+    ThreadPool_ParallelFor(
+        Pool, (int)Faces.size(), 1, [&](int Begin, int End) {
+            for (int i = Begin; i < End; i++) {
+                if (!Texture_LoadImage(Images[i], Faces[i].c_str(), false,
+                                       Pool)) {
+                    std::cout << "Cubemap tex failed to load at path: "
+                              << Faces[i] << std::endl;
+                }
+            }
+        });
+    Texture_UploadCubemap(Tex, Images);
+    for (texture_image &Image : Images) {
+        Texture_FreeImage(Image);
+    }
+}
+
 void Texture_Uniform(GLuint ShaderID, const char *Uniform, GLuint Unit) {
     GLuint TexUni = glGetUniformLocation(ShaderID, Uniform);
     glUseProgram(ShaderID);
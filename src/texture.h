@@ -1,10 +1,14 @@
 #ifndef TEXTURE_H_
 #define TEXTURE_H_
 
+#include "mapped_file.h"
 #include "stb_image.h"
+#include "thread_pool.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <functional>
 #include <iostream>
+#include <string>
 
 struct texture {
     GLuint ID;
@@ -12,11 +16,95 @@ struct texture {
     std::string Name;
     std::string Path;
     glm::vec<2, float> Repeat;
+    // bytes of video memory with every level, and what they would be
+    // uncompressed
+    size_t Size;
+    size_t UncompressedSize;
 };
 
+// 4x4 block formats: BC1 opaque color, BC3 color with alpha, BC4 one
+// channel, BC5 two channel normal maps, Z is rebuilt in the shaders
+enum class texture_compression { None, BC1, BC3, BC4, BC5 };
+
+// 4096 wide and high down to 1x1
+#define TEXTURE_MAX_LEVELS 13
+
+// Decoded pixels. Loading touches no GL so it can run on any thread, the
+// upload has to happen on the GL one.
+struct texture_image {
+    // level 0, tightly packed rows
+    unsigned char *Data;
+    int Width;
+    int Height;
+    int Channels;
+    // sRGB unless the file name says it's a data map
+    bool IsColorData;
+    bool IsNormalMap;
+    // Levels are rows of 4x4 blocks instead of pixels when compressed
+    texture_compression Compression;
+    // Loaded images come with their whole mip chain, levels follow Data at
+    // LevelOffsets. Data points into Mapping (read only) for images from the
+    // texture cache. Images built by hand have LevelCount 0, the driver
+    // builds their mips.
+    int LevelCount;
+    size_t LevelOffsets[TEXTURE_MAX_LEVELS];
+    mapped_file Mapping;
+};
+
+// Needs a current context, before anything is loaded. Checks which block
+// formats the driver samples, Enabled false keeps every texture
+// uncompressed.
+void Texture_InitCompression(bool Enabled);
+bool Texture_IsCompressionSupported(texture_compression Compression,
+                                    bool IsColorData);
+// Bits of 1 << texture_compression the driver samples, the None bit set
+// when BC1 and BC3 come in sRGB too
+unsigned int Texture_GetCompressionSupport();
+
+// From the texture cache when it has the file, otherwise decoded and
+// cooked into the cache for the next launch. Pool helps compress the
+// cooked levels, null does it on the calling thread.
+bool Texture_LoadImage(texture_image &Image, const char *File, bool Flip,
+                       thread_pool *Pool = nullptr);
+// Texture_LoadImage without waiting on the file. The cache is checked on
+// the calling thread, a miss reads the source through AsyncIO_Read and
+// decodes it on the worker that gets the completion. Done is called with
+// the image either way, Loaded false when it couldn't be read.
+void Texture_LoadImageAsync(
+    const std::string &File, bool Flip, thread_pool *Pool,
+    std::function<void(texture_image &Image, bool Loaded)> Done);
+void Texture_FreeImage(texture_image &Image);
+// Format is the pixel layout, InternalFormat the compressed one when the
+// image is
+void Texture_GetFormats(const texture_image &Image, GLenum &Format,
+                        GLenum &InternalFormat);
+int Texture_GetLevelWidth(const texture_image &Image, int Level);
+int Texture_GetLevelHeight(const texture_image &Image, int Level);
+// Rows of pixels, or of blocks when compressed, and their size in bytes
+int Texture_GetLevelRows(const texture_image &Image, int Level);
+size_t Texture_GetRowSize(const texture_image &Image, int Level);
+size_t Texture_GetLevelSize(const texture_image &Image, int Level);
+const unsigned char *Texture_GetLevelData(const texture_image &Image,
+                                          int Level);
+void Texture_Upload(texture *Tex, const texture_image &Image, GLenum TexType,
+                    GLenum Slot, GLenum PixelType);
+// Row by row uploads for streaming: Allocate creates the levels without
+// pixels, UploadRows fills rows of a level (see Texture_GetLevelRows) from
+// Pixels, an offset into the bound GL_PIXEL_UNPACK_BUFFER when there is
+// one, FinishUpload builds the mips the image didn't bring
+void Texture_Allocate(texture *Tex, const texture_image &Image);
+void Texture_UploadRows(texture *Tex, const texture_image &Image, int Level,
+                        int FirstRow, int RowCount, const void *Pixels);
+void Texture_FinishUpload(texture *Tex, const texture_image &Image);
+void Texture_UploadCubemap(texture *Tex,
+                           const std::vector<texture_image> &Faces);
+// Load and upload in one go, on the GL thread. The mips are generated on
+// the CPU (see TextureMips_Generate) or come from the texture cache.
 void Texture_Create(texture *Tex, const char *File, GLenum TexType, GLenum Slot,
-                    GLenum Format, GLenum PixelType);
-void Texture_CreateCubemap(texture *Tex, std::vector<std::string> Faces);
+                    GLenum Format, GLenum PixelType,
+                    thread_pool *Pool = nullptr);
+void Texture_CreateCubemap(texture *Tex, std::vector<std::string> Faces,
+                           thread_pool *Pool = nullptr);
 void Texture_Bind(texture *Tex, GLenum Slot);
 void Texture_Uniform(GLuint ShaderID, const char *Uniform, GLuint Unit);
 void Texture_Delete(texture *Tex);
@@ -0,0 +1,241 @@
+#include "texture_cache.h"
+#include "asset_pack.h"
+#include "shader_cache.h"
+#include "texture_compress.h"
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#define TEXTURE_CACHE_MAGIC 0x43584554 // "TEXC"
+#define TEXTURE_CACHE_VERSION 4
+#define TEXTURE_CACHE_ALIGNMENT 16
+
+struct texture_cache_header {
+    uint32_t Magic;
+    uint32_t Version;
+    // stamp of the source file the entry was cooked from
+    uint64_t SourceSize;
+    int64_t SourceTime;
+    // a truncated write never matches
+    uint64_t FileSize;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Channels;
+    uint32_t LevelCount;
+    uint32_t InternalFormat;
+    uint32_t Format;
+    uint32_t IsColorData;
+    uint32_t IsNormalMap;
+    uint32_t Compression;
+    // Texture_GetCompressionSupport at cook time, a driver that samples
+    // other formats cooks again
+    uint32_t CompressionSupport;
+    // from the start of the file, levels are tightly packed rows of pixels
+    // or blocks
+    uint64_t LevelOffsets[TEXTURE_MAX_LEVELS];
+};
+
+// Microseconds, atomics since images load on every worker at once
+static std::atomic<int> Hits;
+static std::atomic<int> Misses;
+static std::atomic<long long> LoadTime;
+static std::atomic<long long> DecodeTime;
+static std::atomic<long long> UploadTime;
+
+static std::string TextureCache_GetPath(const char *File, bool Flip) {
+    std::string Key = std::string(File) + (Flip ? "#flipped" : "");
+    char Name[32];
+    snprintf(Name, sizeof(Name), "%016llx.tex",
+             (unsigned long long)ShaderCache_Hash(Key));
+    return std::string(TEXTURE_CACHE_DIRECTORY) + "/" + Name;
+}
+
+bool TextureCache_Load(texture_image &Image, const char *File, bool Flip) {
+    uint64_t SourceSize;
+    int64_t SourceTime;
+    if (!AssetPack_Stat(File, SourceSize, SourceTime)) {
+        return false;
+    }
+
+    mapped_file Mapping;
+    if (!MappedFile_Open(Mapping, TextureCache_GetPath(File, Flip).c_str())) {
+        return false;
+    }
+    const texture_cache_header &Header =
+        *(const texture_cache_header *)Mapping.Data;
+    bool Valid =
+        Mapping.Size >= sizeof(texture_cache_header) &&
+        Header.Magic == TEXTURE_CACHE_MAGIC &&
+        Header.Version == TEXTURE_CACHE_VERSION &&
+        Header.SourceSize == SourceSize && Header.SourceTime == SourceTime &&
+        Header.FileSize == Mapping.Size && Header.Width > 0 &&
+        Header.Height > 0 && Header.Channels >= 1 && Header.Channels <= 4 &&
+        Header.LevelCount >= 1 && Header.LevelCount <= TEXTURE_MAX_LEVELS &&
+        Header.Compression <= (uint32_t)texture_compression::BC5 &&
+        Header.CompressionSupport == Texture_GetCompressionSupport();
+    if (!Valid) {
+        MappedFile_Close(Mapping);
+        return false;
+    }
+
+    texture_image Cooked = {};
+    Cooked.Width = Header.Width;
+    Cooked.Height = Header.Height;
+    Cooked.Channels = Header.Channels;
+    Cooked.IsColorData = Header.IsColorData != 0;
+    Cooked.IsNormalMap = Header.IsNormalMap != 0;
+    Cooked.Compression = (texture_compression)Header.Compression;
+    Cooked.LevelCount = Header.LevelCount;
+    for (uint32_t Level = 0; Valid && Level < Header.LevelCount; Level++) {
+        size_t Size = Texture_GetLevelSize(Cooked, Level);
+        Valid = Header.LevelOffsets[Level] <= Mapping.Size &&
+                Size <= Mapping.Size - Header.LevelOffsets[Level];
+    }
+    if (!Valid) {
+        MappedFile_Close(Mapping);
+        return false;
+    }
+
+    // read only, the mapping is
+    Cooked.Data = (unsigned char *)Mapping.Data + Header.LevelOffsets[0];
+    for (uint32_t Level = 0; Level < Header.LevelCount; Level++) {
+        Cooked.LevelOffsets[Level] =
+            Header.LevelOffsets[Level] - Header.LevelOffsets[0];
+    }
+    Cooked.Mapping = Mapping;
+
+    // cooked by another build with other format rules
+    GLenum Format;
+    GLenum InternalFormat;
+    Texture_GetFormats(Cooked, Format, InternalFormat);
+    if (Format != Header.Format || InternalFormat != Header.InternalFormat) {
+        Texture_FreeImage(Cooked);
+        return false;
+    }
+    Image = Cooked;
+    return true;
+}
+
+bool TextureCache_Store(const texture_image &Image, const char *File,
+                        bool Flip, thread_pool *Pool) {
+    texture_cache_header Header = {};
+    if (!Image.Data || Image.LevelCount < 1 ||
+        !AssetPack_Stat(File, Header.SourceSize, Header.SourceTime)) {
+        return false;
+    }
+
+    texture_image Cooked = Image;
+    Cooked.Compression = TextureCompress_Choose(Image);
+    GLenum Format;
+    GLenum InternalFormat;
+    Texture_GetFormats(Cooked, Format, InternalFormat);
+    Header.Magic = TEXTURE_CACHE_MAGIC;
+    Header.Version = TEXTURE_CACHE_VERSION;
+    Header.Width = Image.Width;
+    Header.Height = Image.Height;
+    Header.Channels = Image.Channels;
+    Header.LevelCount = Cooked.LevelCount;
+    Header.InternalFormat = InternalFormat;
+    Header.Format = Format;
+    Header.IsColorData = Image.IsColorData;
+    Header.IsNormalMap = Image.IsNormalMap;
+    Header.Compression = (uint32_t)Cooked.Compression;
+    Header.CompressionSupport = Texture_GetCompressionSupport();
+
+    uint64_t Offset = (sizeof(Header) + TEXTURE_CACHE_ALIGNMENT - 1) &
+                      ~(uint64_t)(TEXTURE_CACHE_ALIGNMENT - 1);
+    for (uint32_t Level = 0; Level < Header.LevelCount; Level++) {
+        Header.LevelOffsets[Level] = Offset;
+        Offset += Texture_GetLevelSize(Cooked, Level);
+    }
+    Header.FileSize = Offset;
+
+    // Levels as they go in the file
+    std::vector<const unsigned char *> Pixels(Header.LevelCount);
+    for (uint32_t Level = 0; Level < Header.LevelCount; Level++) {
+        Pixels[Level] = Texture_GetLevelData(Image, Level);
+    }
+    std::vector<std::vector<unsigned char>> Blocks(Header.LevelCount);
+    if (Cooked.Compression != texture_compression::None) {
+        for (uint32_t Level = 0; Level < Header.LevelCount; Level++) {
+            Blocks[Level].resize(Texture_GetLevelSize(Cooked, Level));
+            TextureCompress_Encode(Cooked, Pixels[Level],
+                                   Texture_GetLevelWidth(Image, Level),
+                                   Texture_GetLevelHeight(Image, Level),
+                                   Blocks[Level].data(), Pool);
+            Pixels[Level] = Blocks[Level].data();
+        }
+    }
+
+    std::error_code Error;
+    std::filesystem::create_directories(TEXTURE_CACHE_DIRECTORY, Error);
+    if (Error) {
+        std::cout << "ERROR::TEXTURE_CACHE::CREATE_DIRECTORY_FAILED "
+                  << TEXTURE_CACHE_DIRECTORY << ": " << Error.message()
+                  << std::endl;
+        return false;
+    }
+
+    // Written next to the entry and renamed over it, like the shader cache.
+    // Two workers may cook the same file, each writes its own temp file.
+    std::string Path = TextureCache_GetPath(File, Flip);
+    std::string TempPath = ShaderCache_GetTempPath(Path);
+    {
+        std::ofstream Output(TempPath, std::ios::binary | std::ios::trunc);
+        const char Zeros[TEXTURE_CACHE_ALIGNMENT] = {};
+        Output.write((const char *)&Header, sizeof(Header));
+        Output.write(Zeros, Header.LevelOffsets[0] - sizeof(Header));
+        for (uint32_t Level = 0; Level < Header.LevelCount; Level++) {
+            Output.write((const char *)Pixels[Level],
+                         Texture_GetLevelSize(Cooked, Level));
+        }
+        if (!Output) {
+            std::cout << "ERROR::TEXTURE_CACHE::WRITE_FAILED " << TempPath
+                      << std::endl;
+            Output.close();
+            std::filesystem::remove(TempPath, Error);
+            return false;
+        }
+    }
+    std::filesystem::rename(TempPath, Path, Error);
+    if (Error) {
+        std::cout << "ERROR::TEXTURE_CACHE::WRITE_FAILED " << Path << ": "
+                  << Error.message() << std::endl;
+        std::filesystem::remove(TempPath, Error);
+        return false;
+    }
+    return true;
+}
+
+void TextureCache_CountLoad(bool Hit,
+                            std::chrono::steady_clock::time_point Start) {
+    long long Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - Start)
+                            .count();
+    if (Hit) {
+        Hits++;
+        LoadTime += Elapsed;
+    } else {
+        Misses++;
+        DecodeTime += Elapsed;
+    }
+}
+
+void TextureCache_CountUpload(float Time) {
+    UploadTime += (long long)(Time * 1000.0f);
+}
+
+texture_cache_stats TextureCache_GetStats() {
+    texture_cache_stats Stats = {
+        .Hits = Hits,
+        .Misses = Misses,
+        .LoadTime = LoadTime / 1000.0f,
+        .DecodeTime = DecodeTime / 1000.0f,
+        .UploadTime = UploadTime / 1000.0f,
+    };
+    return Stats;
+}
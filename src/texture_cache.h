@@ -0,0 +1,38 @@
+#ifndef TEXTURE_CACHE_H_
+#define TEXTURE_CACHE_H_
+
+#include <chrono>
+#include "texture.h"
+
+// Cooked images under ./cache/textures, one file per source image and flip.
+// A file holds the whole mip chain in the GL format it is uploaded in,
+// block compressed where possible, so a hit neither decodes nor has the
+// driver build mips. An entry goes stale
+// when the source's size or modification time changes.
+#define TEXTURE_CACHE_DIRECTORY "./cache/textures"
+
+struct texture_cache_stats {
+    int Hits;
+    int Misses;
+    // milliseconds summed over the loading threads, for hits and for misses
+    // (decode and cook)
+    float LoadTime;
+    float DecodeTime;
+    // milliseconds in Texture_Upload on the GL thread
+    float UploadTime;
+};
+
+// Maps the cooked file of File into Image, false when missing or stale
+bool TextureCache_Load(texture_image &Image, const char *File, bool Flip);
+// Compresses the mip chain of a freshly loaded Image when the driver
+// samples a fitting block format (Pool helps, may be null) and writes it
+// out
+bool TextureCache_Store(const texture_image &Image, const char *File,
+                        bool Flip, thread_pool *Pool);
+// Any thread
+void TextureCache_CountLoad(bool Hit,
+                            std::chrono::steady_clock::time_point Start);
+void TextureCache_CountUpload(float Time);
+texture_cache_stats TextureCache_GetStats();
+
+#endif
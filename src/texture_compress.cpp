@@ -0,0 +1,288 @@
+#include "texture_compress.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESS_SSE2
+#endif
+
+texture_compression TextureCompress_Choose(const texture_image &Image) {
+    texture_compression Compression = texture_compression::BC1;
+    if (Image.IsNormalMap && Image.Channels >= 2) {
+        Compression = texture_compression::BC5;
+    } else if (Image.Channels == 1) {
+        Compression = texture_compression::BC4;
+    } else if (Image.Channels == 2) {
+        // not a normal map, BC5 would treat its alpha as green
+        Compression = texture_compression::None;
+    } else if (Image.Channels == 4) {
+        size_t Count = (size_t)Image.Width * Image.Height;
+        for (size_t i = 0; i < Count; i++) {
+            if (Image.Data[i * 4 + 3] != 255) {
+                Compression = texture_compression::BC3;
+                break;
+            }
+        }
+    }
+    return Texture_IsCompressionSupported(Compression, Image.IsColorData)
+               ? Compression
+               : texture_compression::None;
+}
+
+// The 4x4 texels of a block as RGBA, edge texels repeat past the level
+static void TextureCompress_FetchBlock(const unsigned char *Pixels, int Width,
+                                       int Height, int Channels, int BlockX,
+                                       int BlockY, unsigned char *Block) {
+    for (int y = 0; y < 4; y++) {
+        int Y = std::min(BlockY * 4 + y, Height - 1);
+        for (int x = 0; x < 4; x++) {
+            int X = std::min(BlockX * 4 + x, Width - 1);
+            const unsigned char *Pixel =
+                Pixels + ((size_t)Y * Width + X) * Channels;
+            unsigned char *Texel = Block + (y * 4 + x) * 4;
+            Texel[0] = Pixel[0];
+            Texel[1] = Channels > 1 ? Pixel[1] : 0;
+            Texel[2] = Channels > 2 ? Pixel[2] : 0;
+            Texel[3] = Channels > 3 ? Pixel[3] : 255;
+        }
+    }
+}
+
+// Per channel minimum and maximum over the block
+static void TextureCompress_GetBounds(const unsigned char *Block,
+                                      unsigned char *Min,
+                                      unsigned char *Max) {
+#ifdef TEXTURE_COMPRESS_SSE2
+    __m128i Row0 = _mm_loadu_si128((const __m128i *)(Block + 0));
+    __m128i Row1 = _mm_loadu_si128((const __m128i *)(Block + 16));
+    __m128i Row2 = _mm_loadu_si128((const __m128i *)(Block + 32));
+    __m128i Row3 = _mm_loadu_si128((const __m128i *)(Block + 48));
+    __m128i Low =
+        _mm_min_epu8(_mm_min_epu8(Row0, Row1), _mm_min_epu8(Row2, Row3));
+    __m128i High =
+        _mm_max_epu8(_mm_max_epu8(Row0, Row1), _mm_max_epu8(Row2, Row3));
+    // fold the four texels of each register into the first one
+    Low = _mm_min_epu8(Low, _mm_srli_si128(Low, 8));
+    Low = _mm_min_epu8(Low, _mm_srli_si128(Low, 4));
+    High = _mm_max_epu8(High, _mm_srli_si128(High, 8));
+    High = _mm_max_epu8(High, _mm_srli_si128(High, 4));
+    int Packed = _mm_cvtsi128_si32(Low);
+    memcpy(Min, &Packed, 4);
+    Packed = _mm_cvtsi128_si32(High);
+    memcpy(Max, &Packed, 4);
+#else
+    for (int c = 0; c < 4; c++) {
+        Min[c] = 255;
+        Max[c] = 0;
+    }
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            Min[c] = std::min(Min[c], Block[i * 4 + c]);
+            Max[c] = std::max(Max[c], Block[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+// Dot products of the texels' RGB, relative to Origin, with Axis
+static void TextureCompress_Project(const unsigned char *Block,
+                                    const int *Origin, const int *Axis,
+                                    int *Dots) {
+#ifdef TEXTURE_COMPRESS_SSE2
+    __m128i Zero = _mm_setzero_si128();
+    __m128i Base = _mm_setr_epi16(Origin[0], Origin[1], Origin[2], 0,
+                                  Origin[0], Origin[1], Origin[2], 0);
+    __m128i Direction = _mm_setr_epi16(Axis[0], Axis[1], Axis[2], 0, Axis[0],
+                                       Axis[1], Axis[2], 0);
+    for (int i = 0; i < 4; i++) {
+        __m128i Texels = _mm_loadu_si128((const __m128i *)(Block + i * 16));
+        __m128i Pairs[2] = {_mm_unpacklo_epi8(Texels, Zero),
+                            _mm_unpackhi_epi8(Texels, Zero)};
+        for (int j = 0; j < 2; j++) {
+            // r * x + g * y and b * z of two texels, then summed per texel
+            __m128i Sums = _mm_madd_epi16(_mm_sub_epi16(Pairs[j], Base),
+                                          Direction);
+            Sums = _mm_add_epi32(
+                Sums, _mm_shuffle_epi32(Sums, _MM_SHUFFLE(2, 3, 0, 1)));
+            Dots[i * 4 + j * 2] = _mm_cvtsi128_si32(Sums);
+            Dots[i * 4 + j * 2 + 1] =
+                _mm_cvtsi128_si32(_mm_srli_si128(Sums, 8));
+        }
+    }
+#else
+    for (int i = 0; i < 16; i++) {
+        Dots[i] = 0;
+        for (int c = 0; c < 3; c++) {
+            Dots[i] += (Block[i * 4 + c] - Origin[c]) * Axis[c];
+        }
+    }
+#endif
+}
+
+static uint16_t TextureCompress_To565(const int *Color) {
+    return (uint16_t)(((Color[0] >> 3) << 11) | ((Color[1] >> 2) << 5) |
+                      (Color[2] >> 3));
+}
+
+// What the GPU decodes the endpoint to
+static void TextureCompress_From565(uint16_t Packed, int *Color) {
+    int R = (Packed >> 11) & 31;
+    int G = (Packed >> 5) & 63;
+    int B = Packed & 31;
+    Color[0] = (R << 3) | (R >> 2);
+    Color[1] = (G << 2) | (G >> 4);
+    Color[2] = (B << 3) | (B >> 2);
+}
+
+// 8 bytes: two 565 endpoints, Color0 > Color1 for the four color mode, and
+// a 2 bit palette index per texel
+static void TextureCompress_EncodeBC1(const unsigned char *Block,
+                                      const unsigned char *Min,
+                                      const unsigned char *Max,
+                                      unsigned char *Target) {
+    // Inset the box a little, the endpoints are rarely hit exactly
+    int Low[3];
+    int High[3];
+    for (int c = 0; c < 3; c++) {
+        int Inset = (Max[c] - Min[c]) >> 4;
+        Low[c] = Min[c] + Inset;
+        High[c] = Max[c] - Inset;
+    }
+
+    // The endpoints sit on the box's main diagonal. Red or blue falling as
+    // green rises means the colors lie along another one.
+    int Center[3];
+    for (int c = 0; c < 3; c++) {
+        Center[c] = (Low[c] + High[c]) / 2;
+    }
+    int RedGreen = 0;
+    int BlueGreen = 0;
+    for (int i = 0; i < 16; i++) {
+        int Green = Block[i * 4 + 1] - Center[1];
+        RedGreen += (Block[i * 4 + 0] - Center[0]) * Green;
+        BlueGreen += (Block[i * 4 + 2] - Center[2]) * Green;
+    }
+    if (RedGreen < 0) {
+        std::swap(Low[0], High[0]);
+    }
+    if (BlueGreen < 0) {
+        std::swap(Low[2], High[2]);
+    }
+
+    uint16_t Color0 = TextureCompress_To565(High);
+    uint16_t Color1 = TextureCompress_To565(Low);
+    uint32_t Indices = 0;
+    if (Color0 != Color1) {
+        int Endpoint0[3];
+        int Endpoint1[3];
+        TextureCompress_From565(Color0, Endpoint0);
+        TextureCompress_From565(Color1, Endpoint1);
+        int Axis[3];
+        int Length = 0;
+        for (int c = 0; c < 3; c++) {
+            Axis[c] = Endpoint0[c] - Endpoint1[c];
+            Length += Axis[c] * Axis[c];
+        }
+
+        int Dots[16];
+        TextureCompress_Project(Block, Endpoint1, Axis, Dots);
+        // thirds of the way from Color1 to Color0, as palette indices
+        static const uint32_t Remap[4] = {1, 3, 2, 0};
+        for (int i = 0; i < 16; i++) {
+            int Step = Dots[i] <= 0 ? 0 : (Dots[i] * 3 + Length / 2) / Length;
+            Indices |= Remap[std::min(Step, 3)] << (i * 2);
+        }
+        if (Color0 < Color1) {
+            std::swap(Color0, Color1);
+            Indices ^= 0x55555555;
+        }
+    }
+
+    Target[0] = Color0 & 0xFF;
+    Target[1] = Color0 >> 8;
+    Target[2] = Color1 & 0xFF;
+    Target[3] = Color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        Target[4 + i] = (Indices >> (i * 8)) & 0xFF;
+    }
+}
+
+// 8 bytes: Max and Min of one channel, then a 3 bit index per texel into
+// them and the six steps in between
+static void TextureCompress_EncodeBC4(const unsigned char *Block, int Channel,
+                                      int Min, int Max,
+                                      unsigned char *Target) {
+    uint64_t Indices = 0;
+    if (Max > Min) {
+        int Range = Max - Min;
+        // sevenths of the way from Min to Max, as palette indices
+        static const uint64_t Remap[8] = {1, 7, 6, 5, 4, 3, 2, 0};
+        for (int i = 0; i < 16; i++) {
+            int Step = ((Block[i * 4 + Channel] - Min) * 7 + Range / 2) / Range;
+            Indices |= Remap[Step] << (i * 3);
+        }
+    }
+
+    Target[0] = (unsigned char)Max;
+    Target[1] = (unsigned char)Min;
+    for (int i = 0; i < 6; i++) {
+        Target[2 + i] = (Indices >> (i * 8)) & 0xFF;
+    }
+}
+
+void TextureCompress_Encode(const texture_image &Image,
+                            const unsigned char *Pixels, int Width,
+                            int Height, unsigned char *Target,
+                            thread_pool *Pool) {
+    texture_compression Compression = Image.Compression;
+    int Channels = Image.Channels;
+    int BlocksX = (Width + 3) / 4;
+    int BlocksY = (Height + 3) / 4;
+    size_t BlockSize = Compression == texture_compression::BC1 ||
+                               Compression == texture_compression::BC4
+                           ? 8
+                           : 16;
+
+    // a few hundred blocks per job, the small mips stay on this thread
+    int Grain = std::max(1, 256 / BlocksX);
+    ThreadPool_ParallelFor(Pool, BlocksY, Grain, [&](int Begin, int End) {
+        unsigned char Block[64];
+        unsigned char Min[4];
+        unsigned char Max[4];
+        for (int BlockY = Begin; BlockY < End; BlockY++) {
+            unsigned char *Output =
+                Target + (size_t)BlockY * BlocksX * BlockSize;
+            for (int BlockX = 0; BlockX < BlocksX; BlockX++) {
+                TextureCompress_FetchBlock(Pixels, Width, Height, Channels,
+                                           BlockX, BlockY, Block);
+                TextureCompress_GetBounds(Block, Min, Max);
+                switch (Compression) {
+                case texture_compression::BC1:
+                    TextureCompress_EncodeBC1(Block, Min, Max, Output);
+                    break;
+                case texture_compression::BC3:
+                    TextureCompress_EncodeBC4(Block, 3, Min[3], Max[3],
+                                              Output);
+                    TextureCompress_EncodeBC1(Block, Min, Max, Output + 8);
+                    break;
+                case texture_compression::BC4:
+                    TextureCompress_EncodeBC4(Block, 0, Min[0], Max[0],
+                                              Output);
+                    break;
+                case texture_compression::BC5:
+                    TextureCompress_EncodeBC4(Block, 0, Min[0], Max[0],
+                                              Output);
+                    TextureCompress_EncodeBC4(Block, 1, Min[1], Max[1],
+                                              Output + 8);
+                    break;
+                default:
+                    break;
+                }
+                Output += BlockSize;
+            }
+        }
+    });
+}
@@ -0,0 +1,20 @@
+#ifndef TEXTURE_COMPRESS_H_
+#define TEXTURE_COMPRESS_H_
+
+#include "texture.h"
+#include "thread_pool.h"
+
+// Block format for a decoded image: BC5 for normal maps, BC4 for one
+// channel, BC1 for color without alpha (or with an all opaque one), BC3
+// otherwise. None when the driver can't sample the format.
+texture_compression TextureCompress_Choose(const texture_image &Image);
+// Encodes a Width x Height level of Image's channels into Image.Compression
+// blocks at Target, bands of block rows spread over Pool. Real time
+// quality: bounding box endpoints, texels snapped to the nearest palette
+// entry.
+void TextureCompress_Encode(const texture_image &Image,
+                            const unsigned char *Pixels, int Width,
+                            int Height, unsigned char *Target,
+                            thread_pool *Pool);
+
+#endif
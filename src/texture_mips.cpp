@@ -0,0 +1,362 @@
+#include "texture_mips.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_MIPS_SSE2
+#endif
+
+// Levels are filtered as four floats per texel, whatever the channel count
+struct mip_chain {
+    int Channels;
+    // leading channels stored as sRGB, the rest is linear. Grey and alpha
+    // only has its grey in sRGB.
+    int ColorChannels;
+    bool IsNormalMap;
+    // byte to float for each channel: sRGB to linear, [-1, 1] for normal
+    // map XYZ, [0, 1] otherwise
+    float Decode[4][256];
+#ifdef TEXTURE_MIPS_SSE2
+    // Decode of the channels past ColorChannels as Byte * Scale + Bias, 0
+    // for the channels the image doesn't have
+    __m128 Scale;
+    __m128 Bias;
+#endif
+};
+
+// linear [0, 1] in 4096 steps to sRGB bytes
+static unsigned char LinearToSRGB[4096];
+static float SRGBToLinear[256];
+static std::once_flag TablesBuilt;
+
+static void TextureMips_BuildTables() {
+    for (int i = 0; i < 256; i++) {
+        float Color = i / 255.0f;
+        SRGBToLinear[i] = Color <= 0.04045f
+                              ? Color / 12.92f
+                              : powf((Color + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < 4096; i++) {
+        float Linear = i / 4095.0f;
+        float Color = Linear <= 0.0031308f
+                          ? Linear * 12.92f
+                          : 1.055f * powf(Linear, 1.0f / 2.4f) - 0.055f;
+        LinearToSRGB[i] = (unsigned char)(Color * 255.0f + 0.5f);
+    }
+}
+
+int TextureMips_GetLevelCount(int Width, int Height) {
+    int LevelCount = 1;
+    while ((Width >> LevelCount) > 0 || (Height >> LevelCount) > 0) {
+        LevelCount++;
+    }
+    return std::min(LevelCount, TEXTURE_MAX_LEVELS);
+}
+
+// Rows per job, a few thousand texels each
+static int TextureMips_GetGrain(int Width) {
+    return std::max(1, 4096 / Width);
+}
+
+// Level 0 bytes into the float texels of level 1, rows [Begin, End)
+static void TextureMips_DownsampleBytes(const mip_chain &Chain,
+                                        const unsigned char *Source,
+                                        int SourceWidth, int SourceHeight,
+                                        float *Target, int Width, int Begin,
+                                        int End) {
+    int Channels = Chain.Channels;
+    for (int y = Begin; y < End; y++) {
+        const unsigned char *Rows[2] = {
+            Source + (size_t)std::min(2 * y, SourceHeight - 1) * SourceWidth *
+                         Channels,
+            Source + (size_t)std::min(2 * y + 1, SourceHeight - 1) *
+                         SourceWidth * Channels};
+        float *Output = Target + (size_t)y * Width * 4;
+        int x = 0;
+#ifdef TEXTURE_MIPS_SSE2
+        // Four linear channels fill the lanes: both texels of a row in one
+        // load, summed as integers and decoded once. sRGB stays on the
+        // tables, SSE2 has no gather.
+        if (Channels == 4 && Chain.ColorChannels == 0) {
+            __m128i Zero = _mm_setzero_si128();
+            __m128 Scale = _mm_mul_ps(Chain.Scale, _mm_set1_ps(0.25f));
+            for (; x < SourceWidth / 2; x++) {
+                __m128i Sum = _mm_add_epi16(
+                    _mm_unpacklo_epi8(
+                        _mm_loadl_epi64((const __m128i *)(Rows[0] + x * 8)),
+                        Zero),
+                    _mm_unpacklo_epi8(
+                        _mm_loadl_epi64((const __m128i *)(Rows[1] + x * 8)),
+                        Zero));
+                Sum = _mm_add_epi16(Sum, _mm_srli_si128(Sum, 8));
+                __m128 Values =
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Sum, Zero)),
+                               Scale);
+                _mm_storeu_ps(Output + x * 4, _mm_add_ps(Values, Chain.Bias));
+            }
+        }
+#endif
+        // the rest, and the clamped last column of odd widths
+        for (; x < Width; x++) {
+            int Columns[2] = {std::min(2 * x, SourceWidth - 1) * Channels,
+                              std::min(2 * x + 1, SourceWidth - 1) * Channels};
+            float Sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < 4; i++) {
+                const unsigned char *Texel = Rows[i / 2] + Columns[i % 2];
+                for (int c = 0; c < Channels; c++) {
+                    Sum[c] += Chain.Decode[c][Texel[c]];
+                }
+            }
+            for (int c = 0; c < 4; c++) {
+                Output[x * 4 + c] = Sum[c] * 0.25f;
+            }
+        }
+    }
+}
+
+// One float level into the next, rows [Begin, End)
+static void TextureMips_DownsampleFloats(const float *Source, int SourceWidth,
+                                         int SourceHeight, float *Target,
+                                         int Width, int Begin, int End) {
+    for (int y = Begin; y < End; y++) {
+        size_t Stride = (size_t)SourceWidth * 4;
+        const float *Row0 = Source + std::min(2 * y, SourceHeight - 1) * Stride;
+        const float *Row1 =
+            Source + std::min(2 * y + 1, SourceHeight - 1) * Stride;
+        float *Output = Target + (size_t)y * Width * 4;
+        for (int x = 0; x < Width; x++) {
+            int X0 = std::min(2 * x, SourceWidth - 1) * 4;
+            int X1 = std::min(2 * x + 1, SourceWidth - 1) * 4;
+#ifdef TEXTURE_MIPS_SSE2
+            __m128 Sum = _mm_add_ps(
+                _mm_add_ps(_mm_loadu_ps(Row0 + X0), _mm_loadu_ps(Row0 + X1)),
+                _mm_add_ps(_mm_loadu_ps(Row1 + X0), _mm_loadu_ps(Row1 + X1)));
+            _mm_storeu_ps(Output + x * 4, _mm_mul_ps(Sum, _mm_set1_ps(0.25f)));
+#else
+            for (int c = 0; c < 4; c++) {
+                Output[x * 4 + c] =
+                    (Row0[X0 + c] + Row0[X1 + c] + Row1[X0 + c] +
+                     Row1[X1 + c]) *
+                    0.25f;
+            }
+#endif
+        }
+    }
+}
+
+#ifdef TEXTURE_MIPS_SSE2
+// Four RGBA texels clamped and rounded together into 16 bytes, the sRGB
+// channels then looked up one by one
+static void TextureMips_EncodeRGBA(const mip_chain &Chain, const float *Source,
+                                   unsigned char *Output, __m128 AlphaScale) {
+    __m128i Bytes[4];
+    int Indices[4][4];
+    for (int i = 0; i < 4; i++) {
+        __m128 Value = _mm_mul_ps(_mm_loadu_ps(Source + i * 4), AlphaScale);
+        Value = _mm_min_ps(_mm_max_ps(Value, _mm_setzero_ps()),
+                           _mm_set1_ps(1.0f));
+        Bytes[i] = _mm_cvttps_epi32(_mm_add_ps(
+            _mm_mul_ps(Value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+        _mm_storeu_si128(
+            (__m128i *)Indices[i],
+            _mm_cvttps_epi32(_mm_add_ps(
+                _mm_mul_ps(Value, _mm_set1_ps(4095.0f)), _mm_set1_ps(0.5f))));
+    }
+    _mm_storeu_si128((__m128i *)Output,
+                     _mm_packus_epi16(_mm_packs_epi32(Bytes[0], Bytes[1]),
+                                      _mm_packs_epi32(Bytes[2], Bytes[3])));
+    for (int i = 0; i < 4; i++) {
+        for (int c = 0; c < Chain.ColorChannels; c++) {
+            Output[i * 4 + c] = LinearToSRGB[Indices[i][c]];
+        }
+    }
+}
+#endif
+
+// Float texels back to the image's bytes, rows [Begin, End). Alpha is
+// scaled by AlphaScale to keep the cutout coverage.
+static void TextureMips_Encode(const mip_chain &Chain, const float *Source,
+                               unsigned char *Target, int Width,
+                               float AlphaScale, int Begin, int End) {
+    int Channels = Chain.Channels;
+    for (int y = Begin; y < End; y++) {
+        size_t Row = (size_t)y * Width;
+        int x = 0;
+#ifdef TEXTURE_MIPS_SSE2
+        if (Channels == 4 && !Chain.IsNormalMap) {
+            __m128 Scale = _mm_setr_ps(1.0f, 1.0f, 1.0f, AlphaScale);
+            for (; x + 4 <= Width; x += 4) {
+                TextureMips_EncodeRGBA(Chain, Source + (Row + x) * 4,
+                                       Target + (Row + x) * 4, Scale);
+            }
+        }
+#endif
+        for (; x < Width; x++) {
+            float Texel[4];
+            memcpy(Texel, Source + (Row + x) * 4, sizeof(Texel));
+            unsigned char *Output = Target + (Row + x) * Channels;
+
+            if (Chain.IsNormalMap && Channels >= 3) {
+                float Length = sqrtf(Texel[0] * Texel[0] + Texel[1] * Texel[1] +
+                                     Texel[2] * Texel[2]);
+                float Scale = Length > 0.0f ? 0.5f / Length : 0.0f;
+                for (int c = 0; c < 3; c++) {
+                    Texel[c] = Texel[c] * Scale + 0.5f;
+                }
+            } else if (Chain.IsNormalMap) {
+                // XY only, nothing to normalize
+                for (int c = 0; c < Channels; c++) {
+                    Texel[c] = Texel[c] * 0.5f + 0.5f;
+                }
+            }
+            if (Channels == 4) {
+                Texel[3] *= AlphaScale;
+            }
+            for (int c = 0; c < Channels; c++) {
+                float Value = std::min(std::max(Texel[c], 0.0f), 1.0f);
+                if (c < Chain.ColorChannels) {
+                    Output[c] = LinearToSRGB[(int)(Value * 4095.0f + 0.5f)];
+                } else {
+                    Output[c] = (unsigned char)(Value * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+}
+
+// Smallest alpha byte the cutout shaders keep
+static int TextureMips_GetAlphaCutoff() {
+    return (int)ceilf(TEXTURE_MIPS_ALPHA_CUTOFF * 255.0f);
+}
+
+// Fraction of texels the cutout shaders keep, once alpha is a byte again
+static float TextureMips_GetCoverage(const float *Texels, size_t Count,
+                                     float AlphaScale) {
+    int Cutoff = TextureMips_GetAlphaCutoff();
+    size_t Kept = 0;
+    for (size_t i = 0; i < Count; i++) {
+        float Alpha = std::min(Texels[i * 4 + 3] * AlphaScale, 1.0f);
+        Kept += (int)(Alpha * 255.0f + 0.5f) >= Cutoff;
+    }
+    return (float)Kept / Count;
+}
+
+// Alpha scale that gives a level the coverage of level 0
+static float TextureMips_GetAlphaScale(const float *Texels, size_t Count,
+                                       float Coverage) {
+    float Low = 0.0f;
+    float High = 4.0f;
+    for (int i = 0; i < 10; i++) {
+        float Middle = (Low + High) * 0.5f;
+        if (TextureMips_GetCoverage(Texels, Count, Middle) < Coverage) {
+            Low = Middle;
+        } else {
+            High = Middle;
+        }
+    }
+    // coverage moves in steps, texels often share an alpha value
+    float LowError = Coverage - TextureMips_GetCoverage(Texels, Count, Low);
+    float HighError = TextureMips_GetCoverage(Texels, Count, High) - Coverage;
+    return LowError < HighError ? Low : High;
+}
+
+void TextureMips_Generate(texture_image &Image, thread_pool *Pool) {
+    std::call_once(TablesBuilt, TextureMips_BuildTables);
+
+    mip_chain Chain;
+    Chain.Channels = Image.Channels;
+    Chain.ColorChannels = 0;
+    if (Image.IsColorData) {
+        Chain.ColorChannels =
+            Image.Channels == 2 ? 1 : std::min(Image.Channels, 3);
+    }
+    Chain.IsNormalMap = Image.IsNormalMap;
+#ifdef TEXTURE_MIPS_SSE2
+    float Scale[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float Bias[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int c = Chain.ColorChannels; c < Chain.Channels; c++) {
+        bool Signed = c < 3 && Chain.IsNormalMap;
+        Scale[c] = Signed ? 2.0f / 255.0f : 1.0f / 255.0f;
+        Bias[c] = Signed ? -1.0f : 0.0f;
+    }
+    Chain.Scale = _mm_loadu_ps(Scale);
+    Chain.Bias = _mm_loadu_ps(Bias);
+#endif
+    for (int c = 0; c < 4; c++) {
+        for (int i = 0; i < 256; i++) {
+            if (c < Chain.ColorChannels) {
+                Chain.Decode[c][i] = SRGBToLinear[i];
+            } else if (c < 3 && Chain.IsNormalMap) {
+                Chain.Decode[c][i] = i / 255.0f * 2.0f - 1.0f;
+            } else {
+                Chain.Decode[c][i] = i / 255.0f;
+            }
+        }
+    }
+
+    texture_image Mips = Image;
+    Mips.LevelCount = TextureMips_GetLevelCount(Image.Width, Image.Height);
+    size_t Size = 0;
+    for (int Level = 0; Level < Mips.LevelCount; Level++) {
+        Mips.LevelOffsets[Level] = Size;
+        Size += Texture_GetLevelSize(Mips, Level);
+    }
+    Mips.Data = new unsigned char[Size];
+    memcpy(Mips.Data, Image.Data, Texture_GetLevelSize(Mips, 0));
+
+    // Only cutouts, images where the shaders discard some texels
+    size_t Count = (size_t)Image.Width * Image.Height;
+    float Coverage = 1.0f;
+    if (Image.Channels == 4) {
+        size_t Kept = 0;
+        for (size_t i = 0; i < Count; i++) {
+            Kept += Image.Data[i * 4 + 3] >= TextureMips_GetAlphaCutoff();
+        }
+        Coverage = (float)Kept / Count;
+    }
+
+    std::vector<float> Source;
+    std::vector<float> Target;
+    for (int Level = 1; Level < Mips.LevelCount; Level++) {
+        int SourceWidth = Texture_GetLevelWidth(Mips, Level - 1);
+        int SourceHeight = Texture_GetLevelHeight(Mips, Level - 1);
+        int Width = Texture_GetLevelWidth(Mips, Level);
+        int Height = Texture_GetLevelHeight(Mips, Level);
+        Target.resize((size_t)Width * Height * 4);
+
+        ThreadPool_ParallelFor(
+            Pool, Height, TextureMips_GetGrain(Width),
+            [&](int Begin, int End) {
+                if (Level == 1) {
+                    TextureMips_DownsampleBytes(Chain, Image.Data, SourceWidth,
+                                                SourceHeight, Target.data(),
+                                                Width, Begin, End);
+                } else {
+                    TextureMips_DownsampleFloats(Source.data(), SourceWidth,
+                                                 SourceHeight, Target.data(),
+                                                 Width, Begin, End);
+                }
+            });
+
+        // The next level filters the unscaled alpha, errors don't add up
+        float AlphaScale = 1.0f;
+        if (Coverage < 1.0f) {
+            AlphaScale = TextureMips_GetAlphaScale(
+                Target.data(), (size_t)Width * Height, Coverage);
+        }
+        unsigned char *Output = Mips.Data + Mips.LevelOffsets[Level];
+        ThreadPool_ParallelFor(Pool, Height, TextureMips_GetGrain(Width),
+                               [&](int Begin, int End) {
+                                   TextureMips_Encode(Chain, Target.data(),
+                                                      Output, Width,
+                                                      AlphaScale, Begin, End);
+                               });
+        std::swap(Source, Target);
+    }
+    Image = Mips;
+}
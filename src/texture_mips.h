@@ -0,0 +1,20 @@
+#ifndef TEXTURE_MIPS_H_
+#define TEXTURE_MIPS_H_
+
+#include "texture.h"
+#include "thread_pool.h"
+
+// Alpha the cutout shaders discard below (default.frag, quad.frag)
+#define TEXTURE_MIPS_ALPHA_CUTOFF 0.1f
+
+// Levels down to 1x1, at most TEXTURE_MAX_LEVELS
+int TextureMips_GetLevelCount(int Width, int Height);
+// Points Image at its whole mip chain, one block Texture_FreeImage releases.
+// The decoded level 0 it pointed at is copied, the caller still owns it.
+// 2x2 box filter in linear space: color data is converted from sRGB and
+// back, normal maps are renormalized and cutouts keep the alpha coverage
+// level 0 has at TEXTURE_MIPS_ALPHA_CUTOFF. Rows of each level are spread
+// over Pool, null runs on the calling thread.
+void TextureMips_Generate(texture_image &Image, thread_pool *Pool);
+
+#endif
@@ -0,0 +1,135 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+static void ThreadPool_WorkerLoop(thread_pool &Pool) {
+    for (;;) {
+        std::function<void()> Job;
+        {
+            std::unique_lock<std::mutex> Lock(Pool.Mutex);
+            Pool.Condition.wait(
+                Lock, [&Pool] { return Pool.Stop || !Pool.Jobs.empty(); });
+            if (Pool.Stop && Pool.Jobs.empty()) {
+                return;
+            }
+            Job = std::move(Pool.Jobs.front());
+            Pool.Jobs.pop_front();
+        }
+        Job();
+    }
+}
+
+void ThreadPool_Create(thread_pool &Pool, unsigned int ThreadCount) {
+    if (ThreadCount == 0) {
+        unsigned int Cores = std::thread::hardware_concurrency();
+        ThreadCount = Cores > 1 ? Cores - 1 : 1;
+    }
+
+    Pool.Stop = false;
+    Pool.Workers.reserve(ThreadCount);
+    for (unsigned int i = 0; i < ThreadCount; i++) {
+        Pool.Workers.emplace_back(ThreadPool_WorkerLoop, std::ref(Pool));
+    }
+}
+
+void ThreadPool_Destroy(thread_pool &Pool) {
+    {
+        std::lock_guard<std::mutex> Lock(Pool.Mutex);
+        Pool.Stop = true;
+    }
+    Pool.Condition.notify_all();
+    // queued jobs still run, nobody waiting on them is left hanging
+    for (std::thread &Worker : Pool.Workers) {
+        Worker.join();
+    }
+    Pool.Workers.clear();
+}
+
+std::future<void> ThreadPool_Submit(thread_pool &Pool,
+                                    std::function<void()> Job) {
+    auto Task = std::make_shared<std::packaged_task<void()>>(std::move(Job));
+    std::future<void> Result = Task->get_future();
+    {
+        std::lock_guard<std::mutex> Lock(Pool.Mutex);
+        Pool.Jobs.push_back([Task] { (*Task)(); });
+    }
+    Pool.Condition.notify_one();
+    return Result;
+}
+
+// Shared by the caller and the helpers of one ParallelFor
+struct parallel_for_batch {
+    std::atomic<int> Next;
+    std::atomic<int> Done;
+    int ChunkCount;
+    int Count;
+    int Grain;
+    const std::function<void(int, int)> *Body;
+    std::mutex Mutex;
+    std::condition_variable Finished;
+};
+
+// Takes chunks until there are none left
+static void ThreadPool_RunChunks(parallel_for_batch &Batch) {
+    for (;;) {
+        int Chunk = Batch.Next.fetch_add(1);
+        if (Chunk >= Batch.ChunkCount) {
+            return;
+        }
+        int Begin = Chunk * Batch.Grain;
+        int End = std::min(Begin + Batch.Grain, Batch.Count);
+        (*Batch.Body)(Begin, End);
+
+        if (Batch.Done.fetch_add(1) + 1 == Batch.ChunkCount) {
+            std::lock_guard<std::mutex> Lock(Batch.Mutex);
+            Batch.Finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool_ParallelFor(thread_pool *Pool, int Count, int Grain,
+                            const std::function<void(int, int)> &Body) {
+    if (Count <= 0) {
+        return;
+    }
+    Grain = std::max(Grain, 1);
+    int ChunkCount = (Count + Grain - 1) / Grain;
+    if (!Pool || Pool->Workers.empty() || ChunkCount == 1) {
+        Body(0, Count);
+        return;
+    }
+
+    auto Batch = std::make_shared<parallel_for_batch>();
+    Batch->Next = 0;
+    Batch->Done = 0;
+    Batch->ChunkCount = ChunkCount;
+    Batch->Count = Count;
+    Batch->Grain = Grain;
+    Batch->Body = &Body;
+
+    // Helpers that start after the caller took every chunk return right
+    // away, Body is only used while chunks are handed out
+    int HelperCount =
+        std::min((int)Pool->Workers.size(), ChunkCount - 1);
+    {
+        std::lock_guard<std::mutex> Lock(Pool->Mutex);
+        for (int i = 0; i < HelperCount; i++) {
+            Pool->Jobs.push_back([Batch] { ThreadPool_RunChunks(*Batch); });
+        }
+    }
+    Pool->Condition.notify_all();
+
+    ThreadPool_RunChunks(*Batch);
+
+    // Only waits on chunks other threads are already running
+    std::unique_lock<std::mutex> Lock(Batch->Mutex);
+    Batch->Finished.wait(
+        Lock, [&Batch] { return Batch->Done.load() == Batch->ChunkCount; });
+}
+
+unsigned int ThreadPool_GetThreadCount(const thread_pool *Pool) {
+    // the caller of ParallelFor works too
+    return Pool ? (unsigned int)Pool->Workers.size() + 1 : 1;
+}
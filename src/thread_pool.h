@@ -0,0 +1,34 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling jobs from one queue. Jobs never touch
+// GL, results that need uploading go back to the main thread.
+struct thread_pool {
+    std::vector<std::thread> Workers;
+    std::deque<std::function<void()>> Jobs;
+    std::mutex Mutex;
+    std::condition_variable Condition;
+    bool Stop;
+};
+
+// ThreadCount 0 uses one worker per core, minus the main thread
+void ThreadPool_Create(thread_pool &Pool, unsigned int ThreadCount = 0);
+void ThreadPool_Destroy(thread_pool &Pool);
+std::future<void> ThreadPool_Submit(thread_pool &Pool,
+                                    std::function<void()> Job);
+// Runs Body over [0, Count) in chunks of Grain and returns once all of them
+// are done. The calling thread works on the chunks too, so this is safe to
+// call from inside a job. A null Pool runs everything on the caller.
+void ThreadPool_ParallelFor(thread_pool *Pool, int Count, int Grain,
+                            const std::function<void(int, int)> &Body);
+unsigned int ThreadPool_GetThreadCount(const thread_pool *Pool);
+
+#endif
@@ -0,0 +1,40 @@
+#include "upload_queue.h"
+
+void UploadQueue_Create(upload_queue &Queue) {
+    Queue.Outstanding = 0;
+}
+
+void UploadQueue_Expect(upload_queue &Queue) {
+    Queue.Outstanding++;
+}
+
+void UploadQueue_Push(upload_queue &Queue, std::function<void()> Upload) {
+    // Notified under the lock: once the last upload is popped the GL thread
+    // may return and destroy the queue
+    std::lock_guard<std::mutex> Lock(Queue.Mutex);
+    Queue.Uploads.push_back(std::move(Upload));
+    Queue.Ready.notify_one();
+}
+
+int UploadQueue_Run(upload_queue &Queue, bool Wait) {
+    int Count = 0;
+    while (Queue.Outstanding > 0) {
+        std::function<void()> Upload;
+        {
+            std::unique_lock<std::mutex> Lock(Queue.Mutex);
+            if (Wait) {
+                Queue.Ready.wait(Lock,
+                                 [&Queue] { return !Queue.Uploads.empty(); });
+            } else if (Queue.Uploads.empty()) {
+                break;
+            }
+            Upload = std::move(Queue.Uploads.front());
+            Queue.Uploads.pop_front();
+        }
+        // outside the lock, workers keep pushing while this uploads
+        Upload();
+        Queue.Outstanding--;
+        Count++;
+    }
+    return Count;
+}
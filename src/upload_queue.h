@@ -0,0 +1,29 @@
+#ifndef UPLOAD_QUEUE_H_
+#define UPLOAD_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Hands finished CPU work from the worker threads back to the GL thread.
+// Workers push the GL half of a job, the GL thread runs it.
+struct upload_queue {
+    std::deque<std::function<void()>> Uploads;
+    std::mutex Mutex;
+    std::condition_variable Ready;
+    // Uploads promised by submitted jobs that haven't run yet, only touched
+    // on the GL thread
+    int Outstanding;
+};
+
+void UploadQueue_Create(upload_queue &Queue);
+// GL thread, before submitting a job that will push one upload
+void UploadQueue_Expect(upload_queue &Queue);
+// Any thread
+void UploadQueue_Push(upload_queue &Queue, std::function<void()> Upload);
+// GL thread. Runs what is queued, with Wait until every expected upload
+// ran. Returns how many ran.
+int UploadQueue_Run(upload_queue &Queue, bool Wait);
+
+#endif